@@ -5,74 +5,240 @@
  * interrupções essenciais para o funcionamento do sistema operacional:
  *
  * 1. IRQ0 (Clock/Timer): Interrupção periódica que sinaliza o fim do time slice
- *    - Enviada a cada TIME_SLICE_SECONDS (1 segundo)
+ *    - Enviada a cada quantum (padrão TIME_SLICE_SECONDS = 1 segundo)
  *    - Permite ao kernel implementar escalonamento preemptivo
  *    - Implementa o conceito de quantum de tempo do Round-Robin
  *
  * 2. IRQ1 (I/O Complete): Interrupção que sinaliza conclusão de operação de I/O
- *    - Enviada após IO_DURATION_SECONDS (3 segundos) da requisição
+ *    - Enviada após a duração do I/O (padrão IO_DURATION_SECONDS = 3 segundos)
  *    - Simula o tempo que um dispositivo real levaria para completar I/O
  *    - Permite ao kernel desbloquear processos que aguardam I/O
  *
+ * 3. IRQ3 (Swap Complete): Interrupção que sinaliza a leitura de uma página
+ *    do dispositivo de swap, pedida pelo kernel para atender uma falta de
+ *    página (SIG_SWAP_REQ)
+ *    - Enviada após a duração de um acesso ao swap (padrão SWAP_DURATION_MS)
+ *    - O swap é um dispositivo separado do disco D1: os dois atendem pedidos
+ *      ao mesmo tempo
+ *
  * O controlador funciona de forma independente como um processo separado,
  * comunicando-se com o kernel exclusivamente através de sinais Unix.
+ *
+ * O quantum e as durações do I/O e do swap podem ser sobrescritos em
+ * milissegundos pelos argumentos (repassados pelo kernel a partir das suas
+ * opções -q, -d e -w).
+ *
+ * Temporização:
+ *   - O fim do quantum e o prazo de cada I/O são temporizadores de uma roda
+ *     hierárquica (timerwheel.h) com ticks de 1 ms
+ *   - O laço principal espera pelo próximo prazo da roda ou por um pedido de
+ *     I/O (SIG_IO_REQ) com sigtimedwait, sem dormir dentro de handlers; assim
+ *     vários I/Os podem estar em andamento ao mesmo tempo, sem atrasar o clock
+ *
+ * Sinais (shared.h):
+ *   - Pedidos do kernel e interrupções usam sinais de tempo real enfileirados
+ *     (sigqueue), que não se fundem quando chegam vários de uma vez
+ *   - Cada IRQ0 leva um número sequencial e cada IRQ1 o número do pedido de
+ *     I/O recebido com o SIG_IO_REQ correspondente, para que o kernel possa
+ *     conferir que nenhuma interrupção se perdeu
+ *
+ * Programação pelo kernel:
+ *   - O kernel passa um bloco ClockControl (shared.h) e o reprograma quando
+ *     precisa; cada reprogramação é avisada por SIG_CLOCK, também lido no laço
+ *   - Modo tickless (kernel -T): IRQ0 periódica só com dois ou mais processos
+ *     executáveis e uma IRQ0 avulsa no prazo do próximo temporizador do
+ *     kernel; sem nada programado nem I/O em andamento, o controlador dorme
+ *     até o próximo pedido
+ *   - Quantum adaptativo (kernel -p arr): o kernel escolhe o quantum de cada
+ *     despacho e o time slice recomeça no instante do despacho
  ******************************************************************************/
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "shared.h"
+#include "timerwheel.h"
 
 #define TIME_SLICE_SECONDS 1
 #define IO_DURATION_SECONDS 3
+#define SWAP_DURATION_MS 20
 
 /*******************************************************************************
  * VARIÁVEIS GLOBAIS
  ******************************************************************************/
 pid_t kernel_pid;
+int quantum_ms = TIME_SLICE_SECONDS * 1000;
+int io_duration_ms = IO_DURATION_SECONDS * 1000;
+int swap_duration_ms = SWAP_DURATION_MS;
+int64_t start_ns;              // CLOCK_MONOTONIC do início, em ns
+TimerWheel wheel;
+Timer quantum_timer;
+Timer oneshot_timer;
+ClockControl *clock_ctl = NULL;  // Programação do kernel (NULL: clock periódico)
+uint32_t slice_seq = 0;          // Último slice_seq aplicado
+Timer *free_io_timers = NULL;   // Temporizadores de I/O livres, para reuso
+long io_in_flight = 0;
+long swap_in_flight = 0;
+uint32_t tick_seq = 0;           // Número da última IRQ0 enviada
+
+/*******************************************************************************
+ * elapsed_ms - Milissegundos (completos) decorridos desde o início do controlador
+ ******************************************************************************/
+uint64_t elapsed_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t now_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    return (uint64_t)(now_ns - start_ns) / 1000000;
+}
 
 /*******************************************************************************
- * HANDLERS DE SINAL
+ * TEMPORIZADORES
  ******************************************************************************/
 
 /*******************************************************************************
- * handle_io_request - Handler para requisições de I/O do kernel
+ * current_quantum - Quantum em vigor (o programado pelo kernel, se houver)
+ ******************************************************************************/
+int current_quantum() {
+    if (clock_ctl && clock_ctl->quantum_ms > 0)
+        return clock_ctl->quantum_ms;
+    return quantum_ms;
+}
+
+/*******************************************************************************
+ * quantum_expired - Fim do time slice: envia IRQ0 e rearma o temporizador
  *
- * Chamado quando o kernel sinaliza (via SIGUSR2) que um processo iniciou uma
- * operação de entrada/saída. Este handler simula o tempo de processamento do
- * dispositivo de I/O e notifica o kernel quando a operação é concluída.
+ * O próximo prazo é contado a partir do prazo anterior (e não do instante
+ * atual), para que atrasos no despertar não se acumulem.
+ ******************************************************************************/
+void quantum_expired(Timer *t) {
+    sig_send(kernel_pid, SIG_IRQ0, SIGVAL_SEQ(++tick_seq));
+    if (!clock_ctl || clock_ctl->periodic)
+        tw_add(&wheel, t, t->expires + current_quantum());
+}
+
+/*******************************************************************************
+ * oneshot_expired - IRQ0 avulsa pedida pelo kernel no modo tickless
+ ******************************************************************************/
+void oneshot_expired(Timer *t) {
+    sig_send(kernel_pid, SIG_IRQ0, SIGVAL_SEQ(++tick_seq));
+}
+
+/*******************************************************************************
+ * program_clock - Aplica a programação do clock feita pelo kernel
  *
- * Parâmetros:
- *   sig - Número do sinal recebido (SIGUSR2)
+ * Ao ser religado, ou quando o kernel despacha com um novo quantum, o clock
+ * periódico conta um quantum inteiro a partir de agora. O prazo da IRQ0
+ * avulsa é arredondado para cima, para que ela nunca chegue antes do
+ * temporizador do kernel vencer.
+ ******************************************************************************/
+void program_clock() {
+    uint64_t now = elapsed_ms();
+    uint32_t seq = clock_ctl->slice_seq;
+
+    if (clock_ctl->periodic) {
+        if (!tw_pending(&quantum_timer) || seq != slice_seq)
+            tw_add(&wheel, &quantum_timer, now + current_quantum());
+        slice_seq = seq;
+    } else {
+        tw_cancel(&wheel, &quantum_timer);
+    }
+
+    int64_t at = clock_ctl->oneshot_ns;
+    if (at > 0)
+        tw_add(&wheel, &oneshot_timer, at > start_ns ? (uint64_t)(at - start_ns + 999999) / 1000000 : 0);
+    else
+        tw_cancel(&wheel, &oneshot_timer);
+}
+
+/*******************************************************************************
+ * io_expired - Prazo de um I/O atingido: envia IRQ1 ao kernel
  *
- * Fluxo de execução:
- *   1. Registra o recebimento da requisição de I/O
- *   2. Simula o tempo de processamento do dispositivo (sleep)
- *   3. Envia IRQ1 (SIGALRM) ao kernel indicando conclusão
- *   4. Registra o envio da interrupção
+ * O valor do sinal é o número do pedido, guardado no temporizador.
+ ******************************************************************************/
+void io_expired(Timer *t) {
+    io_in_flight--;
+    sig_send(kernel_pid, SIG_IRQ1, (int)(intptr_t)t->data);
+    printf("InterControllerSim: IRQ1 enviado ao kernel.\n");
+    fflush(stdout);
+
+    t->next = free_io_timers;
+    free_io_timers = t;
+}
+
+/*******************************************************************************
+ * swap_expired - Prazo de uma leitura do swap atingido: envia IRQ3 ao kernel
+ ******************************************************************************/
+void swap_expired(Timer *t) {
+    swap_in_flight--;
+    sig_send(kernel_pid, SIG_IRQ3, (int)(intptr_t)t->data);
+
+    t->next = free_io_timers;
+    free_io_timers = t;
+}
+
+/*******************************************************************************
+ * io_timer_alloc - Temporizador livre para um pedido (reusa os já concluídos)
+ ******************************************************************************/
+Timer *io_timer_alloc() {
+    Timer *t = free_io_timers;
+    if (t) {
+        free_io_timers = t->next;
+    } else {
+        t = malloc(sizeof(Timer));
+        if (!t) {
+            perror("malloc");
+            exit(1);
+        }
+    }
+    return t;
+}
+
+/*******************************************************************************
+ * start_io - Trata uma requisição de I/O do kernel
+ *
+ * Chamado quando o kernel sinaliza (via SIG_IO_REQ) que um processo iniciou
+ * uma operação de entrada/saída. Agenda um temporizador com o prazo de
+ * conclusão do dispositivo; a IRQ1 (SIG_IRQ1) é enviada por io_expired quando
+ * ele vence.
+ *
+ * Parâmetros:
+ *   request - Número do pedido, devolvido ao kernel no valor da IRQ1
  *
  * Comportamento simulado:
  *   - Representa o tempo que um disco rígido ou outro dispositivo levaria
  *     para completar uma operação de leitura ou escrita
- *   - Durante o sleep, o controlador está "processando" a operação
- *   - Após o sleep, o "hardware" notifica o kernel via interrupção
- *
- * Importante:
- *   - O sleep bloqueia apenas este processo, não afeta o kernel
- *   - Simula latência realista de dispositivos de I/O
- *   - Permite que o kernel continue escalonando outros processos
- *
- * Contexto: Handler de sinal - executado de forma assíncrona
+ *   - Enquanto o prazo não vence, o controlador continua gerando IRQ0 e
+ *     aceitando novos pedidos
  ******************************************************************************/
-void handle_io_request(int sig) {
-    printf("InterControllerSim: pedido de I/O recebido, gerando IRQ1 em %d segundos...\n", IO_DURATION_SECONDS);
+void start_io(int request) {
+    Timer *t = io_timer_alloc();
+
+    io_in_flight++;
+    printf("InterControllerSim: pedido de I/O recebido, gerando IRQ1 em %d ms (%ld em andamento)...\n",
+           io_duration_ms, io_in_flight);
     fflush(stdout);
 
-    sleep(IO_DURATION_SECONDS);
+    tw_timer_init(t, io_expired, (void *)(intptr_t)request);
+    tw_add(&wheel, t, elapsed_ms() + io_duration_ms);
+}
 
-    kill(kernel_pid, SIGALRM);
-    printf("InterControllerSim: IRQ1 enviado ao kernel.\n");
-    fflush(stdout);
+/*******************************************************************************
+ * start_swap - Trata um pedido de leitura de página do kernel (SIG_SWAP_REQ)
+ *
+ * Como start_io, mas no dispositivo de swap: a IRQ3 (SIG_IRQ3) com o número
+ * do pedido é enviada por swap_expired depois de swap_duration_ms. Os
+ * pedidos podem ser muitos por segundo, por isso não geram mensagens.
+ ******************************************************************************/
+void start_swap(int request) {
+    Timer *t = io_timer_alloc();
+
+    swap_in_flight++;
+    tw_timer_init(t, swap_expired, (void *)(intptr_t)request);
+    tw_add(&wheel, t, elapsed_ms() + swap_duration_ms);
 }
 
 /*******************************************************************************
@@ -83,41 +249,54 @@ void handle_io_request(int sig) {
  * de I/O do kernel.
  *
  * Parâmetros:
- *   argc - Número de argumentos (não utilizado)
- *   argv - Array de argumentos (não utilizado)
+ *   argc - Número de argumentos
+ *   argv - Array de argumentos (opcionais):
+ *          argv[1] = quantum em milissegundos
+ *          argv[2] = duração do I/O em milissegundos
+ *          argv[3] = descriptor do bloco ClockControl
+ *          argv[4] = duração de uma leitura do swap em milissegundos
  *
  * Fluxo de execução:
  *   1. Identifica o PID do kernel (processo pai)
- *   2. Registra o handler para requisições de I/O (SIGUSR2)
- *   3. Entra em loop infinito:
- *      a. Aguarda TIME_SLICE_SECONDS (1 segundo)
- *      b. Envia IRQ0 (SIGUSR1) ao kernel
- *      c. Repete indefinidamente
+ *   2. Bloqueia o SIG_IO_REQ (pedidos de I/O), o SIG_SWAP_REQ (leituras do
+ *      swap) e o SIG_CLOCK (reprogramação do clock), que passam a ser lidos
+ *      no laço
+ *   3. Agenda o temporizador do quantum
+ *   4. Entra em loop infinito:
+ *      a. Avança a roda até o instante atual, expirando os temporizadores
+ *         vencidos (IRQ0, IRQ1 e IRQ3)
+ *      b. Aguarda um pedido do kernel até o próximo prazo da roda
+ *      c. Agenda o prazo de cada pedido de I/O ou reprograma o clock
  *
  * Funcionamento das interrupções:
  *
  *   IRQ0 (Timer/Clock):
- *     - Gerada automaticamente a cada 1 segundo
+ *     - Gerada automaticamente a cada quantum (padrão 1 segundo)
  *     - Sinaliza o fim do quantum de tempo do processo atual
  *     - Permite implementação de escalonamento preemptivo
- *     - Enviada via SIGUSR1
+ *     - Enviada via SIG_IRQ0, com o número sequencial do tick
  *
  *   IRQ1 (I/O Complete):
- *     - Gerada sob demanda quando kernel solicita I/O (SIGUSR2)
- *     - Tratada pelo handler handle_io_request
- *     - Simula latência de 3 segundos do dispositivo
- *     - Enviada via SIGALRM após conclusão
+ *     - Gerada sob demanda quando kernel solicita I/O (SIG_IO_REQ)
+ *     - Tratada por start_io, que agenda o prazo na roda
+ *     - Simula a latência do dispositivo (padrão 3 segundos)
+ *     - Enviada via SIG_IRQ1 após conclusão, com o número do pedido
+ *
+ *   IRQ3 (Swap Complete):
+ *     - Gerada sob demanda quando o kernel pede uma página (SIG_SWAP_REQ)
+ *     - Tratada por start_swap, no dispositivo de swap
+ *     - Enviada via SIG_IRQ3 após conclusão, com o número do pedido
  *
  * Arquitetura:
  *   - Processo independente que simula hardware
  *   - Comunicação assíncrona via sinais Unix
- *   - Não compartilha memória com kernel ou apps
+ *   - Não compartilha memória com os apps; com o kernel, apenas o bloco
+ *     ClockControl
  *   - Representa controlador de interrupções + dispositivo de I/O
  *
  * Importante:
  *   - O loop é infinito, o processo roda durante toda a vida do sistema
- *   - O sleep no loop principal não interfere no handler de I/O
- *   - Handlers de sinal são executados de forma assíncrona
+ *   - Nenhum trabalho é feito em handlers de sinal
  *   - Representa fielmente o comportamento de hardware real
  *
  * Retorna:
@@ -125,15 +304,66 @@ void handle_io_request(int sig) {
  ******************************************************************************/
 int main(int argc, char *argv[]) {
     kernel_pid = getppid();
+    if (argc > 1 && atoi(argv[1]) > 0)
+        quantum_ms = atoi(argv[1]);
+    if (argc > 2 && atoi(argv[2]) > 0)
+        io_duration_ms = atoi(argv[2]);
+    if (argc > 4 && atoi(argv[4]) > 0)
+        swap_duration_ms = atoi(argv[4]);
+    if (argc > 3) {
+        clock_ctl = mmap(NULL, sizeof(ClockControl), PROT_READ, MAP_SHARED, atoi(argv[3]), 0);
+        if (clock_ctl == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+    }
     printf("InterControllerSim: Iniciado. Kernel PID = %d\n", kernel_pid);
     fflush(stdout);
 
-    // reage quando o kernel pedir I/O
-    signal(SIGUSR2, handle_io_request);
+    // Os pedidos do kernel são lidos no laço com sigtimedwait
+    sigset_t kernel_requests;
+    sigemptyset(&kernel_requests);
+    sigaddset(&kernel_requests, SIG_IO_REQ);
+    sigaddset(&kernel_requests, SIG_SWAP_REQ);
+    sigaddset(&kernel_requests, SIG_CLOCK);
+    sigprocmask(SIG_BLOCK, &kernel_requests, NULL);
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    start_ns = (int64_t)start_time.tv_sec * 1000000000LL + start_time.tv_nsec;
+    tw_init(&wheel, 0);
+    tw_timer_init(&quantum_timer, quantum_expired, NULL);
+    tw_timer_init(&oneshot_timer, oneshot_expired, NULL);
+    tw_add(&wheel, &quantum_timer, current_quantum());
+    if (clock_ctl)
+        program_clock();
 
     while (1) {
-        sleep(TIME_SLICE_SECONDS);
-        kill(kernel_pid, SIGUSR1);
+        uint64_t now = elapsed_ms();
+        tw_advance(&wheel, now);
+
+        // No modo tickless a roda pode ficar vazia: espera sem prazo
+        uint64_t next = tw_next_expiry(&wheel);
+        int sig;
+        siginfo_t info;
+        if (next == TW_NEVER) {
+            sig = sigwaitinfo(&kernel_requests, &info);
+        } else {
+            uint64_t wait_ms = next > now ? next - now : 0;
+            struct timespec timeout = { wait_ms / 1000, (long)(wait_ms % 1000) * 1000000L };
+            sig = sigtimedwait(&kernel_requests, &info, &timeout);
+        }
+
+        if (sig == SIG_IO_REQ) {
+            tw_advance(&wheel, elapsed_ms());
+            start_io(info.si_value.sival_int);
+        } else if (sig == SIG_SWAP_REQ) {
+            tw_advance(&wheel, elapsed_ms());
+            start_swap(info.si_value.sival_int);
+        } else if (sig == SIG_CLOCK && clock_ctl) {
+            tw_advance(&wheel, elapsed_ms());
+            program_clock();
+        }
     }
 
     return 0;
@@ -8,73 +8,197 @@
  *
  * Funcionalidades principais:
  *   - Execução sequencial de instruções com Program Counter (PC)
- *   - Syscalls de I/O em pontos predefinidos da execução
- *   - Comunicação com o kernel via pipes bidirecionais
+ *   - Syscalls de I/O ou de SLEEP em pontos predefinidos da execução
+ *   - Referências à memória virtual em cada instrução, traduzidas por uma
+ *     TLB privada e pela tabela de páginas do kernel (opcional)
+ *   - Comunicação com o kernel via bloco de contexto em memória compartilhada
  *   - Restauração de contexto após operações de I/O
+ *   - Espera pelo despacho do kernel em um futex (run_gate) compartilhado
  *
  * Comportamento:
  *   - Executa 30 instruções (PC de 0 a 29)
- *   - Faz syscall READ nos PCs 5 e 15
- *   - Faz syscall WRITE nos PCs 10 e 20
- *   - Comunica-se com o kernel através de pipes
+ *   - Conforme a carga: só CPU, syscalls READ/WRITE, syscalls SLEEP, uma
+ *     sequência de WRITEs seguida de FSYNC ou uma varredura com READs de
+ *     blocos seguidos
+ *   - Ao terminar, avisa o kernel com a syscall EXIT (código e contadores)
+ *   - Comunica-se com o kernel através do seu bloco de contexto, sem
+ *     nenhuma chamada de sistema no caminho quente de cada instrução
  ******************************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
-#include <fcntl.h>
+#include <sys/mman.h>
+#include "shared.h"
+#include "pagetable.h"
 
 #define MAX_ITERATIONS 30
+#define INSTRUCTION_MS 2000
+#define SLEEP_MS 3000
+#define WRITE_LAST_PC  20        // Carga 'w': WRITE a cada 2 instruções até este PC
+#define WRITE_BLOCKS   6         // Carga 'w': blocos próprios escritos em rodízio
+#define FSYNC_PC       24        // Carga 'w': FSYNC dos blocos escritos
+#define SEQ_FIRST_BLOCK 16       // Carga 'q': primeiro bloco próprio da varredura
+#define SEQ_JUMP_PC    14        // Carga 'q': READ fora da sequência (bloco comum 5)
+
+/*
+ * Espaço de endereçamento (em páginas virtuais), em regiões distantes para
+ * que cada uma use a sua folha da tabela de páginas:
+ *   - Código: VM_CODE_PAGES páginas a partir da página 0
+ *   - Dados: as páginas pedidas pelo kernel, a partir de VM_DATA_BASE
+ *   - Pilha: VM_STACK_PAGES páginas no topo do espaço
+ */
+#define VM_CODE_PAGES  8
+#define VM_DATA_BASE   (16 * PT_LEAF_SIZE)
+#define VM_STACK_PAGES 2
+#define VM_PHASE_INSTR 10        // Instruções de cada fase do conjunto de trabalho
+#define VM_STACK_PERMILLE 100    // Referências de dados que vão para a pilha (por mil)
+#define VM_FAR_PERMILLE   2      // Referências a qualquer página de dados (por mil)
+#define VM_WRITE_PCT   30        // Referências que são escritas
 
 /*******************************************************************************
  * VARIÁVEIS GLOBAIS
  ******************************************************************************/
 int pc = 0;
-int pipe_from_kernel_fd;
-int pipe_to_kernel_fd;
-int use_io = 0; // 0 = sem I/O, 1 = com I/O
+int regs[NUM_REGS];
+char load = 'c'; // 'c' = só CPU, 'i' = com I/O, 's' = com SLEEP, 'w' = escritas,
+                 // 'q' = leitura sequencial
+int instruction_ms = INSTRUCTION_MS;
+int sleep_ms = SLEEP_MS;
+ContextBlock *ctx = NULL;
+uint32_t seen_generation = 0;
+int app_index = 0;
+uint32_t syscall_seq = 0;  // Número da última syscall sinalizada ao kernel
+int parks = 0;             // Vezes que o app estacionou
+int context_checks = 0;    // Mudanças de geração tratadas
+PageTable *page_table = NULL;  // Tabela de páginas (NULL: sem memória virtual)
+Tlb tlb;
+int vm_pages = 0;          // Páginas da região de dados
+int vm_refs = 0;           // Referências à memória por instrução
+uint64_t vm_rng = 0;
 
-/*
- * SyscallContext - Contexto de uma chamada de sistema
+/*******************************************************************************
+ * FUNÇÕES DO PROCESSO
+ ******************************************************************************/
+
+/*******************************************************************************
+ * park - Estaciona o processo até o kernel abrir o run_gate
  *
- * Estrutura enviada ao kernel quando o processo faz uma syscall de I/O.
- * Permite que o kernel saiba exatamente onde o processo estava e o que
- * ele quer fazer.
+ * Chamada nas fronteiras de instrução quando o kernel pediu preempção, e
+ * após uma syscall. O app marca 'parked' para que o kernel saiba que ele
+ * deixou a CPU e dorme no futex até ser despachado novamente.
+ ******************************************************************************/
+void park() {
+    parks++;
+    ctx->parked = 1;
+    while (__atomic_load_n(&ctx->run_gate, __ATOMIC_ACQUIRE) == GATE_STOPPED)
+        futex_wait(&ctx->run_gate, GATE_STOPPED, -1);
+    ctx->parked = 0;
+}
+
+/*******************************************************************************
+ * check_context - Trata as mudanças publicadas pelo kernel no bloco
  *
- * Campos:
- *   pc        - Program Counter no momento da syscall
- *   operation - Tipo de operação ('R' para READ, 'W' para WRITE)
- */
-typedef struct {
-    int pc;
-    char operation;
-} SyscallContext;
+ * Caminho lento, chamado apenas quando 'generation' mudou. Estaciona se há
+ * pedido de preempção e, ao voltar, restaura pc e registradores se o kernel
+ * publicou um contexto salvo. Repete enquanto a geração continuar mudando.
+ * Também esvazia a TLB se o kernel desfez traduções do app (tlb_epoch).
+ ******************************************************************************/
+void check_context() {
+    uint32_t gen;
+
+    while ((gen = __atomic_load_n(&ctx->generation, __ATOMIC_ACQUIRE)) != seen_generation) {
+        seen_generation = gen;
+        context_checks++;
+
+        if (ctx->preempt)
+            park();
+
+        if (page_table && page_table->tlb_epoch != tlb.epoch) {
+            tlb.epoch = page_table->tlb_epoch;
+            tlb_flush(&tlb);
+        }
+
+        if (ctx->restore) {
+            pc = ctx->pc;
+            for (int r = 0; r < NUM_REGS; r++)
+                regs[r] = ctx->regs[r];
+            ctx->restore = 0;
+            printf("  App (PID %d): restaurando contexto (PC=%d)\n", getpid(), pc);
+            fflush(stdout);
+        }
+    }
+}
 
 /*******************************************************************************
- * FUNÇÕES DO PROCESSO
+ * instruction_delay - Simula a duração de uma instrução
+ *
+ * Espera instruction_ms no próprio run_gate enquanto ele estiver aberto. Se o
+ * kernel pedir preempção no meio da espera, o futex é acordado e a função
+ * retorna imediatamente, para que o app estacione na próxima fronteira.
  ******************************************************************************/
+void instruction_delay() {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (!ctx->preempt) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                          (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed_ms >= instruction_ms)
+            break;
+        futex_wait(&ctx->run_gate, GATE_RUN, instruction_ms - elapsed_ms);
+    }
+}
+
+/*******************************************************************************
+ * syscall_enter - Entrega uma syscall ao kernel e estaciona
+ *
+ * Preenche o slot de syscall do bloco de contexto, fecha o próprio run_gate,
+ * sinaliza o kernel com SIG_SYSCALL (IRQ2) e estaciona até ser despachado de
+ * novo. O sinal é enfileirado com o índice do app e o número da syscall, de
+ * modo que duas syscalls seguidas nunca se fundem em uma.
+ *
+ * Parâmetros:
+ *   operation - Tipo de operação ('R', 'W', 'S' ou 'Y')
+ *   arg       - Argumento da operação
+ ******************************************************************************/
+void syscall_enter(char operation, int arg) {
+    pid_t kernel_pid = getppid();
+
+    ctx->syscall.pc = pc;
+    for (int r = 0; r < NUM_REGS; r++)
+        ctx->syscall.regs[r] = regs[r];
+    ctx->syscall.operation = operation;
+    ctx->syscall.arg = arg;
+    __atomic_store_n(&ctx->syscall.pending, 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ctx->run_gate, GATE_STOPPED, __ATOMIC_RELEASE);
+    sig_send(kernel_pid, SIG_SYSCALL, SIGVAL_PACK(app_index, ++syscall_seq));
+    park();
+}
 
 /*******************************************************************************
  * syscall_io - Realiza uma chamada de sistema para operação de I/O
  *
- * Esta função simula uma syscall de entrada/saída, enviando uma requisição
- * ao kernel e sinalizando através de um sinal. O processo será bloqueado
+ * Esta função simula uma syscall de entrada/saída, escrevendo a requisição
+ * no slot de syscall do bloco de contexto e sinalizando o kernel. O processo será bloqueado
  * pelo kernel até que a operação de I/O seja concluída.
  *
  * Parâmetros:
  *   operation - Tipo de operação ('R' para READ, 'W' para WRITE)
+ *   block     - Bloco do disco D1 (shared.h)
  *
  * Fluxo de execução:
- *   1. Identifica o PID do kernel (processo pai)
- *   2. Registra a syscall no log para debug
- *   3. Prepara o contexto com PC atual e operação solicitada
- *   4. Envia o contexto ao kernel através do pipe
- *   5. Sinaliza o kernel com SIGUSR2 (IRQ2)
+ *   1. Registra a syscall no log para debug
+ *   2. Preenche o slot de syscall com PC, registradores e operação
+ *   3. Fecha o próprio run_gate e sinaliza o kernel com SIG_SYSCALL (IRQ2)
+ *   4. Estaciona até o kernel despachá-lo novamente
  *
  * Comportamento esperado após a chamada:
- *   - O kernel receberá o sinal e lerá o contexto do pipe
- *   - O processo será bloqueado (SIGSTOP) pelo kernel
+ *   - O kernel receberá o sinal e lerá o slot de syscall do bloco
+ *   - O processo fica estacionado no run_gate durante o I/O
  *   - Quando o I/O terminar, o kernel restaurará o contexto
  *   - O processo continuará executando do PC onde parou
  *
@@ -82,18 +206,144 @@ typedef struct {
  *   - Esta função não retorna imediatamente ao chamador
  *   - O processo fica suspenso até o kernel liberá-lo
  ******************************************************************************/
-void syscall_io(char operation) {
-    pid_t kernel_pid = getppid();
-
+void syscall_io(char operation, int block) {
     if (operation == 'R') {
-        printf("  App (PID %d, PC=%d): syscall READ do disco D1\n", getpid(), pc);
+        printf("  App (PID %d, PC=%d): syscall READ do bloco %d do disco D1\n", getpid(), pc, block);
     } else if (operation == 'W') {
-        printf("  App (PID %d, PC=%d): syscall WRITE no disco D1\n", getpid(), pc);
+        printf("  App (PID %d, PC=%d): syscall WRITE no bloco %d do disco D1\n", getpid(), pc, block);
     }
 
-    SyscallContext ctx = { .pc = pc, .operation = operation };
-    write(pipe_to_kernel_fd, &ctx, sizeof(SyscallContext));
-    kill(kernel_pid, SIGUSR2);
+    syscall_enter(operation, block);
+}
+
+/*******************************************************************************
+ * syscall_fsync - Espera a gravação no disco dos blocos escritos pelo app
+ *
+ * Com a escrita adiada do kernel, um WRITE termina assim que o bloco está no
+ * cache; o FSYNC só volta quando todos os blocos sujos do app foram gravados.
+ ******************************************************************************/
+void syscall_fsync() {
+    printf("  App (PID %d, PC=%d): syscall FSYNC\n", getpid(), pc);
+    syscall_enter('Y', 0);
+}
+
+/*******************************************************************************
+ * syscall_sleep - Pede ao kernel para dormir por 'ms' milissegundos
+ *
+ * O processo fica no estado SLEEPING do kernel, fora da CPU e fora da fila de
+ * prontos, até o kernel acordá-lo em um tick posterior ao prazo.
+ ******************************************************************************/
+void syscall_sleep(int ms) {
+    printf("  App (PID %d, PC=%d): syscall SLEEP de %d ms\n", getpid(), pc, ms);
+    syscall_enter('S', ms);
+}
+
+/*******************************************************************************
+ * syscall_fault - Entrega uma falta de página ao kernel e estaciona
+ *
+ * A falta usa o mesmo caminho das syscalls, com a operação 'F' e a página
+ * virtual no argumento. O kernel bloqueia o processo até a página ser lida
+ * do swap; ao voltar, a TLB é esvaziada se alguma tradução do app foi
+ * desfeita enquanto ele esperava.
+ ******************************************************************************/
+void syscall_fault(uint32_t vpn) {
+    syscall_enter('F', (int)vpn);
+    if (page_table->tlb_epoch != tlb.epoch) {
+        tlb.epoch = page_table->tlb_epoch;
+        tlb_flush(&tlb);
+    }
+}
+
+/*******************************************************************************
+ * vm_touch - Faz uma referência à página virtual 'vpn'
+ *
+ * Procura a tradução na TLB; se não está lá, percorre a tabela de páginas e
+ * guarda a PTE na TLB, marcando a página como referenciada. Se a página não
+ * está presente, entrega a falta ao kernel e tenta de novo ao voltar. Uma
+ * escrita marca a página como modificada na primeira vez.
+ ******************************************************************************/
+void vm_touch(uint32_t vpn, int write) {
+    int e = tlb_lookup(&tlb, vpn);
+
+    if (e >= 0) {
+        tlb.hits++;
+    } else {
+        uint32_t pte;
+        tlb.misses++;
+        while (!((pte = pt_walk(page_table, vpn)) & PTE_PRESENT))
+            syscall_fault(vpn);
+        pt_mark(page_table, vpn, pte, PTE_REF);
+        e = tlb_fill(&tlb, vpn, pte | PTE_REF);
+    }
+    if (write && !(tlb.pte[e] & PTE_DIRTY)) {
+        pt_mark(page_table, vpn, tlb.pte[e], PTE_DIRTY);
+        tlb.pte[e] |= PTE_DIRTY;
+    }
+}
+
+/*******************************************************************************
+ * vm_instruction - Referências à memória de uma instrução
+ *
+ * Uma busca da instrução na região de código e vm_refs - 1 acessos a dados:
+ * VM_STACK_PERMILLE por mil na pilha, VM_FAR_PERMILLE por mil em qualquer
+ * página de dados e os demais no conjunto de trabalho da fase atual (um
+ * quarto da região de dados, que muda a cada VM_PHASE_INSTR instruções). A
+ * sequência é pseudoaleatória, com semente fixa por app.
+ ******************************************************************************/
+void vm_instruction() {
+    uint32_t ws = vm_pages / 4 > 0 ? vm_pages / 4 : 1;
+    uint32_t ws_start = (uint32_t)(pc / VM_PHASE_INSTR) * ws;
+
+    vm_touch((uint32_t)(pc % VM_CODE_PAGES), 0);
+    for (int k = 1; k < vm_refs; k++) {
+        vm_rng ^= vm_rng << 13;
+        vm_rng ^= vm_rng >> 7;
+        vm_rng ^= vm_rng << 17;
+        uint32_t kind = (uint32_t)(vm_rng % 1000);
+        uint32_t r = (uint32_t)(vm_rng >> 16);
+        uint32_t vpn;
+
+        if (kind < VM_STACK_PERMILLE)
+            vpn = PT_MAX_PAGES - 1 - r % VM_STACK_PAGES;
+        else if (kind < VM_STACK_PERMILLE + VM_FAR_PERMILLE)
+            vpn = VM_DATA_BASE + r % vm_pages;
+        else
+            vpn = VM_DATA_BASE + (ws_start + r % ws) % vm_pages;
+        vm_touch(vpn, (vm_rng >> 48) % 100 < VM_WRITE_PCT);
+    }
+
+    ctx->vm_refs = tlb.hits + tlb.misses;
+    ctx->tlb_hits = tlb.hits;
+}
+
+/*******************************************************************************
+ * syscall_exit - Avisa o kernel do término do app
+ *
+ * Envia a syscall EXIT pelo canal normal de syscalls, com o código de saída
+ * e os contadores finais, para que o kernel despache o próximo processo sem
+ * esperar o término ser observado pelo pidfd. O app não estaciona: depois
+ * da syscall ele apenas termina.
+ *
+ * Parâmetros:
+ *   code - Código de saída
+ ******************************************************************************/
+void syscall_exit(int code) {
+    struct timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+    printf("  App (PID %d, PC=%d): syscall EXIT (codigo %d)\n", getpid(), pc, code);
+    fflush(stdout);
+
+    ctx->syscall.pc = pc;
+    ctx->syscall.regs[EXIT_CTR_SYSCALLS] = (int)syscall_seq;
+    ctx->syscall.regs[EXIT_CTR_PARKS] = parks;
+    ctx->syscall.regs[EXIT_CTR_CHECKS] = context_checks;
+    ctx->syscall.regs[EXIT_CTR_CPU_MS] = (int)(cpu.tv_sec * 1000 + cpu.tv_nsec / 1000000);
+    ctx->syscall.operation = 'X';
+    ctx->syscall.arg = code;
+    __atomic_store_n(&ctx->syscall.pending, 1, __ATOMIC_RELEASE);
+
+    sig_send(getppid(), SIG_SYSCALL, SIGVAL_PACK(app_index, ++syscall_seq));
 }
 
 /*******************************************************************************
@@ -106,26 +356,35 @@ void syscall_io(char operation) {
  * Parâmetros:
  *   argc - Número de argumentos da linha de comando
  *   argv - Array de argumentos:
- *          argv[1] = file descriptor do pipe kernel→app (para receber dados)
- *          argv[2] = file descriptor do pipe app→kernel (para enviar dados)
+ *          argv[1] = carga: 'c' (só CPU), 'i' (com I/O), 's' (com SLEEP),
+ *                    'w' (WRITEs e FSYNC) ou 'q' (READs sequenciais)
+ *          argv[2] = file descriptor da área de contextos compartilhada
+ *          argv[3] = índice do app na área de contextos
+ *          argv[4] = duração de cada instrução em ms (opcional)
+ *          argv[5] = duração de cada SLEEP em ms (opcional)
+ *          argv[6] = file descriptor das tabelas de páginas (opcional; sem
+ *                    ele o app não faz referências à memória)
+ *          argv[7] = páginas da região de dados
+ *          argv[8] = referências à memória por instrução
  *
  * Fluxo de execução:
- *   1. Valida os argumentos (deve receber 2 file descriptors)
- *   2. Configura os pipes para comunicação com o kernel
- *   3. Coloca o pipe de leitura em modo não-bloqueante
- *   4. Entra no loop principal de execução:
- *      a. Verifica se há contexto restaurado do kernel (novo PC)
- *      b. Executa a instrução atual (incrementa PC)
- *      c. Faz syscall de I/O em PCs específicos:
- *         - PC 5 e 15: READ
- *         - PC 10 e 20: WRITE
- *      d. Aguarda 1 segundo entre instruções
- *   5. Fecha os pipes ao terminar
+ *   1. Valida os argumentos
+ *   2. Mapeia o seu bloco de contexto
+ *   3. Entra no loop principal de execução:
+ *      a. Lê a geração do bloco; se mudou, estaciona se há pedido de
+ *         preempção e restaura o contexto publicado pelo kernel
+ *      b. Executa a instrução atual (atualiza registradores, faz as
+ *         referências à memória, incrementa PC)
+ *      c. Faz syscalls em PCs específicos:
+ *         - Carga 'i': READ no PC 5 (bloco 5 do arquivo comum) e WRITE no
+ *           PC 8 (na faixa privada do app)
+ *         - Carga 's': SLEEP nos PCs 5 e 8
+ *      d. Aguarda instruction_ms (padrão INSTRUCTION_MS) entre instruções
  *
  * Restauração de contexto:
- *   - O kernel envia um novo PC através do pipe quando o processo retorna
- *     de uma operação de I/O bloqueante
- *   - O pipe não-bloqueante permite verificar sem travar o processo
+ *   - O kernel escreve pc e registradores no bloco e incrementa a geração
+ *     quando o processo retorna de uma operação de I/O bloqueante
+ *   - A verificação é uma única leitura de memória, sem chamada de sistema
  *
  * Syscalls de I/O:
  *   - READ (R): Simula leitura do disco D1
@@ -134,60 +393,98 @@ void syscall_io(char operation) {
  *
  * Término:
  *   - O processo termina após executar MAX_ITERATIONS (30) instruções
- *   - Fecha os pipes antes de sair
  *
  * Retorna:
  *   0 em caso de término normal
  ******************************************************************************/
 int main(int argc, char *argv[]) {
     if (argc < 4) {
-        fprintf(stderr, "Uso: app <fd_from_kernel> <fd_to_kernel> <use_io>\n");
+        fprintf(stderr, "Uso: app <carga> <fd_contextos> <indice> [instrucao_ms] [sleep_ms] "
+                        "[fd_paginas paginas refs]\n");
         exit(1);
     }
 
-    pipe_from_kernel_fd = atoi(argv[1]);
-    pipe_to_kernel_fd = atoi(argv[2]);
-    use_io = atoi(argv[3]); // 0 = sem IO, 1 = com IO
+    load = argv[1][0];
+    int context_fd = atoi(argv[2]);
+    int index = atoi(argv[3]);
+    app_index = index;
+    if (argc > 4 && atoi(argv[4]) > 0)
+        instruction_ms = atoi(argv[4]);
+    if (argc > 5 && atoi(argv[5]) > 0)
+        sleep_ms = atoi(argv[5]);
 
-    fcntl(pipe_from_kernel_fd, F_SETFL, O_NONBLOCK);
+    ctx = mmap(NULL, sizeof(ContextBlock), PROT_READ | PROT_WRITE, MAP_SHARED,
+               context_fd, (off_t)index * sizeof(ContextBlock));
+    if (ctx == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(context_fd);
 
-    printf("App iniciado (PID %d) - IO=%d - Pipes K→A:%d / A→K:%d\n",
-           getpid(), use_io, pipe_from_kernel_fd, pipe_to_kernel_fd);
+    if (argc > 8) {
+        int pt_fd = atoi(argv[6]);
+        vm_pages = atoi(argv[7]);
+        vm_refs = atoi(argv[8]);
+        page_table = mmap(NULL, sizeof(PageTable), PROT_READ | PROT_WRITE, MAP_SHARED,
+                          pt_fd, (off_t)index * sizeof(PageTable));
+        if (page_table == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+        close(pt_fd);
+        tlb_flush(&tlb);
+        tlb.epoch = page_table->tlb_epoch;
+        vm_rng = 0x9e3779b97f4a7c15ull * (uint64_t)(index + 1);
+    }
+
+    printf("App iniciado (PID %d) - carga=%c - Contexto #%d\n", getpid(), load, index);
     fflush(stdout);
 
     while (pc < MAX_ITERATIONS) {
-        int restored_pc = -1;
-        if (read(pipe_from_kernel_fd, &restored_pc, sizeof(int)) > 0) {
-            pc = restored_pc;
-            printf("  App (PID %d): restaurando contexto (PC=%d)\n", getpid(), pc);
-            fflush(stdout);
-        }
+        if (__atomic_load_n(&ctx->generation, __ATOMIC_ACQUIRE) != seen_generation)
+            check_context();
 
+        ctx->app_pc = pc;
+        regs[0] = pc;
+        regs[1] += pc;
         printf("  App (PID %d): executando instrucao (PC=%d)\n", getpid(), pc);
         fflush(stdout);
+        if (page_table && vm_pages > 0 && vm_refs > 0)
+            vm_instruction();
         // para os testes
-        if (use_io) {
+        if (load == 'i') {
             if (pc == 5) {
                 pc++;
-                syscall_io('R');
+                syscall_io('R', 5);
             }
             else if (pc == 8) {
                 pc++;
-                syscall_io('W');
+                syscall_io('W', IO_PRIVATE_BLOCK(app_index, 8));
             }
             else {
                 pc++;
             }
+        } else if (load == 'w' && pc >= 2 && pc <= WRITE_LAST_PC && pc % 2 == 0) {
+            int block = IO_PRIVATE_BLOCK(app_index, (pc / 2) % WRITE_BLOCKS);
+            pc++;
+            syscall_io('W', block);
+        } else if (load == 'w' && pc == FSYNC_PC) {
+            pc++;
+            syscall_fsync();
+        } else if (load == 'q' && pc >= 2 && pc < MAX_ITERATIONS - 2) {
+            int block = pc == SEQ_JUMP_PC ? 5 : IO_PRIVATE_BLOCK(app_index, SEQ_FIRST_BLOCK + pc - 2);
+            pc++;
+            syscall_io('R', block);
+        } else if (load == 's' && (pc == 5 || pc == 8)) {
+            pc++;
+            syscall_sleep(sleep_ms);
         } else {
             pc++;
         }
 
-        sleep(2);
+        instruction_delay();
     }
 
-
-
-    close(pipe_from_kernel_fd);
-    close(pipe_to_kernel_fd);
+    syscall_exit(0);
     return 0;
 }
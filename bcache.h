@@ -0,0 +1,391 @@
+/*******************************************************************************
+ * BCACHE - Cache de blocos do disco com substituição 2Q
+ *
+ * Estrutura usada pelo kernel para guardar os blocos do disco D1 lidos pelos
+ * apps (-C). Cada buffer guarda um bloco e está em um de cinco estados:
+ *
+ *   BC_FREE    - Sem bloco
+ *   BC_READING - Reservado para uma leitura do disco em andamento; não pode
+ *                ser substituído, e outras leituras do mesmo bloco esperam
+ *                por ela em vez de ir ao disco
+ *   BC_VALID   - Com o conteúdo do bloco
+ *   BC_DIRTY   - Com o conteúdo do bloco, escrito por um app e ainda não
+ *                gravado no disco (escrita adiada)
+ *   BC_WRITING - Sendo gravado no disco por um lote de escrita; se for
+ *                escrito de novo antes do fim do lote, volta a BC_DIRTY
+ *
+ * Só buffers BC_VALID podem ser substituídos: blocos sujos ficam no cache
+ * até serem gravados (bc_flush_batch).
+ *
+ * Substituição 2Q (Johnson e Shasha), resistente a varreduras:
+ *   - A1in: FIFO dos blocos lidos uma vez, com até 'kin' (1/4) dos buffers
+ *   - Am:   LRU dos blocos lidos de novo depois de sair de A1in
+ *   - A1out: fila fantasma com os números dos últimos 'kout' (1/2 do número
+ *     de buffers) blocos retirados de A1in, sem conteúdo; um bloco lido de
+ *     novo enquanto está nela volta direto para Am
+ *   - Um bloco lido só uma vez (uma varredura) passa por A1in e sai sem
+ *     deslocar os blocos de Am; o LRU simples perderia todos eles
+ *
+ * Um acerto em Am move o buffer para o fim da LRU; um acerto em A1in não
+ * muda nada (o bloco ainda pode ser de uma rajada de acessos próximos). O
+ * índice bloco → buffer (e bloco → posição fantasma) é a tabela hash de
+ * pidhash.h, com o número do bloco + 1 como chave.
+ *
+ * A memória do cache é fornecida por quem inicializa (bc_mem_size). Todas
+ * as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "pidhash.h"
+
+#define BC_FREE    0
+#define BC_READING 1
+#define BC_VALID   2
+#define BC_DIRTY   3
+#define BC_WRITING 4
+
+#define BC_Q_NONE  0
+#define BC_Q_A1IN  1
+#define BC_Q_AM    2
+
+#define BC_GHOST_STALE UINT32_MAX
+
+/*
+ * BcQueue - Lista de buffers (início: o próximo a sair)
+ */
+typedef struct {
+    int head;
+    int tail;
+    int count;
+} BcQueue;
+
+/*
+ * BCache - Cache de blocos
+ *
+ * Campos:
+ *   nbufs       - Número de buffers
+ *   kin, kout   - Tamanhos de A1in e da fila fantasma A1out
+ *   block       - Bloco de cada buffer
+ *   state       - Estado de cada buffer (BC_*)
+ *   queue       - Lista em que o buffer está (BC_Q_*)
+ *   prev, next  - Encadeamento nas listas (-1 nas pontas)
+ *   a1in, am    - Listas do 2Q
+ *   ghost       - Anel de A1out (BC_GHOST_STALE: posição sem bloco)
+ *   ghost_head  - Posição mais antiga do anel
+ *   ghost_count - Posições ocupadas
+ *   free        - Pilha de buffers livres
+ *   free_count  - Buffers livres
+ *   index       - Bloco + 1 → buffer (0..nbufs-1) ou nbufs + posição em A1out
+ *   sort        - Área de ordenação dos lotes de escrita
+ *   dirty       - Buffers BC_DIRTY ou BC_WRITING
+ *   ghost_hits  - Leituras de blocos encontrados em A1out (estatística)
+ *   evictions   - Blocos retirados do cache (estatística)
+ */
+typedef struct {
+    int nbufs;
+    int kin;
+    int kout;
+    uint32_t *block;
+    uint8_t *state;
+    uint8_t *queue;
+    int *prev;
+    int *next;
+    BcQueue a1in;
+    BcQueue am;
+    uint32_t *ghost;
+    int ghost_head;
+    int ghost_count;
+    int *free;
+    int free_count;
+    PidHash index;
+    uint64_t *sort;
+    int dirty;
+    long ghost_hits;
+    long evictions;
+} BCache;
+
+static inline int bc_kout(int nbufs) {
+    return nbufs / 2 > 0 ? nbufs / 2 : 1;
+}
+
+/*******************************************************************************
+ * bc_mem_size - Bytes de memória necessários para 'nbufs' buffers
+ ******************************************************************************/
+static inline size_t bc_mem_size(int nbufs) {
+    return ph_capacity(nbufs + bc_kout(nbufs)) * sizeof(PidSlot) +
+           (size_t)nbufs * (2 + 4 * sizeof(int) + sizeof(uint32_t) + sizeof(uint64_t)) +
+           (size_t)bc_kout(nbufs) * sizeof(uint32_t);
+}
+
+/*******************************************************************************
+ * bc_init - Inicializa o cache com todos os buffers livres
+ *
+ * Parâmetros:
+ *   mem - Memória com bc_mem_size(nbufs) bytes, alinhada a 8
+ ******************************************************************************/
+static inline void bc_init(BCache *c, int nbufs, void *mem) {
+    unsigned long cap = ph_capacity(nbufs + bc_kout(nbufs));
+    char *m = mem;
+
+    c->nbufs = nbufs;
+    c->kin = nbufs / 4 > 0 ? nbufs / 4 : 1;
+    c->kout = bc_kout(nbufs);
+    ph_init(&c->index, (PidSlot *)m, cap);
+    m += cap * sizeof(PidSlot);
+    c->sort = (uint64_t *)m;
+    m += (size_t)nbufs * sizeof(uint64_t);
+    c->prev = (int *)m;
+    c->next = c->prev + nbufs;
+    c->free = c->next + nbufs;
+    c->block = (uint32_t *)(c->free + nbufs);
+    c->ghost = c->block + nbufs;
+    c->state = (uint8_t *)(c->ghost + c->kout);
+    c->queue = c->state + nbufs;
+
+    for (int b = 0; b < nbufs; b++) {
+        c->state[b] = BC_FREE;
+        c->queue[b] = BC_Q_NONE;
+        c->free[b] = nbufs - 1 - b;
+    }
+    c->free_count = nbufs;
+    c->a1in = (BcQueue){ -1, -1, 0 };
+    c->am = (BcQueue){ -1, -1, 0 };
+    c->ghost_head = 0;
+    c->ghost_count = 0;
+    c->dirty = 0;
+    c->ghost_hits = 0;
+    c->evictions = 0;
+}
+
+static inline BcQueue *bc_queue(BCache *c, int b) {
+    return c->queue[b] == BC_Q_AM ? &c->am : &c->a1in;
+}
+
+static inline void bc_unlink(BCache *c, int b) {
+    BcQueue *q = bc_queue(c, b);
+    if (c->prev[b] >= 0)
+        c->next[c->prev[b]] = c->next[b];
+    else
+        q->head = c->next[b];
+    if (c->next[b] >= 0)
+        c->prev[c->next[b]] = c->prev[b];
+    else
+        q->tail = c->prev[b];
+    q->count--;
+    c->queue[b] = BC_Q_NONE;
+}
+
+static inline void bc_append(BCache *c, int b, int queue) {
+    BcQueue *q;
+    c->queue[b] = (uint8_t)queue;
+    q = bc_queue(c, b);
+    c->prev[b] = q->tail;
+    c->next[b] = -1;
+    if (q->tail >= 0)
+        c->next[q->tail] = b;
+    else
+        q->head = b;
+    q->tail = b;
+    q->count++;
+}
+
+/*******************************************************************************
+ * bc_cached - 1 se o buffer 'b' tem o conteúdo do seu bloco
+ ******************************************************************************/
+static inline int bc_cached(const BCache *c, int b) {
+    return c->state[b] >= BC_VALID;
+}
+
+/*******************************************************************************
+ * bc_lookup - Buffer que guarda (ou está lendo) 'block' (-1 se nenhum)
+ ******************************************************************************/
+static inline int bc_lookup(BCache *c, uint32_t block) {
+    int b = ph_lookup(&c->index, (pid_t)(block + 1));
+    return b >= 0 && b < c->nbufs ? b : -1;
+}
+
+/*******************************************************************************
+ * bc_touch - Registra um acerto no buffer 'b'
+ ******************************************************************************/
+static inline void bc_touch(BCache *c, int b) {
+    if (c->queue[b] == BC_Q_AM && c->am.tail != b) {
+        bc_unlink(c, b);
+        bc_append(c, b, BC_Q_AM);
+    }
+}
+
+static inline void bc_ghost_push(BCache *c, uint32_t block) {
+    if (c->ghost_count == c->kout) {
+        uint32_t old = c->ghost[c->ghost_head];
+        if (old != BC_GHOST_STALE)
+            ph_remove(&c->index, (pid_t)(old + 1));
+        c->ghost_head = (c->ghost_head + 1) % c->kout;
+        c->ghost_count--;
+    }
+    int slot = (c->ghost_head + c->ghost_count) % c->kout;
+    c->ghost[slot] = block;
+    ph_insert(&c->index, (pid_t)(block + 1), c->nbufs + slot);
+    c->ghost_count++;
+}
+
+/*******************************************************************************
+ * bc_evict - Retira o bloco do buffer 'b' do cache e libera o buffer
+ ******************************************************************************/
+static inline void bc_evict(BCache *c, int b) {
+    if (c->queue[b] != BC_Q_NONE)
+        bc_unlink(c, b);
+    ph_remove(&c->index, (pid_t)(c->block[b] + 1));
+    c->state[b] = BC_FREE;
+    c->free[c->free_count++] = b;
+}
+
+/*******************************************************************************
+ * bc_victim - Primeiro buffer válido de uma lista, a partir do início (-1)
+ ******************************************************************************/
+static inline int bc_victim(BCache *c, const BcQueue *q) {
+    for (int b = q->head; b >= 0; b = c->next[b])
+        if (c->state[b] == BC_VALID)
+            return b;
+    return -1;
+}
+
+/*******************************************************************************
+ * bc_reclaim - Libera um buffer para um novo bloco (-1 se todos ocupados)
+ *
+ * Com A1in acima de 'kin' (ou Am sem candidatos), sai o bloco mais antigo de
+ * A1in, cujo número vai para A1out; senão sai o menos usado de Am.
+ ******************************************************************************/
+static inline int bc_reclaim(BCache *c) {
+    int b;
+    if (c->free_count > 0)
+        return c->free[--c->free_count];
+
+    b = c->a1in.count > c->kin ? bc_victim(c, &c->a1in) : -1;
+    if (b < 0)
+        b = bc_victim(c, &c->am);
+    if (b < 0)
+        b = bc_victim(c, &c->a1in);
+    if (b < 0)
+        return -1;
+
+    int from_a1in = c->queue[b] == BC_Q_A1IN;
+    uint32_t block = c->block[b];
+    bc_evict(c, b);
+    if (from_a1in)
+        bc_ghost_push(c, block);
+    c->evictions++;
+    return c->free[--c->free_count];
+}
+
+/*******************************************************************************
+ * bc_alloc - Reserva um buffer para a leitura de 'block' (estado BC_READING)
+ *
+ * O bloco não deve estar no cache (bc_lookup). Se está em A1out, o buffer
+ * entra em Am; senão, em A1in.
+ *
+ * Retorna:
+ *   Número do buffer, ou -1 se todos estão reservados para leituras
+ ******************************************************************************/
+static inline int bc_alloc(BCache *c, uint32_t block) {
+    int g = ph_lookup(&c->index, (pid_t)(block + 1));
+    int queue = BC_Q_A1IN;
+
+    if (g >= c->nbufs) {
+        c->ghost[g - c->nbufs] = BC_GHOST_STALE;
+        ph_remove(&c->index, (pid_t)(block + 1));
+        c->ghost_hits++;
+        queue = BC_Q_AM;
+    }
+    int b = bc_reclaim(c);
+    if (b < 0)
+        return -1;
+    c->block[b] = block;
+    c->state[b] = BC_READING;
+    bc_append(c, b, queue);
+    ph_insert(&c->index, (pid_t)(block + 1), b);
+    return b;
+}
+
+/*******************************************************************************
+ * bc_fill - A leitura do buffer 'b' terminou: o bloco passa a ser válido
+ ******************************************************************************/
+static inline void bc_fill(BCache *c, int b) {
+    c->state[b] = BC_VALID;
+}
+
+/*******************************************************************************
+ * bc_mark_dirty - O bloco do buffer 'b' foi escrito por um app
+ *
+ * O buffer pode estar recém-reservado (bc_alloc, para um bloco escrito
+ * inteiro, sem leitura) ou com conteúdo; um buffer em um lote de escrita
+ * volta a BC_DIRTY e será gravado de novo.
+ ******************************************************************************/
+static inline void bc_mark_dirty(BCache *c, int b) {
+    if (c->state[b] != BC_DIRTY && c->state[b] != BC_WRITING)
+        c->dirty++;
+    c->state[b] = BC_DIRTY;
+}
+
+/*******************************************************************************
+ * bc_clean - Fim da gravação do buffer 'b' de um lote de escrita
+ *
+ * Retorna:
+ *   1 se o buffer ficou limpo, 0 se foi escrito de novo durante o lote
+ ******************************************************************************/
+static inline int bc_clean(BCache *c, int b) {
+    if (c->state[b] != BC_WRITING)
+        return 0;
+    c->state[b] = BC_VALID;
+    c->dirty--;
+    return 1;
+}
+
+static inline int bc_key_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*******************************************************************************
+ * bc_flush_batch - Monta um lote de escrita com os buffers sujos
+ *
+ * Os buffers BC_DIRTY são ordenados pelo número do bloco e o lote pega até
+ * 'max' deles a partir do primeiro bloco >= *cursor, voltando ao início
+ * depois do maior (varredura circular, como o elevador C-SCAN). O cursor
+ * avança para depois do último bloco do lote, de modo que os lotes
+ * seguintes continuam a varredura e nenhum bloco fica esperando para
+ * sempre. Os buffers do lote passam a BC_WRITING.
+ *
+ * Parâmetros:
+ *   cursor - Posição da varredura (atualizada)
+ *   out    - Buffers do lote, em ordem de gravação
+ *
+ * Retorna:
+ *   Número de buffers no lote
+ ******************************************************************************/
+static inline int bc_flush_batch(BCache *c, uint32_t *cursor, int *out, int max) {
+    int n = 0, start = 0, count = 0;
+
+    for (int b = 0; b < c->nbufs; b++)
+        if (c->state[b] == BC_DIRTY)
+            c->sort[n++] = (uint64_t)c->block[b] << 32 | (uint32_t)b;
+    if (n == 0)
+        return 0;
+    qsort(c->sort, (size_t)n, sizeof(uint64_t), bc_key_cmp);
+    while (start < n && (uint32_t)(c->sort[start] >> 32) < *cursor)
+        start++;
+
+    for (int k = 0; k < n && count < max; k++) {
+        int b = (int)(uint32_t)c->sort[(start + k) % n];
+        c->state[b] = BC_WRITING;
+        out[count++] = b;
+    }
+    *cursor = c->block[out[count - 1]] + 1;
+    return count;
+}
+
+#endif
@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * CTXSWITCH - Microbenchmark dos mecanismos de troca de contexto
+ *
+ * Este programa mede o custo de entregar a CPU de um processo para outro
+ * usando diferentes mecanismos de despacho, para que o kernel do simulador
+ * possa escolher o seu com base em dados.
+ *
+ * Modelo medido (igual ao do kernel):
+ *   - Um processo despachante (o "kernel") e dois processos trabalhadores
+ *   - A cada iteração o despachante entrega a vez ao próximo trabalhador
+ *   - O trabalhador registra o instante em que voltou a executar e confirma
+ *   - A latência de entrega é (instante em que rodou - instante do despacho)
+ *
+ * Mecanismos:
+ *   sigstop - kill(SIGSTOP) no antigo e kill(SIGCONT) no novo (atual)
+ *   futex   - Palavra de liberação em memória compartilhada + FUTEX_WAKE
+ *   pipe    - Um byte de "ficha" escrito no pipe do trabalhador
+ *   eventfd - Incremento no eventfd do trabalhador
+ *   yield   - Todos fixados na mesma CPU, espera ativa com sched_yield
+ *
+ * A confirmação do trabalhador para o despachante usa sempre um futex, de
+ * modo que o custo de ida e volta é o mesmo para todos os mecanismos; a
+ * taxa de trocas por segundo inclui esse retorno.
+ *
+ * Saída: JSON em stdout ou no arquivo passado como segundo argumento.
+ *
+ * Uso: ctxswitch [iteracoes] [arquivo.json]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define DEFAULT_ITERATIONS 20000
+#define NUM_WORKERS 2
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/* Mecanismos de despacho avaliados */
+typedef enum { MECH_SIGSTOP, MECH_FUTEX, MECH_PIPE, MECH_EVENTFD, MECH_YIELD } Mechanism;
+
+static const char *mechanism_names[] = { "sigstop", "futex", "pipe", "eventfd", "yield" };
+
+/*
+ * Shared - Página compartilhada entre despachante e trabalhadores
+ *
+ * Campos:
+ *   gate       - Palavra de liberação de cada trabalhador (futex e yield)
+ *   ack        - Contador de confirmações (trabalhador → despachante)
+ *   woke_ns    - Instante em que o trabalhador voltou a executar
+ *   stop       - Pede aos trabalhadores que terminem
+ */
+typedef struct {
+    volatile uint32_t gate[NUM_WORKERS];
+    volatile uint32_t ack;
+    volatile uint64_t woke_ns;
+    volatile int stop;
+} Shared;
+
+/*******************************************************************************
+ * VARIÁVEIS GLOBAIS
+ ******************************************************************************/
+static Shared *shm;
+static int pipes[NUM_WORKERS][2];
+static int evfds[NUM_WORKERS];
+
+/*******************************************************************************
+ * FUNÇÕES AUXILIARES
+ ******************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void futex_wait(volatile uint32_t *addr, uint32_t expected) {
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(volatile uint32_t *addr) {
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void pin_to_cpu0(void) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void handle_cont(int sig) {
+    (void)sig;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+ * worker_wait - Bloqueia o trabalhador até o despachante lhe entregar a vez
+ *
+ * Cada mecanismo tem a sua forma de "ficar fora da CPU". No caso do sigstop o
+ * trabalhador espera em sigsuspend: o despachante o para com SIGSTOP e o
+ * retoma com SIGCONT, cujo handler (vazio) faz o sigsuspend retornar.
+ ******************************************************************************/
+static void worker_wait(Mechanism mech, int me, sigset_t *waitmask) {
+    char token;
+    uint64_t value;
+
+    switch (mech) {
+    case MECH_SIGSTOP:
+        sigsuspend(waitmask);
+        break;
+    case MECH_FUTEX:
+        while (!__atomic_exchange_n(&shm->gate[me], 0, __ATOMIC_ACQUIRE))
+            futex_wait(&shm->gate[me], 0);
+        break;
+    case MECH_PIPE:
+        while (read(pipes[me][0], &token, 1) != 1)
+            ;
+        break;
+    case MECH_EVENTFD:
+        while (read(evfds[me], &value, sizeof(value)) != sizeof(value))
+            ;
+        break;
+    case MECH_YIELD:
+        while (!__atomic_exchange_n(&shm->gate[me], 0, __ATOMIC_ACQUIRE))
+            sched_yield();
+        break;
+    }
+}
+
+/*******************************************************************************
+ * dispatch - Entrega a CPU do trabalhador 'old' para o trabalhador 'new'
+ ******************************************************************************/
+static void dispatch(Mechanism mech, pid_t *pids, int old, int new) {
+    char token = 1;
+    uint64_t value = 1;
+
+    switch (mech) {
+    case MECH_SIGSTOP:
+        if (old >= 0)
+            kill(pids[old], SIGSTOP);
+        kill(pids[new], SIGCONT);
+        break;
+    case MECH_FUTEX:
+        __atomic_store_n(&shm->gate[new], 1, __ATOMIC_RELEASE);
+        futex_wake(&shm->gate[new]);
+        break;
+    case MECH_PIPE:
+        write(pipes[new][1], &token, 1);
+        break;
+    case MECH_EVENTFD:
+        write(evfds[new], &value, sizeof(value));
+        break;
+    case MECH_YIELD:
+        __atomic_store_n(&shm->gate[new], 1, __ATOMIC_RELEASE);
+        break;
+    }
+}
+
+/*******************************************************************************
+ * worker_main - Laço do processo trabalhador
+ *
+ * Espera a vez, registra o instante em que voltou a executar e confirma ao
+ * despachante incrementando 'ack'.
+ ******************************************************************************/
+static void worker_main(Mechanism mech, int me) {
+    sigset_t block, waitmask;
+
+    if (mech == MECH_YIELD)
+        pin_to_cpu0();
+
+    signal(SIGCONT, handle_cont);
+    sigemptyset(&block);
+    sigaddset(&block, SIGCONT);
+    sigprocmask(SIG_BLOCK, &block, &waitmask);
+    sigdelset(&waitmask, SIGCONT);
+
+    // Sinaliza ao despachante que a inicialização terminou
+    __atomic_add_fetch(&shm->ack, 1, __ATOMIC_RELEASE);
+    futex_wake(&shm->ack);
+
+    while (1) {
+        worker_wait(mech, me, &waitmask);
+        if (shm->stop)
+            _exit(0);
+        shm->woke_ns = now_ns();
+        __atomic_add_fetch(&shm->ack, 1, __ATOMIC_RELEASE);
+        futex_wake(&shm->ack);
+    }
+}
+
+/*******************************************************************************
+ * run_mechanism - Executa o benchmark de um mecanismo
+ *
+ * Parâmetros:
+ *   mech       - Mecanismo avaliado
+ *   iterations - Número de despachos
+ *   out        - Arquivo JSON de saída
+ *   last       - Indica se é o último objeto do vetor JSON
+ ******************************************************************************/
+static void run_mechanism(Mechanism mech, int iterations, FILE *out, int last) {
+    pid_t pids[NUM_WORKERS];
+    uint64_t *lat = malloc(iterations * sizeof(uint64_t));
+
+    memset((void *)shm, 0, sizeof(Shared));
+    for (int w = 0; w < NUM_WORKERS; w++) {
+        pipe(pipes[w]);
+        evfds[w] = eventfd(0, 0);
+    }
+
+    if (mech == MECH_YIELD)
+        pin_to_cpu0();
+
+    for (int w = 0; w < NUM_WORKERS; w++) {
+        pids[w] = fork();
+        if (pids[w] == 0)
+            worker_main(mech, w);
+    }
+
+    // Aguarda todos os trabalhadores ficarem prontos antes do primeiro despacho
+    uint32_t ready;
+    while ((ready = shm->ack) < NUM_WORKERS)
+        futex_wait(&shm->ack, ready);
+    if (mech == MECH_SIGSTOP) {
+        for (int w = 0; w < NUM_WORKERS; w++)
+            kill(pids[w], SIGSTOP);
+    }
+
+    int old = -1;
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        int new = i % NUM_WORKERS;
+        uint32_t expected = shm->ack;
+        uint64_t t0 = now_ns();
+
+        dispatch(mech, pids, old, new);
+        while (shm->ack == expected)
+            futex_wait(&shm->ack, expected);
+
+        lat[i] = shm->woke_ns - t0;
+        old = new;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    shm->stop = 1;
+    for (int w = 0; w < NUM_WORKERS; w++) {
+        dispatch(mech, pids, -1, w);
+        kill(pids[w], SIGCONT);
+    }
+    for (int w = 0; w < NUM_WORKERS; w++) {
+        kill(pids[w], SIGKILL);
+        waitpid(pids[w], NULL, 0);
+        close(pipes[w][0]);
+        close(pipes[w][1]);
+        close(evfds[w]);
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < iterations; i++)
+        sum += lat[i];
+    qsort(lat, iterations, sizeof(uint64_t), cmp_u64);
+
+    fprintf(out,
+            "    {\"mechanism\": \"%s\", \"iterations\": %d, "
+            "\"switches_per_sec\": %.1f, \"latency_ns\": {\"min\": %llu, "
+            "\"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+            "\"max\": %llu}}%s\n",
+            mechanism_names[mech], iterations,
+            iterations / (elapsed / 1e9),
+            (unsigned long long)lat[0], (double)sum / iterations,
+            (unsigned long long)lat[iterations / 2],
+            (unsigned long long)lat[(int)(iterations * 0.90)],
+            (unsigned long long)lat[(int)(iterations * 0.99)],
+            (unsigned long long)lat[iterations - 1],
+            last ? "" : ",");
+    fflush(out);
+    free(lat);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do benchmark
+ *
+ * Parâmetros:
+ *   argv[1] - Número de despachos por mecanismo (opcional)
+ *   argv[2] - Arquivo de saída JSON (opcional, padrão stdout)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    int iterations = DEFAULT_ITERATIONS;
+    FILE *out = stdout;
+
+    if (argc > 1)
+        iterations = atoi(argv[1]);
+    if (iterations < 1) {
+        fprintf(stderr, "Uso: %s [iteracoes] [arquivo.json]\n", argv[0]);
+        exit(1);
+    }
+    if (argc > 2 && (out = fopen(argv[2], "w")) == NULL) {
+        perror("fopen");
+        exit(1);
+    }
+
+    shm = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    fprintf(out, "{\n  \"cpus\": %ld,\n  \"results\": [\n", sysconf(_SC_NPROCESSORS_ONLN));
+    int count = sizeof(mechanism_names) / sizeof(mechanism_names[0]);
+    for (int m = 0; m < count; m++)
+        run_mechanism((Mechanism)m, iterations, out, m == count - 1);
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,442 @@
+/*******************************************************************************
+ * PAGEREPL - Benchmark das políticas de substituição de páginas
+ *
+ * Reexecuta traços de referências à memória sobre a máquina de substituição
+ * de pagerepl.h, com QUADROS quadros, para cada política do kernel (-P). A
+ * cada referência, a página é procurada em uma tabela página → quadro; se
+ * presente, a máquina recebe pr_access (como o bit de referência marcado
+ * pelo hardware, mais o movimento na lista do LRU); senão há uma falta, e a
+ * página ocupa um quadro livre ou o escolhido por pr_select. A cada
+ * TICK_REFS referências, pr_tick fecha um intervalo, como a IRQ0 do kernel
+ * (o tempo 'now' da máquina é o número da referência; a janela do wsclock
+ * é de WS_WINDOW_TICKS intervalos).
+ *
+ * Traços sintéticos (TRACE_REFS referências, WRITE_PCT% de escritas):
+ *   loop     - Laço sequencial sobre 25% mais páginas que quadros (o pior
+ *              caso de LRU e FIFO: toda referência falta)
+ *   phases   - Conjuntos de trabalho em fases, como os apps (app.c): uma
+ *              janela de páginas que muda a cada fase, referências à pilha e
+ *              raras referências distantes
+ *   hotcold  - 90% das referências em 10% das páginas, o resto uniforme
+ *   scan     - Um conjunto quente que cabe na memória, interrompido por
+ *              varreduras longas de páginas usadas uma única vez
+ *   random   - Uniforme sobre o dobro de páginas que quadros
+ * Traços em arquivo também podem ser passados: uma referência por linha,
+ * "<página> [w]" (w: escrita); linhas com '#' são ignoradas.
+ *
+ * Para cada traço e política: faltas, retiradas de páginas modificadas,
+ * tempo por referência (ns_per_ref, toda a reexecução), custo próprio da
+ * máquina (engine_ns_per_ref: descontado o laço sem máquina, só com a busca
+ * na tabela) e quadros examinados por escolha de vítima. A referência "opt"
+ * (Belady: sai a página usada mais tarde) dá o mínimo de faltas possível.
+ *
+ * Saída: JSON em stdout ou no arquivo passado como primeiro argumento. O
+ * código de saída é 1 se alguma política escolher um quadro inválido.
+ *
+ * Uso: pagerepl [arquivo.json] [quadros] [traço...]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../pagerepl.h"
+
+#define FRAMES          256
+#define TRACE_REFS      2000000
+#define TICK_REFS       1000
+#define WS_WINDOW_TICKS 4
+#define WRITE_PCT       30
+#define PHASE_REFS      50000
+#define MAX_TRACES      16
+#define REF_WRITE       0x80000000u    // Bit de escrita em uma referência do traço
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/*
+ * Trace - Sequência de referências (página, com REF_WRITE nas escritas)
+ */
+typedef struct {
+    char name[64];
+    uint32_t *refs;
+    long count;
+    uint32_t pages;
+} Trace;
+
+/*
+ * Result - Resultado de uma política sobre um traço
+ */
+typedef struct {
+    long faults;
+    long dirty_evictions;
+    double ns_per_ref;
+    double engine_ns_per_ref;
+    double scan_per_select;
+    int invalid;
+} Result;
+
+/*******************************************************************************
+ * VARIÁVEIS GLOBAIS
+ ******************************************************************************/
+uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+/*******************************************************************************
+ * FUNÇÕES AUXILIARES
+ ******************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+static uint32_t with_write(uint32_t page) {
+    return rng_next() % 100 < WRITE_PCT ? page | REF_WRITE : page;
+}
+
+static Trace trace_alloc(const char *name, long count) {
+    Trace t;
+    snprintf(t.name, sizeof(t.name), "%s", name);
+    t.refs = malloc(count * sizeof(uint32_t));
+    t.count = count;
+    t.pages = 0;
+    if (!t.refs) {
+        perror("malloc");
+        exit(1);
+    }
+    return t;
+}
+
+/*******************************************************************************
+ * GERAÇÃO DOS TRAÇOS
+ ******************************************************************************/
+
+static Trace trace_loop(int frames) {
+    Trace t = trace_alloc("loop", TRACE_REFS);
+    t.pages = frames + frames / 4;
+    for (long i = 0; i < t.count; i++)
+        t.refs[i] = with_write((uint32_t)(i % t.pages));
+    return t;
+}
+
+/*******************************************************************************
+ * trace_phases - Referências no modelo dos apps
+ *
+ * Como vm_instruction em app.c: 10% das referências na pilha (2 páginas),
+ * 0,2% em qualquer página e o resto em uma janela de 'ws' páginas que
+ * avança a cada PHASE_REFS referências. Além das de dados, uma referência de
+ * código a cada 10 (8 páginas).
+ ******************************************************************************/
+static Trace trace_phases(int frames) {
+    Trace t = trace_alloc("phases", TRACE_REFS);
+    uint32_t data = frames * 2, ws = frames / 2;
+    uint32_t code = data, stack = data + 8;
+    t.pages = data + 10;
+    for (long i = 0; i < t.count; i++) {
+        uint32_t r = rng_next() % 1000;
+        uint32_t base = (uint32_t)(i / PHASE_REFS) * ws % data;
+        if (i % 10 == 0)
+            t.refs[i] = code + (uint32_t)(i / 10) % 8;
+        else if (r < 100)
+            t.refs[i] = with_write(stack + r % 2);
+        else if (r < 102)
+            t.refs[i] = with_write(rng_next() % data);
+        else
+            t.refs[i] = with_write((base + rng_next() % ws) % data);
+    }
+    return t;
+}
+
+static Trace trace_hotcold(int frames) {
+    Trace t = trace_alloc("hotcold", TRACE_REFS);
+    uint32_t hot = frames / 2;
+    t.pages = frames * 5;
+    for (long i = 0; i < t.count; i++)
+        t.refs[i] = with_write(rng_next() % 10 < 9 ? rng_next() % hot
+                                                    : hot + rng_next() % (t.pages - hot));
+    return t;
+}
+
+/*******************************************************************************
+ * trace_scan - Conjunto quente interrompido por varreduras
+ *
+ * Um conjunto de 3/4 dos quadros recebe referências aleatórias; a cada
+ * 20.000 referências, uma varredura lê em sequência 'frames' páginas novas,
+ * cada uma uma única vez (como a leitura de um arquivo grande).
+ ******************************************************************************/
+static Trace trace_scan(int frames) {
+    Trace t = trace_alloc("scan", TRACE_REFS);
+    uint32_t hot = frames * 3 / 4, next_cold = hot;
+    long i = 0;
+    t.pages = hot + frames * 16;
+    while (i < t.count) {
+        for (int n = 0; n < 20000 && i < t.count; n++)
+            t.refs[i++] = with_write(rng_next() % hot);
+        for (int n = 0; n < frames && i < t.count; n++) {
+            t.refs[i++] = next_cold;
+            next_cold = next_cold + 1 < t.pages ? next_cold + 1 : hot;
+        }
+    }
+    return t;
+}
+
+static Trace trace_random(int frames) {
+    Trace t = trace_alloc("random", TRACE_REFS);
+    t.pages = frames * 2;
+    for (long i = 0; i < t.count; i++)
+        t.refs[i] = with_write(rng_next() % t.pages);
+    return t;
+}
+
+/*******************************************************************************
+ * trace_load - Lê um traço de arquivo
+ ******************************************************************************/
+static Trace trace_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    long cap = 65536;
+    Trace t = trace_alloc(path, cap);
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    t.count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        unsigned long page = strtoul(line, &end, 10);
+        if (line[0] == '#' || end == line || page >= REF_WRITE)
+            continue;
+        if (t.count == cap) {
+            cap *= 2;
+            t.refs = realloc(t.refs, cap * sizeof(uint32_t));
+            if (!t.refs) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        t.refs[t.count++] = (uint32_t)page | (strchr(end, 'w') ? REF_WRITE : 0);
+        if (page >= t.pages)
+            t.pages = (uint32_t)page + 1;
+    }
+    fclose(f);
+    return t;
+}
+
+/*******************************************************************************
+ * REEXECUÇÃO
+ ******************************************************************************/
+
+/*******************************************************************************
+ * run_baseline - Laço de reexecução sem a máquina (ns por referência)
+ *
+ * Faz a mesma busca página → quadro, com todas as páginas presentes, para
+ * descontar do tempo das políticas o custo que não é da máquina.
+ ******************************************************************************/
+static double run_baseline(const Trace *t) {
+    int *page_frame = malloc(t->pages * sizeof(int));
+    volatile long sum = 0;
+    for (uint32_t p = 0; p < t->pages; p++)
+        page_frame[p] = (int)p;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < t->count; i++)
+        sum += page_frame[t->refs[i] & ~REF_WRITE];
+    double ns = (double)(now_ns() - t0) / t->count;
+    free(page_frame);
+    return ns;
+}
+
+/*******************************************************************************
+ * run_policy - Reexecuta o traço com uma política
+ ******************************************************************************/
+static Result run_policy(const Trace *t, const PrPolicy *policy, int frames, double base_ns) {
+    Result res = { 0 };
+    PrEngine e;
+    void *mem = malloc(pr_mem_size(frames));
+    int *page_frame = malloc(t->pages * sizeof(int));
+    uint32_t *frame_page = malloc(frames * sizeof(uint32_t));
+    int used = 0;
+
+    if (!mem || !page_frame || !frame_page) {
+        perror("malloc");
+        exit(1);
+    }
+    for (uint32_t p = 0; p < t->pages; p++)
+        page_frame[p] = -1;
+    pr_init(&e, policy, frames, mem);
+    e.tau = (uint64_t)WS_WINDOW_TICKS * TICK_REFS;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < t->count; i++) {
+        uint32_t page = t->refs[i] & ~REF_WRITE;
+        int write = (t->refs[i] & REF_WRITE) != 0;
+        int f = page_frame[page];
+
+        e.now = (uint64_t)i;
+        if (i % TICK_REFS == 0)
+            pr_tick(&e);
+        if (f >= 0) {
+            pr_access(&e, f, write);
+            continue;
+        }
+
+        res.faults++;
+        if (used < frames) {
+            f = used++;
+        } else {
+            f = pr_select(&e);
+            if (f < 0 || f >= frames || !pr_test(e.valid, f)) {
+                res.invalid = 1;
+                break;
+            }
+            if (pr_test(e.dirty, f))
+                res.dirty_evictions++;
+            pr_remove(&e, f);
+            page_frame[frame_page[f]] = -1;
+        }
+        page_frame[page] = f;
+        frame_page[f] = page;
+        pr_load(&e, f);
+        if (write)
+            pr_set(e.dirty, f);
+    }
+    res.ns_per_ref = (double)(now_ns() - t0) / t->count;
+    res.engine_ns_per_ref = res.ns_per_ref > base_ns ? res.ns_per_ref - base_ns : 0.0;
+    res.scan_per_select = e.selects ? (double)e.scanned / e.selects : 0.0;
+
+    free(mem);
+    free(page_frame);
+    free(frame_page);
+    return res;
+}
+
+/*******************************************************************************
+ * run_opt - Faltas do algoritmo ótimo de Belady
+ *
+ * O próximo uso de cada referência é calculado de trás para frente; na
+ * falta, sai a página residente cujo próximo uso está mais distante.
+ ******************************************************************************/
+static long run_opt(const Trace *t, int frames) {
+    long *next_use = malloc(t->count * sizeof(long));
+    long *last = malloc(t->pages * sizeof(long));
+    int *page_frame = malloc(t->pages * sizeof(int));
+    uint32_t *frame_page = malloc(frames * sizeof(uint32_t));
+    long *frame_next = malloc(frames * sizeof(long));
+    long faults = 0;
+    int used = 0;
+
+    if (!next_use || !last || !page_frame || !frame_page || !frame_next) {
+        perror("malloc");
+        exit(1);
+    }
+    for (uint32_t p = 0; p < t->pages; p++) {
+        last[p] = t->count;
+        page_frame[p] = -1;
+    }
+    for (long i = t->count - 1; i >= 0; i--) {
+        uint32_t page = t->refs[i] & ~REF_WRITE;
+        next_use[i] = last[page];
+        last[page] = i;
+    }
+
+    for (long i = 0; i < t->count; i++) {
+        uint32_t page = t->refs[i] & ~REF_WRITE;
+        int f = page_frame[page];
+        if (f < 0) {
+            faults++;
+            if (used < frames) {
+                f = used++;
+            } else {
+                f = 0;
+                for (int c = 1; c < frames; c++)
+                    if (frame_next[c] > frame_next[f])
+                        f = c;
+                page_frame[frame_page[f]] = -1;
+            }
+            page_frame[page] = f;
+            frame_page[f] = page;
+        }
+        frame_next[f] = next_use[i];
+    }
+
+    free(next_use);
+    free(last);
+    free(page_frame);
+    free(frame_page);
+    free(frame_next);
+    return faults;
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do benchmark
+ *
+ * Parâmetros:
+ *   argv[1]  - Arquivo de saída JSON (opcional, padrão stdout)
+ *   argv[2]  - Número de quadros (padrão FRAMES)
+ *   argv[3+] - Traços em arquivo (padrão: os traços sintéticos)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    FILE *out = stdout;
+    int frames = FRAMES;
+    Trace traces[MAX_TRACES];
+    int num_traces = 0, invalid = 0;
+
+    if (argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+        perror("fopen");
+        exit(1);
+    }
+    if (argc > 2 && atoi(argv[2]) >= 64)
+        frames = atoi(argv[2]);
+    for (int a = 3; a < argc && num_traces < MAX_TRACES; a++)
+        traces[num_traces++] = trace_load(argv[a]);
+    if (num_traces == 0) {
+        traces[num_traces++] = trace_loop(frames);
+        traces[num_traces++] = trace_phases(frames);
+        traces[num_traces++] = trace_hotcold(frames);
+        traces[num_traces++] = trace_scan(frames);
+        traces[num_traces++] = trace_random(frames);
+    }
+
+    fprintf(out, "{\n  \"frames\": %d,\n  \"tick_refs\": %d,\n  \"ws_window_refs\": %d,\n"
+                 "  \"traces\": [\n", frames, TICK_REFS, WS_WINDOW_TICKS * TICK_REFS);
+    for (int n = 0; n < num_traces; n++) {
+        const Trace *t = &traces[n];
+        double base_ns = run_baseline(t);
+
+        fprintf(out, "    {\"trace\": \"%s\", \"refs\": %ld, \"pages\": %u, "
+                     "\"opt_faults\": %ld, \"baseline_ns_per_ref\": %.2f,\n"
+                     "     \"policies\": [\n",
+                t->name, t->count, t->pages, run_opt(t, frames), base_ns);
+        for (int p = 0; p < PR_NUM_POLICIES; p++) {
+            Result r = run_policy(t, &pr_policies[p], frames, base_ns);
+            invalid |= r.invalid;
+            fprintf(out, "       {\"policy\": \"%s\", \"faults\": %ld, "
+                         "\"faults_per_1k_refs\": %.3f, \"dirty_evictions\": %ld, "
+                         "\"ns_per_ref\": %.2f, \"engine_ns_per_ref\": %.2f, "
+                         "\"scan_per_select\": %.2f, \"valid\": %s}%s\n",
+                    pr_policies[p].name, r.faults, 1000.0 * r.faults / t->count,
+                    r.dirty_evictions, r.ns_per_ref, r.engine_ns_per_ref, r.scan_per_select, r.invalid ? "false" : "true",
+                    p == PR_NUM_POLICIES - 1 ? "" : ",");
+        }
+        fprintf(out, "     ]}%s\n", n == num_traces - 1 ? "" : ",");
+        fflush(out);
+        free(traces[n].refs);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return invalid;
+}
@@ -0,0 +1,219 @@
+/*******************************************************************************
+ * PRIOARRAY - Benchmark da fila O(1) por prioridade contra a busca linear
+ *
+ * Compara a fila com mapa de bits e arrays ativo/expirado (prioarray.h) com
+ * uma tabela de processos percorrida inteira a cada escolha, como fazia o
+ * escalonador original. Com N processos prontos de prioridades aleatórias
+ * (100..139, os níveis de nice), cada rodada:
+ *
+ *   pick    - Escolhe e retira o processo de maior prioridade (o que está há
+ *             mais tempo no nível, em caso de empate)
+ *   enqueue - Devolve o processo, no array expirado em metade das vezes (fatia
+ *             esgotada) e no ativo nas demais
+ *
+ * As duas estruturas recebem a mesma sequência de operações; o benchmark
+ * verifica que elas escolhem os mesmos processos.
+ *
+ * Saída: JSON em stdout ou no arquivo passado como primeiro argumento.
+ *
+ * Uso: prioarray [arquivo.json]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "../prioarray.h"
+
+#define PRIO_FIRST 100
+#define ROUNDS     20000
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/*
+ * LinearTask - Entrada da tabela percorrida pela busca linear
+ *
+ * Campos:
+ *   prio    - Prioridade estática
+ *   ready   - 1 se está na fila
+ *   expired - 1 se está no array expirado
+ *   seq     - Ordem de chegada ao nível (desempate FIFO)
+ */
+typedef struct {
+    int prio;
+    int ready;
+    int expired;
+    uint64_t seq;
+} LinearTask;
+
+/*
+ * Result - Tempo medido (ns por rodada) e verificação de uma estrutura
+ */
+typedef struct {
+    double pick_ns;
+    double enqueue_ns;
+    uint64_t checksum;
+} Result;
+
+/*******************************************************************************
+ * FUNÇÕES AUXILIARES
+ ******************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/*******************************************************************************
+ * run_prioarray - Executa as rodadas na fila O(1)
+ ******************************************************************************/
+static Result run_prioarray(long n, const int *prios, const uint8_t *expire) {
+    Result res = { 0 };
+    PrioNode *nodes = malloc(n * sizeof(PrioNode));
+    PrioRunqueue *rq = malloc(sizeof(PrioRunqueue));
+    uint64_t pick_total = 0, enqueue_total = 0;
+
+    prq_init(rq);
+    for (long i = 0; i < n; i++) {
+        pa_node_init(&nodes[i], prios[i]);
+        prq_enqueue(rq, &nodes[i], 0);
+    }
+
+    for (long r = 0; r < ROUNDS; r++) {
+        uint64_t t0 = now_ns();
+        PrioNode *best = prq_peek(rq);
+        pa_remove(best);
+        uint64_t t1 = now_ns();
+        prq_enqueue(rq, best, expire[r]);
+        uint64_t t2 = now_ns();
+
+        pick_total += t1 - t0;
+        enqueue_total += t2 - t1;
+        res.checksum = res.checksum * 31 + (uint64_t)(best - nodes);
+    }
+
+    res.pick_ns = (double)pick_total / ROUNDS;
+    res.enqueue_ns = (double)enqueue_total / ROUNDS;
+    free(rq);
+    free(nodes);
+    return res;
+}
+
+/*******************************************************************************
+ * run_linear - Executa as rodadas com a busca linear na tabela
+ *
+ * Mesma semântica da fila O(1): escolhe entre os processos do array ativo e,
+ * se não houver nenhum, promove todos os expirados a ativos.
+ ******************************************************************************/
+static Result run_linear(long n, const int *prios, const uint8_t *expire) {
+    Result res = { 0 };
+    LinearTask *tasks = malloc(n * sizeof(LinearTask));
+    uint64_t pick_total = 0, enqueue_total = 0, seq = 0;
+
+    for (long i = 0; i < n; i++) {
+        tasks[i].prio = prios[i];
+        tasks[i].ready = 1;
+        tasks[i].expired = 0;
+        tasks[i].seq = seq++;
+    }
+
+    for (long r = 0; r < ROUNDS; r++) {
+        uint64_t t0 = now_ns();
+        long best = -1;
+        for (int pass = 0; pass < 2 && best < 0; pass++) {
+            for (long i = 0; i < n; i++) {
+                if (!tasks[i].ready || tasks[i].expired)
+                    continue;
+                if (best < 0 || tasks[i].prio < tasks[best].prio ||
+                    (tasks[i].prio == tasks[best].prio && tasks[i].seq < tasks[best].seq))
+                    best = i;
+            }
+            if (best < 0)
+                for (long i = 0; i < n; i++)
+                    tasks[i].expired = 0;
+        }
+        tasks[best].ready = 0;
+        uint64_t t1 = now_ns();
+        tasks[best].ready = 1;
+        tasks[best].expired = expire[r];
+        tasks[best].seq = seq++;
+        uint64_t t2 = now_ns();
+
+        pick_total += t1 - t0;
+        enqueue_total += t2 - t1;
+        res.checksum = res.checksum * 31 + (uint64_t)best;
+    }
+
+    res.pick_ns = (double)pick_total / ROUNDS;
+    res.enqueue_ns = (double)enqueue_total / ROUNDS;
+    free(tasks);
+    return res;
+}
+
+/*******************************************************************************
+ * print_result - Escreve um objeto JSON com o resultado de uma estrutura
+ ******************************************************************************/
+static void print_result(FILE *out, const char *name, long n, Result r, int match, int last) {
+    fprintf(out,
+            "    {\"structure\": \"%s\", \"tasks\": %ld, \"pick_ns\": %.1f, "
+            "\"enqueue_ns\": %.1f, \"same_picks\": %s}%s\n",
+            name, n, r.pick_ns, r.enqueue_ns, match ? "true" : "false",
+            last ? "" : ",");
+    fflush(out);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do benchmark
+ *
+ * Parâmetros:
+ *   argv[1] - Arquivo de saída JSON (opcional, padrão stdout)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    static const long sizes[] = { 1000, 10000, 100000 };
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+    FILE *out = stdout;
+
+    if (argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+        perror("fopen");
+        exit(1);
+    }
+
+    fprintf(out, "{\n  \"rounds\": %d,\n  \"results\": [\n", ROUNDS);
+    for (int s = 0; s < count; s++) {
+        long n = sizes[s];
+        int *prios = malloc(n * sizeof(int));
+        uint8_t *expire = malloc(ROUNDS);
+
+        for (long i = 0; i < n; i++)
+            prios[i] = PRIO_FIRST + (int)(rng() % (PA_LEVELS - PRIO_FIRST));
+        for (long r = 0; r < ROUNDS; r++)
+            expire[r] = rng() & 1;
+
+        Result fast = run_prioarray(n, prios, expire);
+        Result slow = run_linear(n, prios, expire);
+        int match = fast.checksum == slow.checksum;
+        print_result(out, "linear", n, slow, match, 0);
+        print_result(out, "prioarray", n, fast, match, s == count - 1);
+
+        free(prios);
+        free(expire);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
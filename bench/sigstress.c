@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * SIGSTRESS - Teste de carga da entrega de sinais (perda de eventos)
+ *
+ * Reproduz o caminho de interrupções do kernel: processos remetentes enviam
+ * eventos numerados com sigqueue a um receptor cujo handler (top half, com
+ * SA_SIGINFO) só registra o valor em um anel sem travas, esvaziado por um
+ * laço com sigsuspend (bottom half), como em kernel.c.
+ *
+ * Cada remetente envia a sua parte da taxa alvo em rajadas de 1 ms, com o
+ * valor SIGVAL_PACK(remetente, sequência) de shared.h; se a fila de sinais
+ * pendentes enche, sig_send tenta de novo (send_retries). O receptor marca
+ * cada par (remetente, sequência) recebido e, ao final, conta os perdidos e
+ * os duplicados.
+ *
+ * Canais comparados:
+ *   SIGUSR2      - Sinal comum: envios que chegam enquanto o sinal já está
+ *                  pendente se fundem em um só (eventos perdidos)
+ *   SIG_SYSCALL  - Sinal de tempo real: cada envio é enfileirado
+ *
+ * Saída: JSON em stdout ou no arquivo passado como primeiro argumento. O
+ * código de saída é 1 se o canal de tempo real perder algum evento.
+ *
+ * Uso: sigstress [arquivo.json] [eventos_por_segundo] [segundos]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../shared.h"
+
+#define SENDERS     4
+#define RATE        100000
+#define DURATION_S  2
+#define RING_SIZE   65536       // Potência de 2, maior que RLIMIT_SIGPENDING
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/*
+ * Result - Contagens de uma rodada com um canal
+ */
+typedef struct {
+    long sent;
+    long received;
+    long lost;
+    long duplicates;
+    long send_retries;
+    long overflows;
+    long max_batch;
+    double elapsed_s;
+} Result;
+
+/*******************************************************************************
+ * VARIÁVEIS GLOBAIS
+ ******************************************************************************/
+int ring[RING_SIZE];
+volatile unsigned long ring_head = 0;
+volatile unsigned long ring_tail = 0;
+volatile long ring_overflows = 0;
+volatile int child_event = 0;      // SIGCHLD recebido desde a última coleta
+
+/*******************************************************************************
+ * FUNÇÕES AUXILIARES
+ ******************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * top_half - Handler do receptor: registra o valor no anel
+ ******************************************************************************/
+static void top_half(int sig, siginfo_t *si, void *uc) {
+    if (sig == SIGCHLD) {
+        child_event = 1;
+        return;
+    }
+    unsigned long head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+        ring_overflows++;
+        return;
+    }
+    ring[head % RING_SIZE] = si->si_value.sival_int;
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+ * run_sender - Corpo de um remetente: envia 'count' eventos no ritmo 'rate'
+ *
+ * O envio segue prazos absolutos de 1 ms; se o remetente se atrasa, a
+ * rajada seguinte compensa, de modo que a taxa média é mantida.
+ ******************************************************************************/
+static void run_sender(pid_t receiver, int sig, int id, long count, long rate,
+                       long *retries) {
+    uint64_t start = now_ns();
+    long seq = 0;
+
+    while (seq < count) {
+        uint64_t elapsed = now_ns() - start;
+        long due = (long)((elapsed / 1000000 + 1) * rate / 1000);
+        if (due > count)
+            due = count;
+        for (; seq < due; seq++) {
+            long r = sig_send(receiver, sig, SIGVAL_PACK(id, seq + 1));
+            if (r < 0)
+                _exit(1);
+            *retries += r;
+        }
+
+        struct timespec next;
+        uint64_t at = start + (elapsed / 1000000 + 1) * 1000000;
+        next.tv_sec = at / 1000000000ull;
+        next.tv_nsec = at % 1000000000ull;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    _exit(0);
+}
+
+/*******************************************************************************
+ * drain - Bottom half: retira as entradas do anel e marca os eventos
+ ******************************************************************************/
+static void drain(uint8_t *seen, long per_sender, Result *res) {
+    unsigned long head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    long batch = (long)(head - ring_tail);
+
+    for (unsigned long t = ring_tail; t != head; t++) {
+        int v = ring[t % RING_SIZE];
+        int id = SIGVAL_INDEX(v);
+        long seq = SIGVAL_SEQ(v);
+        if (id < 0 || id >= SENDERS || seq < 1 || seq > per_sender)
+            continue;
+        if (seen[id * per_sender + seq - 1]++)
+            res->duplicates++;
+        res->received++;
+    }
+    __atomic_store_n(&ring_tail, head, __ATOMIC_RELEASE);
+    if (batch > res->max_batch)
+        res->max_batch = batch;
+}
+
+/*******************************************************************************
+ * run_channel - Executa uma rodada completa com o sinal 'sig'
+ *
+ * Os eventos ficam bloqueados fora de sigsuspend, como no kernel. Depois que
+ * todos os remetentes terminam, os sinais ainda pendentes são entregues com
+ * um último desbloqueio antes da contagem.
+ ******************************************************************************/
+static Result run_channel(int sig, long rate, int seconds) {
+    Result res = { 0 };
+    long per_sender = rate * seconds / SENDERS;
+    long *retries = mmap(NULL, SENDERS * sizeof(long), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    uint8_t *seen = calloc(SENDERS * per_sender, 1);
+    if (retries == MAP_FAILED || !seen) {
+        perror("alloc");
+        exit(1);
+    }
+    memset(retries, 0, SENDERS * sizeof(long));
+    ring_head = ring_tail = 0;
+    ring_overflows = 0;
+    child_event = 0;
+
+    struct sigaction sa;
+    sigset_t block, wait_mask;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = top_half;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&block);
+    sigaddset(&block, sig);
+    sigaddset(&block, SIGCHLD);
+    sa.sa_mask = block;
+    sigaction(sig, &sa, NULL);
+    sigaction(SIGCHLD, &sa, NULL);
+    sigprocmask(SIG_BLOCK, &block, &wait_mask);
+    sigdelset(&wait_mask, sig);
+    sigdelset(&wait_mask, SIGCHLD);
+
+    pid_t receiver = getpid();
+    uint64_t start = now_ns();
+    for (int id = 0; id < SENDERS; id++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            sigprocmask(SIG_UNBLOCK, &block, NULL);
+            run_sender(receiver, sig, id, per_sender, rate / SENDERS, &retries[id]);
+        }
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+    }
+
+    // Testar e dormir com os sinais bloqueados, como bottom_half_loop
+    int running = SENDERS;
+    while (running > 0) {
+        while (ring_head == ring_tail && !child_event)
+            sigsuspend(&wait_mask);
+        sigprocmask(SIG_UNBLOCK, &block, NULL);
+        drain(seen, per_sender, &res);
+        sigprocmask(SIG_BLOCK, &block, NULL);
+
+        // Vários SIGCHLD podem se fundir em um: coleta todos os terminados
+        child_event = 0;
+        while (waitpid(-1, NULL, WNOHANG) > 0)
+            running--;
+    }
+    sigprocmask(SIG_UNBLOCK, &block, NULL);
+    drain(seen, per_sender, &res);
+    res.elapsed_s = (now_ns() - start) / 1e9;
+
+    res.sent = per_sender * SENDERS;
+    for (long i = 0; i < SENDERS * per_sender; i++)
+        res.lost += !seen[i];
+    for (int id = 0; id < SENDERS; id++)
+        res.send_retries += retries[id];
+    res.overflows = ring_overflows;
+
+    signal(sig, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    munmap(retries, SENDERS * sizeof(long));
+    free(seen);
+    return res;
+}
+
+/*******************************************************************************
+ * print_result - Escreve um objeto JSON com o resultado de um canal
+ ******************************************************************************/
+static void print_result(FILE *out, const char *name, Result r, int last) {
+    fprintf(out,
+            "    {\"channel\": \"%s\", \"sent\": %ld, \"received\": %ld, "
+            "\"lost\": %ld, \"duplicates\": %ld, \"events_per_sec\": %.0f, "
+            "\"send_retries\": %ld, \"ring_overflows\": %ld, \"max_batch\": %ld}%s\n",
+            name, r.sent, r.received, r.lost, r.duplicates,
+            r.elapsed_s > 0 ? r.received / r.elapsed_s : 0.0,
+            r.send_retries, r.overflows, r.max_batch, last ? "" : ",");
+    fflush(out);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do teste
+ *
+ * Parâmetros:
+ *   argv[1] - Arquivo de saída JSON (opcional, padrão stdout)
+ *   argv[2] - Taxa total de eventos por segundo (padrão RATE)
+ *   argv[3] - Duração de cada rodada em segundos (padrão DURATION_S)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    FILE *out = stdout;
+    long rate = RATE;
+    int seconds = DURATION_S;
+
+    if (argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+        perror("fopen");
+        exit(1);
+    }
+    if (argc > 2 && atol(argv[2]) > 0)
+        rate = atol(argv[2]);
+    if (argc > 3 && atoi(argv[3]) > 0)
+        seconds = atoi(argv[3]);
+
+    Result plain = run_channel(SIGUSR2, rate, seconds);
+    Result queued = run_channel(SIG_SYSCALL, rate, seconds);
+
+    fprintf(out, "{\n  \"senders\": %d,\n  \"target_events_per_sec\": %ld,\n"
+                 "  \"seconds\": %d,\n  \"results\": [\n", SENDERS, rate, seconds);
+    print_result(out, "SIGUSR2", plain, 0);
+    print_result(out, "SIG_SYSCALL", queued, 1);
+    fprintf(out, "  ],\n  \"lossless\": %s\n}\n",
+            queued.lost == 0 && queued.duplicates == 0 ? "true" : "false");
+
+    if (out != stdout)
+        fclose(out);
+    return queued.lost == 0 && queued.duplicates == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/*******************************************************************************
+ * TIMERS - Benchmark da roda de temporizadores contra um heap binário
+ *
+ * Compara a roda hierárquica (timerwheel.h) com uma fila de prioridade em
+ * heap binário (com índice no próprio temporizador, para permitir o
+ * cancelamento) nas três operações que o simulador usa:
+ *
+ *   insert - Agenda N temporizadores com prazos aleatórios em [1, RANGE]
+ *   cancel - Cancela metade deles, em ordem aleatória
+ *   expire - Avança o relógio tick a tick até que todos os restantes expirem
+ *
+ * Também verifica que cada temporizador expirou exatamente no seu tick.
+ *
+ * Saída: JSON em stdout ou no arquivo passado como primeiro argumento.
+ *
+ * Uso: timers [arquivo.json]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "../timerwheel.h"
+
+#define RANGE_TICKS 60000       // 60 s com ticks de 1 ms
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/*
+ * HeapTimer - Temporizador do heap binário
+ *
+ * Campos:
+ *   expires - Tick de expiração
+ *   index   - Posição atual no heap (-1 se inativo)
+ */
+typedef struct {
+    uint64_t expires;
+    long index;
+} HeapTimer;
+
+/*
+ * Result - Tempos medidos (ns por operação) e verificação de uma estrutura
+ */
+typedef struct {
+    double insert_ns;
+    double cancel_ns;
+    double expire_ns;
+    long expired;
+    long late;
+} Result;
+
+/*******************************************************************************
+ * VARIÁVEIS GLOBAIS
+ ******************************************************************************/
+static HeapTimer **heap;
+static long heap_size;
+static TimerWheel wheel;
+static long wheel_expired, wheel_late;
+
+/*******************************************************************************
+ * FUNÇÕES AUXILIARES
+ ******************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/*******************************************************************************
+ * HEAP BINÁRIO
+ ******************************************************************************/
+
+static void heap_swap(long a, long b) {
+    HeapTimer *t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    heap[a]->index = a;
+    heap[b]->index = b;
+}
+
+static void heap_up(long i) {
+    while (i > 0 && heap[(i - 1) / 2]->expires > heap[i]->expires) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(long i) {
+    for (;;) {
+        long smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < heap_size && heap[l]->expires < heap[smallest]->expires)
+            smallest = l;
+        if (r < heap_size && heap[r]->expires < heap[smallest]->expires)
+            smallest = r;
+        if (smallest == i)
+            return;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_insert(HeapTimer *t) {
+    t->index = heap_size;
+    heap[heap_size++] = t;
+    heap_up(t->index);
+}
+
+static void heap_remove(HeapTimer *t) {
+    long i = t->index;
+    heap_size--;
+    if (i != heap_size) {
+        heap[i] = heap[heap_size];
+        heap[i]->index = i;
+        heap_up(i);
+        heap_down(heap[i]->index);
+    }
+    t->index = -1;
+}
+
+/*******************************************************************************
+ * run_heap - Executa as três fases no heap binário
+ ******************************************************************************/
+static Result run_heap(long n, const uint64_t *expires, const long *order) {
+    Result res = { 0 };
+    HeapTimer *timers = malloc(n * sizeof(HeapTimer));
+    heap = malloc(n * sizeof(HeapTimer *));
+    heap_size = 0;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < n; i++) {
+        timers[i].expires = expires[i];
+        heap_insert(&timers[i]);
+    }
+    uint64_t t1 = now_ns();
+    for (long i = 0; i < n / 2; i++)
+        heap_remove(&timers[order[i]]);
+    uint64_t t2 = now_ns();
+    for (uint64_t tick = 1; tick <= RANGE_TICKS; tick++) {
+        while (heap_size > 0 && heap[0]->expires <= tick) {
+            if (heap[0]->expires != tick)
+                res.late++;
+            heap_remove(heap[0]);
+            res.expired++;
+        }
+    }
+    uint64_t t3 = now_ns();
+
+    res.insert_ns = (double)(t1 - t0) / n;
+    res.cancel_ns = (double)(t2 - t1) / (n / 2);
+    res.expire_ns = res.expired ? (double)(t3 - t2) / res.expired : 0;
+    free(heap);
+    free(timers);
+    return res;
+}
+
+/*******************************************************************************
+ * RODA DE TEMPORIZADORES
+ ******************************************************************************/
+
+static void wheel_fired(Timer *t) {
+    if (t->expires != wheel.now)
+        wheel_late++;
+    wheel_expired++;
+}
+
+/*******************************************************************************
+ * run_wheel - Executa as três fases na roda de temporizadores
+ ******************************************************************************/
+static Result run_wheel(long n, const uint64_t *expires, const long *order) {
+    Result res = { 0 };
+    Timer *timers = malloc(n * sizeof(Timer));
+
+    tw_init(&wheel, 0);
+    wheel_expired = wheel_late = 0;
+    for (long i = 0; i < n; i++)
+        tw_timer_init(&timers[i], wheel_fired, NULL);
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < n; i++)
+        tw_add(&wheel, &timers[i], expires[i]);
+    uint64_t t1 = now_ns();
+    for (long i = 0; i < n / 2; i++)
+        tw_cancel(&wheel, &timers[order[i]]);
+    uint64_t t2 = now_ns();
+    for (uint64_t tick = 1; tick <= RANGE_TICKS; tick++)
+        tw_advance(&wheel, tick);
+    uint64_t t3 = now_ns();
+
+    res.expired = wheel_expired;
+    res.late = wheel_late;
+    res.insert_ns = (double)(t1 - t0) / n;
+    res.cancel_ns = (double)(t2 - t1) / (n / 2);
+    res.expire_ns = res.expired ? (double)(t3 - t2) / res.expired : 0;
+    free(timers);
+    return res;
+}
+
+/*******************************************************************************
+ * print_result - Escreve um objeto JSON com o resultado de uma estrutura
+ ******************************************************************************/
+static void print_result(FILE *out, const char *name, long n, Result r, int last) {
+    fprintf(out,
+            "    {\"structure\": \"%s\", \"timers\": %ld, \"insert_ns\": %.1f, "
+            "\"cancel_ns\": %.1f, \"expire_ns\": %.1f, \"expired\": %ld, "
+            "\"late\": %ld}%s\n",
+            name, n, r.insert_ns, r.cancel_ns, r.expire_ns, r.expired, r.late,
+            last ? "" : ",");
+    fflush(out);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do benchmark
+ *
+ * Parâmetros:
+ *   argv[1] - Arquivo de saída JSON (opcional, padrão stdout)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    static const long sizes[] = { 1000, 10000, 100000, 500000 };
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+    FILE *out = stdout;
+
+    if (argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+        perror("fopen");
+        exit(1);
+    }
+
+    fprintf(out, "{\n  \"range_ticks\": %d,\n  \"results\": [\n", RANGE_TICKS);
+    for (int s = 0; s < count; s++) {
+        long n = sizes[s];
+        uint64_t *expires = malloc(n * sizeof(uint64_t));
+        long *order = malloc(n * sizeof(long));
+
+        for (long i = 0; i < n; i++) {
+            expires[i] = 1 + rng() % RANGE_TICKS;
+            order[i] = i;
+        }
+        for (long i = n - 1; i > 0; i--) {
+            long j = (long)(rng() % (uint64_t)(i + 1));
+            long tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+
+        print_result(out, "heap", n, run_heap(n, expires, order), 0);
+        print_result(out, "wheel", n, run_wheel(n, expires, order), s == count - 1);
+
+        free(expires);
+        free(order);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * DLHEAP - Fila de prazos em heap binário
+ *
+ * Estrutura usada pelas classes de tempo real do kernel (políticas edf e
+ * rm). Cada nó tem uma chave (prazo absoluto no EDF, período no RM); a raiz
+ * do heap é o nó de menor chave e, entre chaves iguais, o inserido primeiro.
+ *
+ * Custos:
+ *   - Consulta do mínimo O(1)
+ *   - Inserção e remoção (de qualquer nó) O(log n): cada nó guarda a sua
+ *     posição no heap, atualizada a cada troca
+ *
+ * O vetor de ponteiros é fornecido por quem inicializa o heap, com espaço
+ * para 'cap' nós. Todas as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef DLHEAP_H
+#define DLHEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * DlNode - Nó intrusivo da fila de prazos
+ *
+ * Campos:
+ *   key   - Chave de ordenação (menor sai primeiro)
+ *   seq   - Ordem de inserção, para desempate FIFO
+ *   index - Posição no heap (-1: fora da fila)
+ */
+typedef struct {
+    long long key;
+    uint64_t seq;
+    long index;
+} DlNode;
+
+/*
+ * DlHeap - Heap binário de ponteiros para DlNode
+ */
+typedef struct {
+    DlNode **nodes;
+    long size;
+    long cap;
+    uint64_t seq;
+} DlHeap;
+
+/*******************************************************************************
+ * dl_init - Inicializa um heap vazio sobre o vetor 'nodes' (cap posições)
+ ******************************************************************************/
+static inline void dl_init(DlHeap *h, DlNode **nodes, long cap) {
+    h->nodes = nodes;
+    h->size = 0;
+    h->cap = cap;
+    h->seq = 0;
+}
+
+/*******************************************************************************
+ * dl_node_init - Prepara um nó fora da fila
+ ******************************************************************************/
+static inline void dl_node_init(DlNode *n) {
+    n->key = 0;
+    n->seq = 0;
+    n->index = -1;
+}
+
+static inline int dl_less(const DlNode *a, const DlNode *b) {
+    return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+static inline void dl_swap(DlHeap *h, long a, long b) {
+    DlNode *t = h->nodes[a];
+    h->nodes[a] = h->nodes[b];
+    h->nodes[b] = t;
+    h->nodes[a]->index = a;
+    h->nodes[b]->index = b;
+}
+
+static inline void dl_up(DlHeap *h, long i) {
+    while (i > 0 && dl_less(h->nodes[i], h->nodes[(i - 1) / 2])) {
+        dl_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static inline void dl_down(DlHeap *h, long i) {
+    for (;;) {
+        long least = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < h->size && dl_less(h->nodes[l], h->nodes[least]))
+            least = l;
+        if (r < h->size && dl_less(h->nodes[r], h->nodes[least]))
+            least = r;
+        if (least == i)
+            return;
+        dl_swap(h, i, least);
+        i = least;
+    }
+}
+
+/*******************************************************************************
+ * dl_insert - Insere o nó com a chave 'key' (sem efeito se o heap está cheio)
+ ******************************************************************************/
+static inline void dl_insert(DlHeap *h, DlNode *n, long long key) {
+    if (n->index >= 0 || h->size == h->cap)
+        return;
+    n->key = key;
+    n->seq = h->seq++;
+    n->index = h->size;
+    h->nodes[h->size++] = n;
+    dl_up(h, n->index);
+}
+
+/*******************************************************************************
+ * dl_remove - Retira o nó do heap (sem efeito se fora)
+ ******************************************************************************/
+static inline void dl_remove(DlHeap *h, DlNode *n) {
+    long i = n->index;
+    if (i < 0)
+        return;
+
+    h->size--;
+    if (i != h->size) {
+        h->nodes[i] = h->nodes[h->size];
+        h->nodes[i]->index = i;
+        dl_up(h, i);
+        dl_down(h, h->nodes[i]->index);
+    }
+    n->index = -1;
+}
+
+/*******************************************************************************
+ * dl_peek - Nó de menor chave (NULL se vazio)
+ ******************************************************************************/
+static inline DlNode *dl_peek(const DlHeap *h) {
+    return h->size > 0 ? h->nodes[0] : NULL;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * FENWICK - Árvore de Fenwick para sorteios ponderados
+ *
+ * Estrutura usada pela política lottery do kernel. Guarda um peso por
+ * posição (os bilhetes de cada processo pronto) e responde, em O(log n):
+ *
+ *   - Atualização do peso de uma posição
+ *   - Busca da posição sorteada: dado r em [0, total), a menor posição cuja
+ *     soma acumulada de pesos passa de r
+ *
+ * Assim o sorteio de uma loteria não precisa percorrer os participantes.
+ * Posições de 0 a n-1; o vetor da árvore, com n+1 posições, é fornecido por
+ * quem inicializa. Todas as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef FENWICK_H
+#define FENWICK_H
+
+/*
+ * Fenwick - Árvore de somas de prefixos
+ *
+ * Campos:
+ *   tree  - Somas parciais (índices 1..n)
+ *   n     - Número de posições
+ *   total - Soma de todos os pesos
+ */
+typedef struct {
+    long *tree;
+    int n;
+    long total;
+} Fenwick;
+
+/*******************************************************************************
+ * fw_init - Inicializa a árvore com todos os pesos zerados
+ ******************************************************************************/
+static inline void fw_init(Fenwick *f, long *tree, int n) {
+    f->tree = tree;
+    f->n = n;
+    f->total = 0;
+    for (int i = 0; i <= n; i++)
+        tree[i] = 0;
+}
+
+/*******************************************************************************
+ * fw_add - Soma 'delta' ao peso da posição i
+ ******************************************************************************/
+static inline void fw_add(Fenwick *f, int i, long delta) {
+    f->total += delta;
+    for (i++; i <= f->n; i += i & -i)
+        f->tree[i] += delta;
+}
+
+/*******************************************************************************
+ * fw_find - Posição sorteada para r em [0, total)
+ *
+ * Desce a árvore do maior bit para o menor, acumulando as somas enquanto
+ * elas não passam de r.
+ ******************************************************************************/
+static inline int fw_find(const Fenwick *f, long r) {
+    int pos = 0, step = 1;
+    while (step * 2 <= f->n)
+        step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= f->n && f->tree[pos + step] <= r) {
+            pos += step;
+            r -= f->tree[pos];
+        }
+    }
+    return pos;
+}
+
+#endif
@@ -1,27 +1,96 @@
 /*******************************************************************************
- * KERNEL - Simulador de Sistema Operacional com Escalonamento Round-Robin
+ * KERNEL - Simulador de Sistema Operacional com Políticas de Escalonamento
  *
  * Este módulo implementa o núcleo de um sistema operacional simplificado que
  * gerencia múltiplos processos de aplicação, tratando interrupções, syscalls
  * e operações de entrada/saída de forma coordenada.
  *
  * Funcionalidades principais:
- *   - Escalonamento de processos (Round-Robin)
- *   - Gerenciamento de estados de processos (READY, RUNNING, BLOCKED)
+ *   - Escalonamento de processos por uma tabela de políticas (SchedPolicy)
+ *     escolhida com -p: rr (Round-Robin, padrão), arr, prio, edf, rm,
+ *     lottery e stride
+ *   - Gerenciamento de estados de processos (READY, RUNNING, BLOCKED, SLEEPING)
  *   - Tratamento de interrupções (IRQ0, IRQ1, IRQ2)
  *   - Controle de operações de I/O com fila de bloqueados
- *   - Comunicação inter-processos via pipes
+ *   - Comunicação com os apps via blocos de contexto em memória compartilhada
+ *   - Despacho de processos via futex no bloco de contexto
+ *   - Syscall SLEEP com temporizadores em uma roda hierárquica
+ *   - Modo tickless: o clock só gera IRQ0 quando o kernel precisa dela
+ *   - Tarefa idle com contabilidade do tempo ocioso e despacho imediato
+ *   - Quantum adaptativo por despacho (política arr)
+ *   - Prioridades estáticas (nice) em filas O(1) com mapa de bits (política prio)
+ *   - Especificação dos apps por arquivo de jobs (-J)
+ *   - Classes de tempo real periódicas EDF e rate-monotonic (políticas edf
+ *     e rm), com controle de admissão e medição de prazos perdidos
+ *   - Escalonamento proporcional por bilhetes: loteria (árvore de Fenwick) e
+ *     stride (heap de passes), com transferência de bilhetes no I/O
+ *   - Interrupções divididas em top half (registro em um anel sem travas) e
+ *     bottom half (tratamento em lote, com um único escalonamento por lote)
+ *   - Memória virtual paginada: tabela de páginas radix por app, TLB
+ *     simulada nos apps e faltas de página atendidas por um dispositivo de
+ *     swap no InterControllerSim (IRQ3)
+ *   - Cache de blocos do disco (2Q) com escrita adiada em lotes e FSYNC
+ *     e leitura antecipada das sequências de READs
  ******************************************************************************/
 
+ #define _GNU_SOURCE
  #include <stdio.h>
  #include <stdlib.h>
  #include <unistd.h>
  #include <sys/wait.h>
  #include <signal.h>
  #include <string.h>
+ #include <time.h>
+ #include <getopt.h>
+ #include <limits.h>
+ #include <libgen.h>
+ #include <sys/mman.h>
+ #include <sys/syscall.h>
+ #include <poll.h>
+ #include "shared.h"
+ #include "kstat.h"
+ #include "timerwheel.h"
+ #include "prioarray.h"
+ #include "dlheap.h"
+ #include "fenwick.h"
+ #include "pidhash.h"
+ #include "pagetable.h"
+ #include "pagerepl.h"
+ #include "bcache.h"
  
  #define MAX_PROCESSES 6
  #define IO_DURATION_SECONDS 3
+ #define TIME_SLICE_MS 1000
+ #define INSTRUCTION_MS 2000
+ #define PREEMPT_GRACE_MS 200
+ #define SLEEP_MS 3000
+ #define ADAPT_LATENCY_SLICES 2   // Latência alvo (em quanta base) dividida entre os executáveis
+ #define ADAPT_MAX_STREAK 4       // Fatias cheias seguidas que ainda aumentam o quantum
+ #define RESPONSE_MAX_SAMPLES 65536
+ #define NICE_MIN (-20)
+ #define NICE_MAX 19
+ #define PRIO_NICE_0 120          // Prioridade estática de nice 0 (100..139 = nice -20..19)
+ #define RT_HIST_BUCKETS 13       // Atraso: em dia, até 1, 2, 4, ..., 1024 ms e acima
+ #define RT_EDF 1
+ #define RT_RM  2
+ #define DEFAULT_TICKETS 100
+ #define MAX_TICKETS 1000000
+ #define STRIDE1 (1LL << 30)      // Passo de um processo com um único bilhete (>> MAX_TICKETS)
+ #define LOTTERY_SEED 0x9e3779b97f4a7c15ULL
+ #define SHARE_SAMPLE_MS 250      // Intervalo das amostras de fração da CPU
+ #define SHARE_MAX_SAMPLES 256
+ #define VM_FRAMES 64             // Quadros de memória física (-F)
+ #define VM_REFS 1000             // Referências à memória por instrução (-M)
+ #define SWAP_MS 20               // Duração de uma leitura do swap (-w)
+ #define VM_MAX_PAGES ((PT_MAX_LEAVES - 2) * PT_LEAF_SIZE)  // Código e pilha usam uma folha cada
+ #define WS_WINDOW_SLICES 4       // Janela do conjunto de trabalho (wsclock), em quanta
+ #define WB_BATCH_MAX 16          // Blocos de um lote de escrita (uma operação do disco)
+ #define WB_BACKGROUND_PCT 50     // Buffers sujos (% do cache) que disparam um lote já
+ #define WB_PROC_DIRTY_PCT 25     // Buffers sujos (% do cache) de um processo antes de frear
+ #define IO_FLUSH (-2)            // io_current durante um lote de escrita do kernel
+ #define IO_PREFETCH (-3)         // io_current durante uma leitura antecipada
+ #define RA_MIN_WINDOW 2          // Janela inicial da leitura antecipada, em blocos
+ #define RA_MAX_WINDOW 64         // Maior janela aceita em -A
  
  /*******************************************************************************
   * ESTRUTURAS DE DADOS - Fila de Processos Bloqueados
@@ -32,8 +101,12 @@
   ******************************************************************************/
  int blocked_queue[MAX_PROCESSES];
  int blocked_front = 0;
- int blocked_rear = 0;
+ int blocked_count = 0;   // Contagem explícita: com o disco ocupado por um lote
+                          // de escrita ou leitura antecipada, todos os
+                          // MAX_PROCESSES apps podem estar na fila
  int io_in_progress = 0;
+ int io_current = -1;   // Processo cujo I/O está em atendimento (IO_FLUSH: lote de
+                        // escrita, IO_PREFETCH: leitura antecipada)
  
  /*******************************************************************************
   * enqueue_blocked - Adiciona um processo à fila de bloqueados
@@ -45,12 +118,12 @@
   *   pid_index - Índice do processo na tabela PCB que será enfileirado
   *
   * Comportamento:
-  *   - Adiciona o processo no final da fila (posição rear)
-  *   - Incrementa o ponteiro rear de forma circular
+  *   - Adiciona o processo no final da fila (posição front + count)
+  *   - Incrementa a contagem de processos na fila
   ******************************************************************************/
  void enqueue_blocked(int pid_index) {
-     blocked_queue[blocked_rear] = pid_index;
-     blocked_rear = (blocked_rear + 1) % MAX_PROCESSES;
+     blocked_queue[(blocked_front + blocked_count) % MAX_PROCESSES] = pid_index;
+     blocked_count++;
  }
  
  /*******************************************************************************
@@ -65,13 +138,14 @@
   *
   * Comportamento:
   *   - Verifica se a fila está vazia antes de remover
-  *   - Incrementa o ponteiro front de forma circular
+  *   - Incrementa o ponteiro front de forma circular e decrementa a contagem
   ******************************************************************************/
  int dequeue_blocked() {
-     if (blocked_front == blocked_rear)
+     if (blocked_count == 0)
          return -1;
      int pid_index = blocked_queue[blocked_front];
      blocked_front = (blocked_front + 1) % MAX_PROCESSES;
+     blocked_count--;
      return pid_index;
  }
  
@@ -83,74 +157,3958 @@
   *   - 0 (false) se houver processos na fila
   ******************************************************************************/
  int blocked_is_empty() {
-     return blocked_front == blocked_rear;
+     return blocked_count == 0;
  }
  
+ /*******************************************************************************
+  * blocked_head - Processo na frente da fila de bloqueados, sem retirá-lo (-1)
+  ******************************************************************************/
+ int blocked_head() {
+     return blocked_is_empty() ? -1 : blocked_queue[blocked_front];
+ }
+ 
+ /*******************************************************************************
+  * ESTRUTURAS DE DADOS - Fila do Dispositivo de Swap
+  *
+  * Processos bloqueados em uma falta de página, na ordem das faltas. O
+  * dispositivo de swap atende uma leitura de página por vez, independente do
+  * disco D1: um processo esperando o swap não entra na fila de bloqueados do
+  * disco, e vice-versa.
+  ******************************************************************************/
+ int swap_queue[MAX_PROCESSES];
+ int swap_front = 0;
+ int swap_count = 0;
+ int swap_in_progress = 0;
+ int swap_current = -1;  // Processo cuja página está sendo lida
+ 
+ /*******************************************************************************
+  * enqueue_swap - Adiciona um processo ao final da fila do swap
+  ******************************************************************************/
+ void enqueue_swap(int pid_index) {
+     swap_queue[(swap_front + swap_count) % MAX_PROCESSES] = pid_index;
+     swap_count++;
+ }
+ 
+ /*******************************************************************************
+  * dequeue_swap - Remove o processo da frente da fila do swap (-1 se vazia)
+  ******************************************************************************/
+ int dequeue_swap() {
+     if (swap_count == 0)
+         return -1;
+     int pid_index = swap_queue[swap_front];
+     swap_front = (swap_front + 1) % MAX_PROCESSES;
+     swap_count--;
+     return pid_index;
+ }
+ 
+ /*******************************************************************************
+  * ESTRUTURAS DE DADOS - Fila de Processos Prontos
+  *
+  * Fila circular FIFO com os processos no estado READY, na ordem em que
+  * ficaram prontos. O escalonador retira o próximo processo da frente da
+  * fila, sem percorrer a tabela de processos: processos bloqueados ou
+  * dormindo nunca são examinados. Um processo entra na fila ao passar para
+  * READY (set_state), de modo que nunca aparece nela mais de uma vez.
+  ******************************************************************************/
+ int ready_queue[MAX_PROCESSES];
+ int ready_front = 0;
+ int ready_count = 0;
+ 
+ /*******************************************************************************
+  * enqueue_ready - Adiciona um processo ao final da fila de prontos
+  ******************************************************************************/
+ void enqueue_ready(int pid_index) {
+     ready_queue[(ready_front + ready_count) % MAX_PROCESSES] = pid_index;
+     ready_count++;
+ }
+ 
+ /*******************************************************************************
+  * dequeue_ready - Remove o processo da frente da fila de prontos
+  *
+  * Retorna:
+  *   - Índice do processo removido da fila
+  *   - -1 se a fila estiver vazia
+  ******************************************************************************/
+ int dequeue_ready() {
+     if (ready_count == 0)
+         return -1;
+     int pid_index = ready_queue[ready_front];
+     ready_front = (ready_front + 1) % MAX_PROCESSES;
+     ready_count--;
+     return pid_index;
+ }
+  
  /*******************************************************************************
   * TIPOS E ESTRUTURAS DE DADOS
   ******************************************************************************/
  
- /* Estados possíveis de um processo no sistema */
- typedef enum { READY, RUNNING, BLOCKED } ProcessState;
+ /* Estados possíveis de um processo no sistema */
+ typedef enum { READY, RUNNING, BLOCKED, SLEEPING, TERMINATED, NUM_STATES } ProcessState;
+ 
+ /*
+  * PCB - Process Control Block (Bloco de Controle de Processo)
+  *
+  * Estrutura fundamental que mantém todas as informações sobre um processo
+  * que o kernel precisa para gerenciá-lo adequadamente.
+  *
+  * Campos:
+  *   pid            - ID do processo no sistema operacional
+  *   state          - Estado atual do processo (READY, RUNNING, BLOCKED, SLEEPING
+  *                    ou TERMINATED)
+  *   io_pending     - Flag indicando se há uma operação de I/O em andamento
+  *   io_timer       - Timer para controlar a duração de operações de I/O
+  *   saved_pc       - Program Counter salvo durante uma syscall
+  *   saved_regs     - Registradores salvos durante uma syscall
+  *   syscall_param  - Parâmetro da syscall (tipo de operação solicitada)
+  *   saved_pc_valid - Flag que indica se há um PC válido para restaurar
+  *   ctx            - Bloco de contexto do processo na memória compartilhada
+  *   preempt_ns     - Instante em que a preempção foi pedida ao processo
+  *   signal_stopped - Flag indicando que o processo foi parado via SIGSTOP
+  *   terminated     - Flag indicando que o processo já terminou (syscall EXIT
+  *                    ou coleta pelo pidfd)
+  *   exit_ns        - Instante do término (desde o início do kernel)
+  *   io_request     - Número do último pedido de I/O do processo (trace)
+  *   state_since_ns - Instante da última mudança de estado
+  *   state_ns       - Tempo acumulado em cada estado até state_since_ns
+  *   dispatches     - Número de despachos do processo
+  *   sleep_timer    - Temporizador do SLEEP em andamento
+  *   slice_ms       - Quantum concedido no último despacho
+  *   dispatch_ns    - Instante do último despacho
+  *   full_slices    - Fatias seguidas usadas até o fim (zerado ao fazer syscall)
+  *   slice_expired  - 1 se o processo esgotou a fatia do despacho atual
+  *   nice           - Valor nice do app (-20..19)
+  *   prio_node      - Nó na fila de prioridades (política prio); prio_node.prio
+  *                    é a prioridade estática (PRIO_NICE_0 + nice)
+  *   rt             - 1 se o app foi admitido na classe de tempo real
+  *   rt_node        - Nó na fila de prazos (políticas edf e rm)
+  *   rt_timer       - Temporizador da próxima ativação
+  *   rt_release_ms  - Instante da ativação atual, em ms de tempo de evento
+  *   rt_deadline_ms - Prazo absoluto da ativação atual
+  *   rt_cpu_start_ns- Tempo em RUNNING acumulado no início da ativação atual
+  *   rt_jobs        - Ativações concluídas
+  *   rt_misses      - Ativações concluídas depois do prazo
+  *   rt_max_late_ns - Maior atraso observado (negativo: sempre em dia)
+  *   tickets        - Bilhetes próprios do app (políticas lottery e stride)
+  *   eff_tickets    - Bilhetes efetivos: os próprios mais os recebidos de
+  *                    apps do mesmo tenant bloqueados em I/O
+  *   lent_to        - App que recebeu os bilhetes deste durante o I/O (-1)
+  *   lot_weight     - Peso atual do processo na árvore da loteria
+  *   stride_node    - Nó no heap de passes (política stride); a chave é o passe
+  *   stride_pass    - Passe do processo
+  *   stride_cpu_ns  - Tempo em RUNNING já cobrado no passe
+  *   syscall_seq    - Número da última syscall recebida do app (SIG_SYSCALL)
+  *   exit_syscall   - 1 se o término foi avisado pela syscall EXIT
+  *   exit_code      - Código de saída informado na syscall EXIT
+  *   exit_instr     - Instruções executadas, informadas na syscall EXIT
+  *   exit_ctrs      - Contadores finais do app (posições EXIT_CTR_*)
+  *   fault_vpn      - Página virtual da falta em atendimento
+  *   fault_frame    - Quadro reservado para a página da falta (-1: nenhum)
+  *   fault_ns       - Instante da falta em atendimento
+  *   swap_request   - Número do último pedido de swap do processo
+  *   page_faults    - Faltas de página que exigiram leitura do swap
+  *   resident       - Páginas do processo presentes na memória física
+  *   io_block       - Bloco do disco da syscall READ/WRITE em andamento
+  *   io_start_ns    - Instante da syscall READ/WRITE em andamento
+  *   io_buf         - Buffer do cache reservado para a leitura do processo
+  *                    no disco (-1: nenhum)
+  *   cache_wait     - Buffer do cache cuja leitura, pedida por outro
+  *                    processo, o processo aguarda (-1: nenhum)
+  *   dirty          - Buffers do cache escritos pelo processo e ainda não
+  *                    gravados no disco (escrita adiada)
+  *   wb_wait        - Espera por lotes de escrita: 'W' (WRITE freada por
+  *                    excesso de buffers sujos), 'Y' (FSYNC) ou 0
+  *   ra_next        - Bloco que continua a sequência de READs do processo
+  *   ra_window      - Janela atual da leitura antecipada (0: sem sequência)
+  *   ra_end         - Primeiro bloco da sequência ainda não pedido
+  *   ra_pend_start  - Primeiro bloco da janela pendente da leitura antecipada
+  *   ra_pend_count  - Blocos da janela pendente (0: nenhuma)
+  *   ra_pend_seq    - Número do pedido da janela pendente assíncrona (0: vai
+  *                    junto com a próxima leitura do processo)
+  */
+ typedef struct {
+     pid_t pid;
+     ProcessState state;
+     int io_pending;
+     int io_timer;
+     int saved_pc;
+     int saved_regs[NUM_REGS];
+     char syscall_param;
+     int saved_pc_valid;
+     ContextBlock *ctx;
+     long long preempt_ns;
+     int signal_stopped;
+     int terminated;
+     long long exit_ns;
+     long io_request;
+     long long state_since_ns;
+     long long state_ns[NUM_STATES];
+     long dispatches;
+     Timer sleep_timer;
+     int slice_ms;
+     long long dispatch_ns;
+     int full_slices;
+     int slice_expired;
+     int nice;
+     PrioNode prio_node;
+     int rt;
+     DlNode rt_node;
+     Timer rt_timer;
+     long long rt_release_ms;
+     long long rt_deadline_ms;
+     long long rt_cpu_start_ns;
+     long rt_jobs;
+     long rt_misses;
+     long long rt_max_late_ns;
+     int tickets;
+     int eff_tickets;
+     int lent_to;
+     long lot_weight;
+     DlNode stride_node;
+     long long stride_pass;
+     long long stride_cpu_ns;
+     uint32_t syscall_seq;
+     int exit_syscall;
+     int exit_code;
+     int exit_instr;
+     int exit_ctrs[NUM_REGS];
+     uint32_t fault_vpn;
+     int fault_frame;
+     long long fault_ns;
+     long swap_request;
+     long page_faults;
+     int resident;
+     uint32_t io_block;
+     long long io_start_ns;
+     int io_buf;
+     int cache_wait;
+     int dirty;
+     char wb_wait;
+     uint32_t ra_next;
+     int ra_window;
+     uint32_t ra_end;
+     uint32_t ra_pend_start;
+     int ra_pend_count;
+     long ra_pend_seq;
+ } PCB;
+ 
+ /*
+  * JobSpec - Descrição de um app, vinda de -m/-n ou do arquivo de jobs (-J)
+  *
+  * Campos:
+  *   load - Carga do app: 'c' (só CPU), 'i' (com I/O), 's' (com SLEEP),
+  *          'w' (escritas seguidas de FSYNC) ou 'q' (leitura sequencial)
+  *   nice        - Valor nice (-20..19), usado pela política prio
+  *   period_ms   - Período das ativações (0: app sem requisitos de tempo real)
+  *   runtime_ms  - Tempo de CPU de cada ativação
+  *   deadline_ms - Prazo relativo de cada ativação (runtime <= prazo <= período)
+  *   admitted    - 1 se o controle de admissão aceitou o app
+  *   tickets     - Bilhetes (políticas lottery e stride)
+  *   tenant      - Grupo do app (-1: nenhum); um app bloqueado em I/O
+  *                 transfere os seus bilhetes a outro executável do grupo
+  */
+ typedef struct {
+     char load;
+     int nice;
+     int period_ms;
+     int runtime_ms;
+     int deadline_ms;
+     int admitted;
+     int tickets;
+     int tenant;
+ } JobSpec;
+ 
+ /*
+  * SchedPolicy - Operações de uma política de escalonamento
+  *
+  * Campos:
+  *   name         - Nome usado em -p
+  *   enqueue      - O processo passou para READY
+  *   pick         - Retira e retorna o processo que deve assumir a CPU, ou -1
+  *                  se o processo atual ('current', -1 se nenhum) deve continuar
+  *                  ou se não há ninguém pronto
+  *   empty        - 1 se não há processo READY
+  *   remove       - O processo terminou e não deve mais ser escolhido
+  *   quantum      - Quantum do despacho do processo, em ms
+  *   preempts     - 1 se algum processo READY deve tomar a CPU do atual antes
+  *                  do fim da fatia (NULL: só na IRQ0)
+  *   block        - O processo bloqueou em I/O (NULL: nada a fazer)
+  *   per_dispatch - 1 se o quantum varia a cada despacho (o time slice do
+  *                  controlador recomeça em cada despacho)
+  *   rt           - Classe de tempo real: RT_EDF, RT_RM ou 0 (nenhuma)
+  */
+ typedef struct {
+     const char *name;
+     void (*enqueue)(int i);
+     int (*pick)(int current);
+     int (*empty)();
+     void (*remove)(int i);
+     int (*quantum)(int i);
+     int (*preempts)(int current);
+     void (*block)(int i);
+     int per_dispatch;
+     int rt;
+ } SchedPolicy;
+ 
+ /*
+  * KernelConfig - Parâmetros da simulação definidos pela linha de comando
+  *
+  * Campos:
+  *   quantum_ms   - Time slice repassado ao InterControllerSim (-q)
+  *   io_ms        - Duração de cada operação de I/O (-d)
+  *   instr_ms     - Duração de cada instrução dos apps (-i)
+  *   sleep_ms     - Duração de cada SLEEP dos apps (-s)
+  *   io_mix       - Carga de cada app: 'c' (só CPU), 'i' (com I/O), 's'
+  *                  (com SLEEP), 'w' (escritas) ou 'q' (leitura sequencial),
+  *                  repetida ciclicamente se for menor que num_apps (-m)
+  *   policy       - Política de escalonamento (-p): "rr" (quantum fixo),
+  *                  "arr" (quantum adaptativo), "prio" (prioridades), "edf"
+  *                  ou "rm" (tempo real), "lottery" ou "stride" (bilhetes)
+  *   nice         - Lista de valores nice separados por vírgula, repetida
+  *                  ciclicamente (-n)
+  *   jobs_path    - Arquivo de jobs com a descrição de cada app (-J)
+  *   metrics_path - Arquivo onde as métricas são gravadas ao final (-o)
+  *   trace_path   - Arquivo da linha do tempo em trace-events (-t)
+  *   tickless     - 1 para o modo tickless (-T)
+  *   vm_pages     - Páginas de dados de cada app (-V); 0 desativa a memória
+  *                  virtual
+  *   vm_frames    - Quadros de memória física, compartilhados pelos apps (-F)
+  *   vm_refs      - Referências à memória por instrução (-M)
+  *   swap_ms      - Duração de cada leitura do dispositivo de swap (-w)
+  *   page_policy  - Política de substituição de páginas (-P): "fifo", "lru",
+  *                  "second", "clock", "aging" ou "wsclock" (pagerepl.h)
+  *   cache_blocks - Buffers do cache de blocos do disco (-C); 0 desativa
+  *   wb_expire_ms - Escrita adiada (-B): tempo máximo de um bloco sujo no
+  *                  cache antes do lote de escrita; 0 grava cada WRITE no
+  *                  disco na hora (exige -C)
+  *   ra_max       - Maior janela da leitura antecipada, em blocos (-A); 0
+  *                  desativa (exige -C)
+  */
+ typedef struct {
+     int quantum_ms;
+     int io_ms;
+     int instr_ms;
+     int sleep_ms;
+     const char *io_mix;
+     const char *policy;
+     const char *metrics_path;
+     const char *trace_path;
+     int tickless;
+     const char *nice;
+     const char *jobs_path;
+     int vm_pages;
+     int vm_frames;
+     int vm_refs;
+     int swap_ms;
+     const char *page_policy;
+     int cache_blocks;
+     int wb_expire_ms;
+     int ra_max;
+ } KernelConfig;
+ 
+ /*
+  * KernelStats - Contadores globais da simulação
+  */
+ typedef struct {
+     long ticks;
+     long dispatches;
+     long preemptions;
+     long syscalls;
+     long io_completed;
+     long sleeps;
+     long wakeups;
+     long clock_programs;
+     long long idle_ns;
+     long idle_periods;
+     long fast_dispatches;
+     long long quantum_sum_ms;
+     long exit_syscalls;
+     long long exit_gap_sum_ns;
+     long long exit_gap_max_ns;
+     long page_faults;
+     long minor_faults;
+     long evictions;
+     long dirty_evictions;
+     long swap_completed;
+     long long swap_wait_sum_ns;
+     long ref_harvests;
+     long ref_bits_cleared;
+     long long repl_select_ns;
+     long reads;
+     long long read_blocked_ns;
+     long device_reads;
+     long long device_read_ns;
+     long cache_hits;
+     long cache_joins;
+     long cache_misses;
+     long cache_bypass;
+     long long cache_join_ns;
+     long writes;
+     long long write_ns;
+     long device_writes;
+     long writes_buffered;
+     long writes_absorbed;
+     long writes_bypass;
+     long writes_throttled;
+     long long wb_throttle_ns;
+     long wb_flushes;
+     long wb_blocks_flushed;
+     long fsyncs;
+     long fsync_waits;
+     long long fsync_ns;
+     long ra_streams;
+     long ra_requests;
+     long ra_blocks;
+     long ra_hits;
+     long ra_late;
+     long ra_wasted;
+     long ra_cancels;
+     long ra_cancelled_blocks;
+     long ra_merged;
+ } KernelStats;
+ 
+ /*******************************************************************************
+  * VARIÁVEIS GLOBAIS DO KERNEL
+  ******************************************************************************/
+ int num_apps = 0;
+ PCB *pcb_table = NULL;
+ PidHash pid_index;     // PID → índice em pcb_table
+ pid_t controller_pid;
+ int current_running = -1;
+ int finished_processes = 0;
+ ContextBlock *context_area = NULL;
+ int context_fd = -1;
+ KstatSegment *kstat = NULL;
+ KernelConfig config = { TIME_SLICE_MS, IO_DURATION_SECONDS * 1000, INSTRUCTION_MS,
+                         SLEEP_MS, "c", "rr", NULL, NULL, 0, "0", NULL,
+                         0, VM_FRAMES, VM_REFS, SWAP_MS, "fifo", 0, 0, 0 };
+ KernelStats stats;
+ TimerWheel kernel_timers;   // Temporizadores do kernel, em ms de tempo de evento
+ long long idle_since_ns = -1;   // Início do período ocioso atual (-1 se ocupada)
+ SchedPolicy *policy = NULL;     // Política escolhida por -p
+ PrioRunqueue prio_rq;           // Filas da política prio
+ DlHeap rt_heap;                 // Fila de prazos das políticas edf e rm
+ PrEngine page_repl;             // Substituição de páginas (-P)
+ BCache bcache;                  // Cache de blocos do disco (-C)
+ int wb_proc_limit = 0;          // Buffers sujos de um processo antes do freio (-B)
+ uint8_t *ra_unused = NULL;      // 1 se o buffer veio da leitura antecipada e não foi lido (-A)
+ DlNode *rt_heap_nodes[MAX_PROCESSES];
+ long rt_lateness_hist[RT_HIST_BUCKETS];
+ int rt_admitted = 0, rt_rejected = 0;
+ double rt_utilization = 0.0;    // Utilização (densidade) dos apps admitidos
+ double rt_bound = 0.0;          // Limite usado na admissão
+ Fenwick lottery_tree;           // Bilhetes dos prontos (política lottery)
+ long lottery_tree_buf[MAX_PROCESSES + 1];
+ uint64_t lottery_rng = LOTTERY_SEED;
+ DlHeap stride_heap;             // Passes dos prontos (política stride)
+ DlNode *stride_heap_nodes[MAX_PROCESSES];
+ long long stride_global_pass = 0;
+ long lottery_draws = 0, ticket_transfers = 0;
+ long long share_next_ms = SHARE_SAMPLE_MS;
+ long share_count = 0;
+ long long share_at_ms[SHARE_MAX_SAMPLES];
+ double share_err[SHARE_MAX_SAMPLES];
+ double share_achieved[MAX_PROCESSES];
+ JobSpec jobs[MAX_PROCESSES];
+ int num_jobs = 0;               // Apps descritos no arquivo de jobs (0 sem -J)
+ 
+ /*******************************************************************************
+  * PROTÓTIPOS DE FUNÇÕES
+  ******************************************************************************/
+ void schedule();
+ void kstat_publish();
+ void clock_program();
+ void idle_fast_path();
+ long long idle_ns_total();
+ int cpu_is_idle();
+ long io_current_request();
+ void disk_start_next();
+ void ra_observe(int proc, uint32_t block, int async);
+ 
+ /*******************************************************************************
+  * DESPACHO VIA FUTEX
+  *
+  * Em vez de SIGSTOP/SIGCONT, cada app espera na sua palavra 'run_gate' do
+  * bloco de contexto. O kernel despacha trocando a palavra e acordando o app,
+  * e pede a preempção pela flag 'preempt', que o app verifica a cada fronteira
+  * de instrução. O SIGSTOP só é usado como último recurso, quando o app não
+  * estaciona dentro de PREEMPT_GRACE_MS.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * now_ns - Retorna o tempo monotônico atual em nanossegundos
+  ******************************************************************************/
+ long long now_ns() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+ }
+ 
+ /*******************************************************************************
+  * resume_app - Libera o processo para executar
+  *
+  * Limpa o pedido de preempção, publica o contexto salvo (se houver),
+  * incrementa a geração, abre o run_gate e acorda o app. Se o processo tinha
+  * sido parado pelo fallback de SIGSTOP, também envia SIGCONT.
+  *
+  * Parâmetros:
+  *   i - Índice do processo na tabela PCB
+  ******************************************************************************/
+ void resume_app(int i) {
+     PCB *p = &pcb_table[i];
+     ContextBlock *ctx = p->ctx;
+ 
+     ctx->preempt = 0;
+     if (p->saved_pc_valid) {
+         ctx->pc = p->saved_pc;
+         for (int r = 0; r < NUM_REGS; r++)
+             ctx->regs[r] = p->saved_regs[r];
+         ctx->restore = 1;
+         p->saved_pc_valid = 0;
+     }
+     __atomic_add_fetch(&ctx->generation, 1, __ATOMIC_RELEASE);
+     __atomic_store_n(&ctx->run_gate, GATE_RUN, __ATOMIC_RELEASE);
+     futex_wake(&ctx->run_gate);
+ 
+     if (pcb_table[i].signal_stopped) {
+         kill(pcb_table[i].pid, SIGCONT);
+         pcb_table[i].signal_stopped = 0;
+     }
+ }
+ 
+ /*******************************************************************************
+  * stop_app - Pede que o processo deixe a CPU
+  *
+  * Levanta a flag de preempção, incrementa a geração (para que o app a veja
+  * na próxima instrução), fecha o run_gate e acorda o app caso ele esteja no
+  * meio da espera de uma instrução, para que estacione logo.
+  *
+  * Parâmetros:
+  *   i - Índice do processo na tabela PCB
+  ******************************************************************************/
+ void stop_app(int i) {
+     ContextBlock *ctx = pcb_table[i].ctx;
+ 
+     ctx->preempt = 1;
+     __atomic_add_fetch(&ctx->generation, 1, __ATOMIC_RELEASE);
+     __atomic_store_n(&ctx->run_gate, GATE_STOPPED, __ATOMIC_RELEASE);
+     futex_wake(&ctx->run_gate);
+     pcb_table[i].preempt_ns = now_ns();
+ }
+ 
+ /*******************************************************************************
+  * enforce_preemption - Fallback de preempção via SIGSTOP
+  *
+  * Para com SIGSTOP os processos que receberam pedido de preempção há mais de
+  * PREEMPT_GRACE_MS e ainda não estacionaram no run_gate (por exemplo, presos
+  * em uma chamada bloqueante). O SIGCONT correspondente é enviado por
+  * resume_app no próximo despacho.
+  ******************************************************************************/
+ void enforce_preemption() {
+     long long now = now_ns();
+ 
+     for (int i = 0; i < num_apps; i++) {
+         PCB *p = &pcb_table[i];
+         if (p->state == RUNNING || p->terminated || p->signal_stopped ||
+             !p->ctx->preempt || p->ctx->parked)
+             continue;
+         if (now - p->preempt_ns < PREEMPT_GRACE_MS * 1000000LL)
+             continue;
+         printf("KERNEL: A%d (PID %d) nao estacionou, aplicando SIGSTOP\n", i, p->pid);
+         fflush(stdout);
+         kill(p->pid, SIGSTOP);
+         p->signal_stopped = 1;
+     }
+ }
+ 
+ /*******************************************************************************
+  * REGISTRO E REPLAY DE EVENTOS
+  *
+  * Todo evento externo que chega ao kernel (tick, syscall, conclusão de I/O e
+  * término de processo) passa por deliver_event, que lhe atribui um número de
+  * sequência e um instante (relativo ao início do kernel) antes de tratá-lo.
+  *
+  * Com --record <arquivo>, cada evento e cada decisão do escalonador é gravada
+  * em uma linha de texto:
+  *
+  *   # trab1so-log v3 num_apps=<n> pids=<pid0>,<pid1>,...
+  *   # config quantum_ms=<ms> io_ms=<ms> ... policy=<p> page_policy=<p>
+  *   # job load=<c> nice=<n> tickets=<n> [period=... tenant=<t>]   (um por app)
+  *   E <seq> <ts_ns> START
+  *   E <seq> <ts_ns> TICK
+  *   E <seq> <ts_ns> SYSCALL <proc> <valida> <op> <pc> <r0> <r1> <r2> <r3> <arg>
+  *   E <seq> <ts_ns> IODONE
+  *   E <seq> <ts_ns> EXIT <proc>
+  *   E <seq> <ts_ns> SWAPDONE
+  *   V <seq> <quadro>         (quadro escolhido para substituição no evento)
+  *   B <seq>                  (fim do lote de eventos que termina em seq)
+  *   D <seq> <proximo>        (decisão do schedule() disparada pelo lote)
+  *
+  * Com --replay <arquivo>, o kernel não cria apps nem o controlador: os eventos
+  * do log são reaplicados em sequência, sem nenhuma espera, e cada decisão do
+  * schedule() é comparada com a registrada. Qualquer divergência é reportada e
+  * o kernel termina com código 1, o que permite usar o replay diretamente em
+  * um "git bisect run".
+  *
+  * As linhas '# config' e '# job' guardam os parâmetros que influenciam as
+  * decisões (quantum, durações, política, memória virtual, cache) e o job
+  * efetivo de cada app, já resolvido a partir de -m/-n ou -J; o replay os
+  * restaura, de modo que basta '--replay <arquivo>', sem repetir as opções
+  * da gravação. Os arquivos de saída (-o, -t) continuam os da linha de
+  * comando. Logs v1 e v2, sem essas linhas, usam as opções dadas no replay.
+  *
+  * A escolha do quadro a substituir depende dos bits de referência marcados
+  * pelos apps, que não existem no replay: por isso ela é gravada (linha 'V',
+  * logo após o evento da falta) e o replay usa o quadro gravado.
+  *
+  * Os eventos de um lote (ver TOP HALF E BOTTOM HALF) são tratados um de cada
+  * vez, na mesma ordem em que são gravados, e o escalonador roda uma vez ao
+  * fim do lote. Logs v1, anteriores aos lotes, são reexecutados com um lote
+  * por evento.
+  ******************************************************************************/
+ 
+ /* Tipos de eventos externos */
+ typedef enum { EV_START, EV_TICK, EV_SYSCALL, EV_IO_DONE, EV_EXIT, EV_SWAP_DONE } EventType;
+ 
+ static const char *event_names[] = { "START", "TICK", "SYSCALL", "IODONE", "EXIT", "SWAPDONE" };
+ 
+ /*
+  * KernelEvent - Evento externo entregue ao kernel
+  *
+  * Campos:
+  *   seq  - Número de sequência do evento
+  *   ts   - Instante do evento em nanossegundos desde o início do kernel
+  *   type - Tipo do evento
+  *   proc - Índice do processo envolvido (SYSCALL e EXIT)
+  *   sc   - Cópia do slot de syscall (SYSCALL); sc.pending indica se era válido
+  */
+ typedef struct {
+     long seq;
+     long long ts;
+     EventType type;
+     int proc;
+     SyscallContext sc;
+ } KernelEvent;
+ 
+ #define MAX_PENDING_DECISIONS 16
+ 
+ int replay_mode = 0;
+ FILE *record_file = NULL;
+ FILE *replay_file = NULL;
+ long event_seq = 0;
+ long long start_ns = 0;
+ long long event_time_ns = 0;
+ long current_event_seq = 0;
+ 
+ /* Decisões produzidas durante o replay que ainda aguardam comparação */
+ int replay_decisions[MAX_PENDING_DECISIONS];
+ int replay_decisions_count = 0;
+ long replay_events = 0;
+ long replay_checked = 0;
+ long replay_mismatches = 0;
+ int need_resched = 0;           // Algum evento do lote pediu o escalonador
+ 
+ void handle_irq0(KernelEvent *ev);
+ void handle_syscall_from_app(KernelEvent *ev);
+ void handle_io_complete(KernelEvent *ev);
+ void handle_process_finished(KernelEvent *ev);
+ void handle_exit_syscall(KernelEvent *ev);
+ void handle_page_fault(KernelEvent *ev);
+ void handle_swap_complete(KernelEvent *ev);
+ 
+ /*******************************************************************************
+  * record_event - Grava um evento no log de registro (se ativo)
+  ******************************************************************************/
+ void record_event(KernelEvent *ev) {
+     if (!record_file)
+         return;
+ 
+     fprintf(record_file, "E %ld %lld %s", ev->seq, ev->ts, event_names[ev->type]);
+     if (ev->type == EV_SYSCALL) {
+         fprintf(record_file, " %d %d %c %d", ev->proc, ev->sc.pending,
+                 ev->sc.operation ? ev->sc.operation : '-', ev->sc.pc);
+         for (int r = 0; r < NUM_REGS; r++)
+             fprintf(record_file, " %d", ev->sc.regs[r]);
+         fprintf(record_file, " %d", ev->sc.arg);
+     } else if (ev->type == EV_EXIT) {
+         fprintf(record_file, " %d", ev->proc);
+     }
+     fprintf(record_file, "\n");
+ }
+ 
+ /*
+  * Campos inteiros de KernelConfig gravados na linha '# config' do log e
+  * restaurados no replay (a política e a de substituição vão por nome)
+  */
+ static const struct {
+     const char *key;
+     int *value;
+ } config_fields[] = {
+     { "quantum_ms",   &config.quantum_ms },
+     { "io_ms",        &config.io_ms },
+     { "instr_ms",     &config.instr_ms },
+     { "sleep_ms",     &config.sleep_ms },
+     { "tickless",     &config.tickless },
+     { "vm_pages",     &config.vm_pages },
+     { "vm_frames",    &config.vm_frames },
+     { "vm_refs",      &config.vm_refs },
+     { "swap_ms",      &config.swap_ms },
+     { "cache_blocks", &config.cache_blocks },
+     { "wb_expire_ms", &config.wb_expire_ms },
+     { "ra_max",       &config.ra_max },
+ };
+ 
+ /*******************************************************************************
+  * record_header - Grava o cabeçalho do log: PIDs, configuração e jobs
+  ******************************************************************************/
+ void record_header() {
+     fprintf(record_file, "# trab1so-log v3 num_apps=%d pids=", num_apps);
+     for (int i = 0; i < num_apps; i++)
+         fprintf(record_file, "%s%d", i ? "," : "", pcb_table[i].pid);
+     fprintf(record_file, "\n# config");
+     for (size_t k = 0; k < sizeof(config_fields) / sizeof(config_fields[0]); k++)
+         fprintf(record_file, " %s=%d", config_fields[k].key, *config_fields[k].value);
+     fprintf(record_file, " policy=%s page_policy=%s\n", config.policy, config.page_policy);
+ 
+     for (int i = 0; i < num_apps; i++) {
+         JobSpec *job = &jobs[i];
+         fprintf(record_file, "# job load=%c nice=%d tickets=%d", job->load, job->nice, job->tickets);
+         if (job->period_ms > 0)
+             fprintf(record_file, " period=%d runtime=%d deadline=%d",
+                     job->period_ms, job->runtime_ms, job->deadline_ms);
+         if (job->tenant >= 0)
+             fprintf(record_file, " tenant=%d", job->tenant);
+         fprintf(record_file, "\n");
+     }
+ }
+ 
+ /*******************************************************************************
+  * record_decision - Registra a decisão tomada pelo escalonador
+  *
+  * No modo de registro, grava a decisão no log. No modo de replay, guarda a
+  * decisão para ser comparada com a próxima linha 'D' do log.
+  *
+  * Parâmetros:
+  *   next - Índice do processo escolhido (-1 se nenhum)
+  ******************************************************************************/
+ void record_decision(int next) {
+     if (record_file)
+         fprintf(record_file, "D %ld %d\n", current_event_seq, next);
+ 
+     if (replay_mode && replay_decisions_count < MAX_PENDING_DECISIONS)
+         replay_decisions[replay_decisions_count++] = next;
+ }
+ 
+ /*******************************************************************************
+  * record_victim - Grava o quadro escolhido para substituição (se ativo)
+  ******************************************************************************/
+ void record_victim(int f) {
+     if (record_file)
+         fprintf(record_file, "V %ld %d\n", current_event_seq, f);
+ }
+ 
+ /*******************************************************************************
+  * replay_victim - Quadro gravado para a substituição do evento atual
+  *
+  * A linha 'V' segue o evento que a produziu. Em um log sem ela (gravado
+  * antes das políticas de substituição), a posição de leitura é restaurada.
+  *
+  * Retorna:
+  *   Número do quadro, ou -1 se a próxima linha não é uma linha 'V'
+  ******************************************************************************/
+ int replay_victim() {
+     char line[64];
+     long seq;
+     int f;
+     long pos = ftell(replay_file);
+ 
+     if (fgets(line, sizeof(line), replay_file) &&
+         sscanf(line, "V %ld %d", &seq, &f) == 2)
+         return f;
+     fseek(replay_file, pos, SEEK_SET);
+     return -1;
+ }
+ 
+ /*******************************************************************************
+  * deliver_event - Ponto único de entrada dos eventos externos
+  *
+  * Numera, carimba o instante, grava e despacha o evento para o seu handler.
+  * No replay o instante é o registrado no log. Os handlers apenas pedem o
+  * escalonador (need_resched); ele roda em end_batch, ao fim do lote.
+  ******************************************************************************/
+ void deliver_event(KernelEvent *ev) {
+     ev->seq = ++event_seq;
+     if (!replay_mode)
+         ev->ts = now_ns() - start_ns;
+     event_time_ns = ev->ts;
+     current_event_seq = ev->seq;
+ 
+     record_event(ev);
+ 
+     switch (ev->type) {
+     case EV_START:
+         printf("KERNEL: Iniciando escalonamento...\n");
+         fflush(stdout);
+         need_resched = 1;
+         break;
+     case EV_TICK:
+         handle_irq0(ev);
+         break;
+     case EV_SYSCALL:
+         handle_syscall_from_app(ev);
+         break;
+     case EV_IO_DONE:
+         handle_io_complete(ev);
+         break;
+     case EV_EXIT:
+         handle_process_finished(ev);
+         break;
+     case EV_SWAP_DONE:
+         handle_swap_complete(ev);
+         break;
+     }
+ }
+ 
+ /*******************************************************************************
+  * end_batch - Trabalho adiado até o fim de um lote de eventos
+  *
+  * Roda o escalonador uma única vez para todos os eventos do lote, despacha
+  * de imediato se a CPU ficou ociosa com alguém pronto, reprograma o clock e
+  * publica as estatísticas.
+  ******************************************************************************/
+ void end_batch() {
+     if (record_file)
+         fprintf(record_file, "B %ld\n", current_event_seq);
+     if (need_resched) {
+         need_resched = 0;
+         schedule();
+     }
+     idle_fast_path();
+     clock_program();
+     kstat_publish();
+ }
+ 
+ /*******************************************************************************
+  * pid_index_create - Aloca o índice de PIDs para a tabela de processos
+  *
+  * O índice guarda os apps vivos: o PID entra ao criar o processo e sai
+  * quando ele é coletado. Os sinais de syscall e os filhos terminados são
+  * associados ao PCB por ele, em O(1), qualquer que seja o número de apps.
+  ******************************************************************************/
+ void pid_index_create() {
+     unsigned long cap = ph_capacity(num_apps);
+     PidSlot *slots = malloc(cap * sizeof(PidSlot));
+     if (!slots) {
+         perror("malloc");
+         exit(1);
+     }
+     ph_init(&pid_index, slots, cap);
+ }
+ 
+ /*******************************************************************************
+  * TÉRMINO DE PROCESSOS VIA PIDFD
+  *
+  * Cada filho (os apps e o InterControllerSim) tem um pidfd (pidfd_open), que
+  * fica legível quando o processo termina. Os pidfds são esperados pelo
+  * bottom half junto com os sinais, em um único ppoll: o término de um app
+  * não depende de SIGCHLD (que pode se fundir) nem de varrer os filhos com
+  * waitpid a cada interrupção, e cada término é coletado pelo seu próprio
+  * pidfd. A posição num_apps do vetor é a do controlador; uma posição com
+  * fd negativo (processo já coletado) é ignorada pelo ppoll.
+  ******************************************************************************/
+ #ifndef P_PIDFD
+ #define P_PIDFD 3
+ #endif
+ 
+ struct pollfd *exit_fds = NULL;
+ int exit_nfds = 0;
+ 
+ /*******************************************************************************
+  * exit_watch_create - Aloca o vetor de pidfds (apps e controlador)
+  ******************************************************************************/
+ void exit_watch_create() {
+     exit_nfds = num_apps + 1;
+     exit_fds = malloc(exit_nfds * sizeof(struct pollfd));
+     if (!exit_fds) {
+         perror("malloc");
+         exit(1);
+     }
+     for (int i = 0; i < exit_nfds; i++) {
+         exit_fds[i].fd = -1;
+         exit_fds[i].events = POLLIN;
+         exit_fds[i].revents = 0;
+     }
+ }
+ 
+ /*******************************************************************************
+  * exit_watch - Abre o pidfd do filho 'pid' na posição 'slot'
+  ******************************************************************************/
+ void exit_watch(int slot, pid_t pid) {
+     int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+     if (fd < 0) {
+         perror("pidfd_open");
+         exit(1);
+     }
+     exit_fds[slot].fd = fd;
+ }
+ 
+ /*******************************************************************************
+  * reap_children - Coleta os filhos cujos pidfds ficaram legíveis
+  *
+  * Chamada pelo bottom half quando o ppoll indica pidfds legíveis, depois das
+  * interrupções do lote, de modo que o término de um app é sempre um evento
+  * EXIT próprio, posterior à sua syscall EXIT, e nunca acontece no meio de
+  * uma decisão do escalonador. O app terminado também sai do índice
+  * pid_index.
+  ******************************************************************************/
+ void reap_children() {
+     for (int i = 0; i < exit_nfds; i++) {
+         if (exit_fds[i].fd < 0 || !(exit_fds[i].revents & POLLIN))
+             continue;
+ 
+         siginfo_t info;
+         memset(&info, 0, sizeof(info));
+         if (waitid(P_PIDFD, exit_fds[i].fd, &info, WEXITED | WNOHANG) < 0 || info.si_pid == 0)
+             continue;
+         close(exit_fds[i].fd);
+         exit_fds[i].fd = -1;
+         exit_fds[i].revents = 0;
+ 
+         if (i < num_apps) {
+             ph_remove(&pid_index, pcb_table[i].pid);
+             KernelEvent ev = { .type = EV_EXIT, .proc = i };
+             deliver_event(&ev);
+         } else {
+             printf("KERNEL: InterControllerSim terminou\n");
+             fflush(stdout);
+         }
+     }
+ }
+ 
+ /*******************************************************************************
+  * TOP HALF E BOTTOM HALF
+  *
+  * O handler de sinal (top half) só registra o número do sinal, o valor e o
+  * remetente (SA_SIGINFO) e o instante de chegada em um anel circular de
+  * produtor e consumidor únicos, sem travas:
+  * o handler é o único a escrever 'head' e o laço principal o único a
+  * escrever 'tail', ambos com acesso atômico. Nenhuma chamada que não seja
+  * async-signal-safe acontece no handler.
+  *
+  * O laço principal (bottom half) espera com sigsuspend até haver entradas,
+  * retira todas as pendentes de uma vez e as converte em eventos, tratados em
+  * sequência; o escalonador, o clock e as estatísticas rodam uma vez ao fim
+  * do lote (end_batch). Durante o bottom half os sinais ficam desbloqueados,
+  * de modo que novas interrupções são registradas sem esperar o tratamento
+  * das anteriores.
+  *
+  * Os canais de IRQ0, IRQ1 e IRQ2 são sinais de tempo real (shared.h): cada
+  * envio é enfileirado pelo sistema e gera uma entrada própria no anel. O
+  * valor de cada sinal é conferido no bottom half:
+  *   - IRQ0: números de tick consecutivos; um salto conta ticks perdidos
+  *   - IRQ1: o número do pedido deve ser o do I/O em atendimento
+  *   - IRQ2: índice do app e número da syscall; um salto na sequência do app
+  *     conta syscalls perdidas
+  * Os términos de processos não passam por sinais: chegam pelos pidfds,
+  * esperados no mesmo ppoll do bottom half.
+  ******************************************************************************/
+ #define IRQ_RING_SIZE 1024          // Potência de 2
+ 
+ /*
+  * IrqEntry - Interrupção registrada pelo top half
+  *
+  * Campos:
+  *   sig   - Sinal recebido
+  *   value - Valor enviado com sigqueue (si_value)
+  *   pid   - Processo remetente (si_pid)
+  *   ns    - Instante de chegada (CLOCK_MONOTONIC)
+  */
+ typedef struct {
+     int sig;
+     int value;
+     pid_t pid;
+     long long ns;
+ } IrqEntry;
+ 
+ IrqEntry irq_ring[IRQ_RING_SIZE];
+ volatile unsigned long irq_head = 0;    // Próxima posição a escrever (top half)
+ volatile unsigned long irq_tail = 0;    // Próxima posição a ler (bottom half)
+ volatile long irq_overflows = 0;        // Interrupções descartadas com o anel cheio
+ long bh_batches = 0, bh_events = 0, bh_max_batch = 0;
+ long long bh_delay_sum_ns = 0, bh_delay_max_ns = 0;
+ long sig_lost = 0;                      // Saltos nas sequências de IRQ0 e IRQ2
+ long sig_mismatches = 0;                // Valores que não conferem com o estado
+ long sig_send_retries = 0;              // sigqueue recusados com EAGAIN
+ long syscalls_not_current = 0;          // Syscalls de um app que já não era o atual
+ uint32_t irq0_seq = 0;                  // Número do último tick recebido
+ 
+ /*******************************************************************************
+  * irq_top_half - Handler dos sinais do kernel: registra a interrupção
+  *
+  * Contexto: Handler de sinal - executado com os sinais do kernel bloqueados
+  ******************************************************************************/
+ void irq_top_half(int sig, siginfo_t *si, void *uc) {
+     unsigned long head = __atomic_load_n(&irq_head, __ATOMIC_RELAXED);
+     if (head - __atomic_load_n(&irq_tail, __ATOMIC_ACQUIRE) == IRQ_RING_SIZE) {
+         irq_overflows++;
+         return;
+     }
+     IrqEntry *e = &irq_ring[head % IRQ_RING_SIZE];
+     e->sig = sig;
+     e->value = si->si_value.sival_int;
+     e->pid = si->si_pid;
+     e->ns = now_ns();
+     __atomic_store_n(&irq_head, head + 1, __ATOMIC_RELEASE);
+ }
+ 
+ /*******************************************************************************
+  * irq_event - Converte uma interrupção registrada no evento correspondente
+  *
+  *   SIG_IRQ0    → TICK (IRQ0)
+  *   SIG_SYSCALL → SYSCALL (IRQ2), copiando o slot de syscall do remetente
+  *   SIG_IRQ1    → IODONE (IRQ1)
+  *   SIG_IRQ3    → SWAPDONE (IRQ3)
+  *
+  * A syscall é atribuída ao processo que enviou o sinal (si_pid, buscado em
+  * pid_index), e não ao processo atual: um app recém-preemptado pode ter
+  * sinalizado a syscall antes de ver o pedido de preempção, quando outro já
+  * foi despachado. Sinais de PIDs desconhecidos ou de apps que não estão
+  * RUNNING nem READY são descartados.
+  ******************************************************************************/
+ void irq_event(const IrqEntry *e) {
+     KernelEvent ev;
+     int sig = e->sig;
+ 
+     memset(&ev, 0, sizeof(ev));
+     if (sig == SIG_IRQ0) {
+         uint32_t seq = (uint32_t)SIGVAL_SEQ(e->value);
+         sig_lost += (seq - irq0_seq - 1) & SIGVAL_SEQ_MASK;
+         irq0_seq = seq;
+         ev.type = EV_TICK;
+     } else if (sig == SIG_IRQ1) {
+         if (io_current == -1 || e->value != (int)io_current_request())
+             sig_mismatches++;
+         ev.type = EV_IO_DONE;
+     } else if (sig == SIG_IRQ3) {
+         if (swap_current < 0 || e->value != (int)pcb_table[swap_current].swap_request)
+             sig_mismatches++;
+         ev.type = EV_SWAP_DONE;
+     } else {
+         int proc = ph_lookup(&pid_index, e->pid);
+         if (proc < 0 || SIGVAL_INDEX(e->value) != proc) {
+             sig_mismatches++;
+             return;
+         }
+         uint32_t seq = (uint32_t)SIGVAL_SEQ(e->value);
+         sig_lost += (seq - pcb_table[proc].syscall_seq - 1) & SIGVAL_SEQ_MASK;
+         pcb_table[proc].syscall_seq = seq;
+         if (pcb_table[proc].state != RUNNING && pcb_table[proc].state != READY) {
+             sig_mismatches++;
+             return;
+         }
+         if (proc != current_running)
+             syscalls_not_current++;
+ 
+         SyscallContext *sc = &pcb_table[proc].ctx->syscall;
+         ev.type = EV_SYSCALL;
+         ev.proc = proc;
+         if (__atomic_load_n(&sc->pending, __ATOMIC_ACQUIRE)) {
+             ev.sc = *sc;
+             ev.sc.pending = 1;
+             sc->pending = 0;
+         }
+     }
+     deliver_event(&ev);
+ }
+ 
+ /*******************************************************************************
+  * bottom_half_loop - Laço principal do kernel
+  *
+  * Espera com ppoll pelos pidfds dos filhos e, com os sinais do kernel
+  * desbloqueados só durante a espera (como em sigsuspend), pelas
+  * interrupções. Cada lote trata primeiro as interrupções registradas no
+  * anel e depois os términos.
+  *
+  * Parâmetros:
+  *   kernel_signals - Sinais tratados pelo top half
+  *
+  * Retorna:
+  *   Não retorna: termina via shutdown_kernel
+  ******************************************************************************/
+ void bottom_half_loop(const sigset_t *kernel_signals) {
+     sigset_t wait_mask;
+     sigprocmask(SIG_BLOCK, kernel_signals, &wait_mask);
+     sigdelset(&wait_mask, SIG_IRQ0);
+     sigdelset(&wait_mask, SIG_IRQ1);
+     sigdelset(&wait_mask, SIG_IRQ3);
+     sigdelset(&wait_mask, SIG_SYSCALL);
+ 
+     while (1) {
+         // Testar o anel e dormir com os sinais bloqueados evita perder a
+         // interrupção que chega entre o teste e a espera
+         int exits = 0;
+         while (!exits && __atomic_load_n(&irq_head, __ATOMIC_ACQUIRE) == irq_tail)
+             exits = ppoll(exit_fds, exit_nfds, NULL, &wait_mask) > 0;
+         sigprocmask(SIG_UNBLOCK, kernel_signals, NULL);
+ 
+         unsigned long head = __atomic_load_n(&irq_head, __ATOMIC_ACQUIRE);
+         long batch = (long)(head - irq_tail);
+         long long now = now_ns();
+         for (unsigned long t = irq_tail; t != head; t++) {
+             IrqEntry *e = &irq_ring[t % IRQ_RING_SIZE];
+             long long delay = now - e->ns;
+             bh_delay_sum_ns += delay;
+             if (delay > bh_delay_max_ns)
+                 bh_delay_max_ns = delay;
+             irq_event(e);
+         }
+         __atomic_store_n(&irq_tail, head, __ATOMIC_RELEASE);
+ 
+         // Términos depois das interrupções: a syscall EXIT de um app é
+         // sinalizada antes de ele sair e precisa ser tratada antes da coleta
+         if (exits)
+             reap_children();
+         bh_batches++;
+         bh_events += batch;
+         if (batch > bh_max_batch)
+             bh_max_batch = batch;
+         end_batch();
+ 
+         sigprocmask(SIG_BLOCK, kernel_signals, NULL);
+     }
+ }
+ 
+ /*******************************************************************************
+  * LINHA DO TEMPO (TRACE)
+  *
+  * Com --trace <arquivo>, o kernel registra em memória cada mudança de estado
+  * dos processos, as interrupções, as syscalls e as operações do disco, e ao
+  * final grava tudo de uma vez no formato JSON de trace-events do Chrome
+  * (aberto em ui.perfetto.dev ou chrome://tracing).
+  *
+  * Trilhas geradas:
+  *   - "Kernel": eventos instantâneos IRQ0 (tick) e IRQ1 (I/O concluída) e
+  *     os intervalos em que a CPU ficou ociosa (idle)
+  *   - Uma por app: intervalos READY, RUNNING, BLOCKED e SLEEPING e as
+  *     syscalls instantâneas
+  *   - "Disco D1": um intervalo por operação de I/O em atendimento
+  *   - Setas (flows) ligando a syscall ao início do I/O e o fim do I/O ao app
+  *
+  * Os registros usam o instante do evento em tratamento, de modo que o replay
+  * de um log (--replay) produz o mesmo trace da execução original. Durante a
+  * simulação nada é escrito em disco: quando o buffer enche, os registros
+  * seguintes são descartados e contados.
+  ******************************************************************************/
+ 
+ #define TRACE_MAX_RECORDS 262144
+ #define TRACE_KERNEL_TID 0
+ #define TRACE_DISK_TID 100
+ 
+ /* Tipos de registro da linha do tempo */
+ typedef enum {
+     TR_STATE,       // Mudança de estado do processo (arg = ProcessState)
+     TR_EXIT,        // Término do processo
+     TR_IRQ,         // Interrupção (arg = número da IRQ)
+     TR_SYSCALL,     // Syscall de I/O do processo (início do flow de pedido)
+     TR_IO_START,    // Disco começa a atender o pedido
+     TR_IO_DONE,     // Disco conclui o pedido
+     TR_IDLE         // CPU entra (arg = 1) ou sai (arg = 0) da tarefa idle
+ } TraceKind;
+ 
+ /*
+  * TraceRecord - Registro da linha do tempo mantido em memória
+  *
+  * Campos:
+  *   ts   - Instante em nanossegundos desde o início do kernel
+  *   kind - Tipo do registro
+  *   proc - Índice do processo (-1 para registros do kernel)
+  *   arg  - Estado (TR_STATE), número da IRQ (TR_IRQ) ou blocos de uma
+  *          operação do kernel no disco (TR_IO_START)
+  *   id   - Número do pedido de I/O (TR_SYSCALL, TR_IO_START, TR_IO_DONE);
+  *          0 em uma syscall que não gera I/O
+  *   op   - Operação do pedido de I/O ('R' ou 'W'; 'F' no lote de escrita e
+  *          'A' na leitura antecipada)
+  */
+ typedef struct {
+     long long ts;
+     TraceKind kind;
+     int proc;
+     int arg;
+     long id;
+     char op;
+ } TraceRecord;
+ 
+ static const char *state_names[] = { "READY", "RUNNING", "BLOCKED", "SLEEPING", "TERMINATED" };
+ 
+ TraceRecord *trace_buf = NULL;
+ long trace_count = 0;
+ long trace_dropped = 0;
+ long io_request_seq = 0;
+ 
+ /*******************************************************************************
+  * trace_add - Acrescenta um registro ao buffer da linha do tempo (se ativo)
+  ******************************************************************************/
+ void trace_add(TraceKind kind, int proc, int arg, long id, char op) {
+     if (!trace_buf)
+         return;
+     if (trace_count == TRACE_MAX_RECORDS) {
+         trace_dropped++;
+         return;
+     }
+     TraceRecord *r = &trace_buf[trace_count++];
+     r->ts = event_time_ns;
+     r->kind = kind;
+     r->proc = proc;
+     r->arg = arg;
+     r->id = id;
+     r->op = op;
+ }
+ 
+ /*******************************************************************************
+  * response_add - Registra um tempo de resposta (espera em READY até o despacho)
+  ******************************************************************************/
+ long long *response_samples = NULL;
+ long response_count = 0;
+ 
+ void response_add(long long ns) {
+     if (!response_samples) {
+         response_samples = malloc(RESPONSE_MAX_SAMPLES * sizeof(long long));
+         if (!response_samples)
+             return;
+     }
+     if (response_count < RESPONSE_MAX_SAMPLES)
+         response_samples[response_count++] = ns;
+ }
+ 
+ /*******************************************************************************
+  * account_state - Acumula o tempo passado no estado atual até o evento atual
+  ******************************************************************************/
+ void account_state(int i) {
+     PCB *p = &pcb_table[i];
+     p->state_ns[p->state] += event_time_ns - p->state_since_ns;
+     p->state_since_ns = event_time_ns;
+ }
+ 
+ /*******************************************************************************
+  * set_state - Altera o estado de um processo
+  *
+  * Acumula o tempo do estado anterior, coloca o processo na fila de prontos
+  * quando ele passa para READY e registra a mudança na linha do tempo.
+  ******************************************************************************/
+ void set_state(int i, ProcessState state) {
+     if (pcb_table[i].state == READY && state == RUNNING)
+         response_add(event_time_ns - pcb_table[i].state_since_ns);
+     account_state(i);
+     pcb_table[i].state = state;
+     if (state == READY)
+         policy->enqueue(i);
+     trace_add(TR_STATE, i, state, 0, 0);
+ }
+ 
+ /*******************************************************************************
+  * write_trace - Grava o buffer da linha do tempo em JSON de trace-events
+  *
+  * Os intervalos de estado são montados aqui, a partir das mudanças de estado
+  * de cada processo: cada mudança fecha o intervalo do estado anterior. Os
+  * instantes são convertidos para microssegundos, a unidade do formato.
+  ******************************************************************************/
+ void write_trace() {
+     if (!trace_buf)
+         return;
+ 
+     FILE *out = fopen(config.trace_path, "w");
+     if (!out) {
+         perror("fopen");
+         return;
+     }
+ 
+     int last_state[MAX_PROCESSES];
+     long long last_ts[MAX_PROCESSES];
+     long long io_start_ts = 0, idle_start_ts = -1, end_ts = event_time_ns;
+     int io_proc = -1, io_blocks = 0;
+     char io_op = 0;
+     const char *sep = "\n";
+ 
+     fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+ 
+     // Metadados: nomes e ordem das trilhas
+     fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, \"name\": \"process_name\", "
+             "\"args\": {\"name\": \"trab1so (%d apps, quantum %d ms)\"}}",
+             sep, num_apps, config.quantum_ms);
+     sep = ",\n";
+     fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", "
+             "\"args\": {\"name\": \"Kernel\"}}", sep, TRACE_KERNEL_TID);
+     for (int i = 0; i < num_apps; i++) {
+         fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", "
+                 "\"args\": {\"name\": \"A%d (PID %d)\"}}", sep, i + 1, i, pcb_table[i].pid);
+         last_state[i] = -1;
+         last_ts[i] = 0;
+     }
+     fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", "
+             "\"args\": {\"name\": \"Disco D1\"}}", sep, TRACE_DISK_TID);
+     fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_sort_index\", "
+             "\"args\": {\"sort_index\": %d}}", sep, TRACE_DISK_TID, MAX_PROCESSES + 1);
+ 
+     for (long n = 0; n < trace_count; n++) {
+         TraceRecord *r = &trace_buf[n];
+         double ts_us = r->ts / 1e3;
+ 
+         switch (r->kind) {
+         case TR_STATE:
+         case TR_EXIT:
+             if (last_state[r->proc] >= 0 && r->ts >= last_ts[r->proc]) {
+                 fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"cat\": \"estado\", "
+                         "\"name\": \"%s\", \"ts\": %.3f, \"dur\": %.3f}",
+                         sep, r->proc + 1, state_names[last_state[r->proc]],
+                         last_ts[r->proc] / 1e3, (r->ts - last_ts[r->proc]) / 1e3);
+             }
+             last_state[r->proc] = r->kind == TR_STATE ? r->arg : -1;
+             last_ts[r->proc] = r->ts;
+             if (r->kind == TR_EXIT)
+                 fprintf(out, "%s{\"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, "
+                         "\"cat\": \"processo\", \"name\": \"exit\", \"ts\": %.3f}",
+                         sep, r->proc + 1, ts_us);
+             break;
+         case TR_IRQ:
+             fprintf(out, "%s{\"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, "
+                     "\"cat\": \"irq\", \"name\": \"IRQ%d\", \"ts\": %.3f}",
+                     sep, TRACE_KERNEL_TID, r->arg, ts_us);
+             break;
+         case TR_SYSCALL:
+             fprintf(out, "%s{\"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, "
+                     "\"cat\": \"syscall\", \"name\": \"syscall %c\", \"ts\": %.3f, "
+                     "\"args\": {\"io\": %ld}}", sep, r->proc + 1, r->op, ts_us, r->id);
+             if (r->id == 0)
+                 break;
+             fprintf(out, "%s{\"ph\": \"s\", \"pid\": 1, \"tid\": %d, \"cat\": \"io\", "
+                     "\"name\": \"pedido\", \"id\": %ld, \"ts\": %.3f}",
+                     sep, r->proc + 1, 2 * r->id, ts_us);
+             break;
+         case TR_IO_START:
+             io_proc = r->proc;
+             io_op = r->op;
+             io_blocks = r->arg;
+             io_start_ts = r->ts;
+             if (r->proc < 0)
+                 break;     // Operação do próprio kernel: não há pedido de app
+             fprintf(out, "%s{\"ph\": \"f\", \"bp\": \"e\", \"pid\": 1, \"tid\": %d, "
+                     "\"cat\": \"io\", \"name\": \"pedido\", \"id\": %ld, \"ts\": %.3f}",
+                     sep, TRACE_DISK_TID, 2 * r->id, ts_us);
+             break;
+         case TR_IO_DONE:
+             if (io_proc >= 0) {
+                 fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"cat\": \"io\", "
+                         "\"name\": \"I/O A%d %c\", \"ts\": %.3f, \"dur\": %.3f, "
+                         "\"args\": {\"io\": %ld}}", sep, TRACE_DISK_TID, io_proc,
+                         io_op ? io_op : '-', io_start_ts / 1e3, (r->ts - io_start_ts) / 1e3, r->id);
+             } else if (io_op) {
+                 fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"cat\": \"io\", "
+                         "\"name\": \"%s\", \"ts\": %.3f, \"dur\": %.3f, "
+                         "\"args\": {\"io\": %ld, \"blocos\": %d}}", sep, TRACE_DISK_TID,
+                         io_op == 'F' ? "Lote de escrita" : "Leitura antecipada",
+                         io_start_ts / 1e3, (r->ts - io_start_ts) / 1e3, r->id, io_blocks);
+             }
+             io_op = 0;
+             if (r->proc < 0)
+                 break;
+             fprintf(out, "%s{\"ph\": \"s\", \"pid\": 1, \"tid\": %d, \"cat\": \"io\", "
+                     "\"name\": \"conclusao\", \"id\": %ld, \"ts\": %.3f}",
+                     sep, TRACE_DISK_TID, 2 * r->id + 1, ts_us);
+             fprintf(out, "%s{\"ph\": \"f\", \"bp\": \"e\", \"pid\": 1, \"tid\": %d, "
+                     "\"cat\": \"io\", \"name\": \"conclusao\", \"id\": %ld, \"ts\": %.3f}",
+                     sep, r->proc + 1, 2 * r->id + 1, ts_us);
+             io_proc = -1;
+             break;
+         case TR_IDLE:
+             if (r->arg) {
+                 idle_start_ts = r->ts;
+             } else if (idle_start_ts >= 0) {
+                 fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"cat\": \"cpu\", "
+                         "\"name\": \"idle\", \"ts\": %.3f, \"dur\": %.3f}",
+                         sep, TRACE_KERNEL_TID, idle_start_ts / 1e3, (r->ts - idle_start_ts) / 1e3);
+                 idle_start_ts = -1;
+             }
+             break;
+         }
+     }
+ 
+     // Fecha os intervalos ainda abertos no instante final
+     for (int i = 0; i < num_apps; i++) {
+         if (last_state[i] >= 0 && end_ts >= last_ts[i])
+             fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"cat\": \"estado\", "
+                     "\"name\": \"%s\", \"ts\": %.3f, \"dur\": %.3f}",
+                     sep, i + 1, state_names[last_state[i]], last_ts[i] / 1e3,
+                     (end_ts - last_ts[i]) / 1e3);
+     }
+ 
+     fprintf(out, "\n], \"otherData\": {\"records\": %ld, \"dropped\": %ld}}\n",
+             trace_count, trace_dropped);
+     fclose(out);
+ 
+     printf("KERNEL: Linha do tempo gravada em %s (%ld registros", config.trace_path, trace_count);
+     if (trace_dropped)
+         printf(", %ld descartados", trace_dropped);
+     printf(")\n");
+     fflush(stdout);
+ }
+ 
+ /*******************************************************************************
+  * ESTATÍSTICAS AO VIVO
+  *
+  * O kernel mantém um segmento KstatSegment (kstat.h) em um memfd e o
+  * atualiza, sob seqlock, ao final de cada evento tratado. A ferramenta kstat
+  * o mapeia por /proc/<pid>/fd/<n> e o lê sem interagir com o kernel.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * kstat_create - Cria o segmento de estatísticas ao vivo
+  *
+  * Falhas não são fatais: a simulação segue sem estatísticas ao vivo.
+  ******************************************************************************/
+ void kstat_create() {
+     int fd = memfd_create(KSTAT_MEMFD_NAME, MFD_CLOEXEC);
+     if (fd < 0 || ftruncate(fd, sizeof(KstatSegment)) < 0) {
+         perror("memfd_create");
+         return;
+     }
+     kstat = mmap(NULL, sizeof(KstatSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+     if (kstat == MAP_FAILED) {
+         perror("mmap");
+         kstat = NULL;
+         close(fd);
+         return;
+     }
+ 
+     memset(kstat, 0, sizeof(KstatSegment));
+     kstat->magic = KSTAT_MAGIC;
+     kstat->kernel_pid = getpid();
+     kstat->num_apps = num_apps;
+     kstat->quantum_ms = config.quantum_ms;
+     kstat->io_ms = config.io_ms;
+     kstat->start_mono_ns = start_ns;
+     kstat_publish();
+ 
+     printf("KERNEL: Estatisticas ao vivo em /proc/%d/fd/%d (use: ./kstat %d)\n",
+            getpid(), fd, getpid());
+     fflush(stdout);
+ }
+ 
+ /*******************************************************************************
+  * kstat_publish - Publica os contadores e o estado dos processos
+  ******************************************************************************/
+ void kstat_publish() {
+     if (!kstat)
+         return;
+ 
+     long io_waiting = 0;
+     for (int i = 0; i < num_apps; i++)
+         if (pcb_table[i].state == BLOCKED && pcb_table[i].io_pending && !pcb_table[i].terminated)
+             io_waiting++;
+ 
+     kstat_write_begin(kstat);
+     kstat->running = finished_processes < num_apps;
+     kstat->current = current_running;
+     kstat->update_ns = event_time_ns;
+     kstat->events = event_seq;
+     kstat->ticks = stats.ticks;
+     kstat->dispatches = stats.dispatches;
+     kstat->preemptions = stats.preemptions;
+     kstat->syscalls = stats.syscalls;
+     kstat->io_in_flight = io_in_progress;
+     kstat->io_queued = io_waiting - io_in_progress > 0 ? io_waiting - io_in_progress : 0;
+     kstat->io_completed = stats.io_completed;
+     kstat->idle_ns = stats.idle_ns;
+     kstat->idle_since_ns = idle_since_ns;
+     for (int i = 0; i < num_apps; i++) {
+         PCB *p = &pcb_table[i];
+         KstatProc *kp = &kstat->procs[i];
+         kp->pid = p->pid;
+         kp->state = p->state;
+         kp->terminated = p->terminated;
+         kp->pc = p->ctx->app_pc;
+         kp->state_since_ns = p->state_since_ns;
+         kp->cpu_ns = p->state_ns[RUNNING];
+         kp->ready_ns = p->state_ns[READY];
+         kp->blocked_ns = p->state_ns[BLOCKED];
+         kp->sleep_ns = p->state_ns[SLEEPING];
+         kp->dispatches = p->dispatches;
+     }
+     kstat_write_end(kstat);
+ }
+ 
+ /*******************************************************************************
+  * response_percentile - Percentil (vizinho mais próximo) dos tempos de resposta
+  ******************************************************************************/
+ int compare_ll(const void *a, const void *b) {
+     long long x = *(const long long *)a, y = *(const long long *)b;
+     return (x > y) - (x < y);
+ }
+ 
+ long long response_percentile(int pct) {
+     if (response_count == 0)
+         return 0;
+     qsort(response_samples, response_count, sizeof(long long), compare_ll);
+     long rank = (pct * response_count + 99) / 100;
+     return response_samples[rank > 0 ? rank - 1 : 0];
+ }
+ 
+ /*******************************************************************************
+  * write_metrics - Grava as métricas da simulação (opção -o)
+  *
+  * Formato: uma linha "chave=valor" por métrica, para ser agregado pelo
+  * simsweep. Os instantes vêm dos eventos, de modo que o replay de um log
+  * produz as mesmas métricas da execução original.
+  ******************************************************************************/
+ void write_metrics() {
+     if (!config.metrics_path)
+         return;
+ 
+     FILE *out = fopen(config.metrics_path, "w");
+     if (!out) {
+         perror("fopen");
+         return;
+     }
+ 
+     long long makespan_ns = event_time_ns;
+     long long sum_turnaround_ns = 0, max_turnaround_ns = 0;
+     for (int i = 0; i < num_apps; i++) {
+         sum_turnaround_ns += pcb_table[i].exit_ns;
+         if (pcb_table[i].exit_ns > max_turnaround_ns)
+             max_turnaround_ns = pcb_table[i].exit_ns;
+     }
+ 
+     fprintf(out, "num_apps=%d\n", num_apps);
+     fprintf(out, "quantum_ms=%d\n", config.quantum_ms);
+     fprintf(out, "io_ms=%d\n", config.io_ms);
+     fprintf(out, "instr_ms=%d\n", config.instr_ms);
+     fprintf(out, "sleep_ms=%d\n", config.sleep_ms);
+     fprintf(out, "io_mix=%s\n", config.io_mix);
+     fprintf(out, "policy=%s\n", config.policy);
+     fprintf(out, "nice=");
+     for (int i = 0; i < num_apps; i++)
+         fprintf(out, "%s%d", i ? "," : "", pcb_table[i].nice);
+     fprintf(out, "\n");
+     fprintf(out, "makespan_ms=%.3f\n", makespan_ns / 1e6);
+     fprintf(out, "ticks=%ld\n", stats.ticks);
+     fprintf(out, "dispatches=%ld\n", stats.dispatches);
+     fprintf(out, "preemptions=%ld\n", stats.preemptions);
+     fprintf(out, "syscalls=%ld\n", stats.syscalls);
+     fprintf(out, "io_completed=%ld\n", stats.io_completed);
+     fprintf(out, "sleeps=%ld\n", stats.sleeps);
+     fprintf(out, "wakeups=%ld\n", stats.wakeups);
+     // Ticks que o clock periódico teria gerado no mesmo intervalo. Cada tick
+     // acorda o controlador e o kernel; cada reprogramação, só o controlador
+     long ticks_periodic = config.quantum_ms > 0 ? makespan_ns / 1000000 / config.quantum_ms : 0;
+     long ticks_saved = ticks_periodic > stats.ticks ? ticks_periodic - stats.ticks : 0;
+     double makespan_s = makespan_ns > 0 ? makespan_ns / 1e9 : 1.0;
+     fprintf(out, "tickless=%d\n", config.tickless);
+     fprintf(out, "ticks_periodic=%ld\n", ticks_periodic);
+     fprintf(out, "ticks_saved=%ld\n", ticks_saved);
+     fprintf(out, "ticks_saved_per_sec=%.3f\n", ticks_saved / makespan_s);
+     fprintf(out, "clock_programs=%ld\n", stats.clock_programs);
+     fprintf(out, "wakeups_saved_per_sec=%.3f\n",
+             (2.0 * ticks_saved - stats.clock_programs) / makespan_s);
+     fprintf(out, "idle_ms=%.3f\n", idle_ns_total() / 1e6);
+     fprintf(out, "idle_pct=%.2f\n", makespan_ns > 0 ? 100.0 * idle_ns_total() / makespan_ns : 0.0);
+     fprintf(out, "idle_periods=%ld\n", stats.idle_periods);
+     fprintf(out, "fast_dispatches=%ld\n", stats.fast_dispatches);
+     fprintf(out, "bh_batches=%ld\n", bh_batches);
+     fprintf(out, "bh_events=%ld\n", bh_events);
+     fprintf(out, "bh_max_batch=%ld\n", bh_max_batch);
+     fprintf(out, "bh_avg_delay_us=%.3f\n", bh_events ? bh_delay_sum_ns / 1e3 / bh_events : 0.0);
+     fprintf(out, "bh_max_delay_us=%.3f\n", bh_delay_max_ns / 1e3);
+     fprintf(out, "irq_ring_overflows=%ld\n", irq_overflows);
+     fprintf(out, "sig_lost=%ld\n", sig_lost);
+     fprintf(out, "sig_mismatches=%ld\n", sig_mismatches);
+     fprintf(out, "sig_send_retries=%ld\n", sig_send_retries);
+     fprintf(out, "syscalls_not_current=%ld\n", syscalls_not_current);
+     fprintf(out, "pid_hash_lookups=%ld\n", pid_index.lookups);
+     fprintf(out, "pid_hash_avg_probes=%.3f\n",
+             pid_index.lookups ? (double)pid_index.probes / pid_index.lookups : 0.0);
+     fprintf(out, "avg_quantum_ms=%.3f\n",
+             stats.dispatches ? (double)stats.quantum_sum_ms / stats.dispatches : 0.0);
+     fprintf(out, "response_samples=%ld\n", response_count);
+     fprintf(out, "response_p50_ms=%.3f\n", response_percentile(50) / 1e6);
+     fprintf(out, "response_p90_ms=%.3f\n", response_percentile(90) / 1e6);
+     fprintf(out, "response_p99_ms=%.3f\n", response_percentile(99) / 1e6);
+     fprintf(out, "response_max_ms=%.3f\n", response_percentile(100) / 1e6);
+     fprintf(out, "ctx_switches_per_sec=%.3f\n",
+             makespan_ns > 0 ? stats.dispatches / (makespan_ns / 1e9) : 0.0);
+     fprintf(out, "avg_turnaround_ms=%.3f\n", sum_turnaround_ns / 1e6 / num_apps);
+     fprintf(out, "max_turnaround_ms=%.3f\n", max_turnaround_ns / 1e6);
+ 
+     // Syscall EXIT: tempo entre o aviso e a coleta e contadores finais
+     fprintf(out, "exit_syscalls=%ld\n", stats.exit_syscalls);
+     fprintf(out, "exit_gap_saved_ms_total=%.3f\n", stats.exit_gap_sum_ns / 1e6);
+     fprintf(out, "exit_gap_saved_ms_avg=%.3f\n",
+             stats.exit_syscalls ? stats.exit_gap_sum_ns / 1e6 / stats.exit_syscalls : 0.0);
+     fprintf(out, "exit_gap_saved_ms_max=%.3f\n", stats.exit_gap_max_ns / 1e6);
+     for (int i = 0; i < num_apps; i++) {
+         if (!pcb_table[i].exit_syscall)
+             continue;
+         fprintf(out, "exit_app_%d_code=%d\n", i, pcb_table[i].exit_code);
+         fprintf(out, "exit_app_%d_instr=%d\n", i, pcb_table[i].exit_instr);
+         fprintf(out, "exit_app_%d_syscalls=%d\n", i, pcb_table[i].exit_ctrs[EXIT_CTR_SYSCALLS]);
+         fprintf(out, "exit_app_%d_parks=%d\n", i, pcb_table[i].exit_ctrs[EXIT_CTR_PARKS]);
+         fprintf(out, "exit_app_%d_cpu_ms=%d\n", i, pcb_table[i].exit_ctrs[EXIT_CTR_CPU_MS]);
+     }
+ 
+     // Leituras do disco: tempo bloqueado por READ (0 nos acertos do cache).
+     // A redução com -C aparece comparando read_blocked_ms_* com uma execução
+     // sem cache; cache_device_ms_saved é o tempo de disco que as leituras
+     // evitadas teriam ocupado, e que deixa de atrasar a fila
+     fprintf(out, "reads=%ld\n", stats.reads);
+     fprintf(out, "device_reads=%ld\n", stats.device_reads);
+     fprintf(out, "device_read_ms_avg=%.3f\n",
+             stats.device_reads ? stats.device_read_ns / 1e6 / stats.device_reads : 0.0);
+     fprintf(out, "read_blocked_ms_total=%.3f\n", stats.read_blocked_ns / 1e6);
+     fprintf(out, "read_blocked_ms_avg=%.3f\n",
+             stats.reads ? stats.read_blocked_ns / 1e6 / stats.reads : 0.0);
+     if (config.cache_blocks > 0) {
+         fprintf(out, "cache_blocks=%d\n", config.cache_blocks);
+         fprintf(out, "cache_hits=%ld\n", stats.cache_hits);
+         fprintf(out, "cache_joins=%ld\n", stats.cache_joins);
+         fprintf(out, "cache_misses=%ld\n", stats.cache_misses);
+         fprintf(out, "cache_bypass=%ld\n", stats.cache_bypass);
+         fprintf(out, "cache_hit_ratio=%.4f\n",
+                 stats.reads ? (double)stats.cache_hits / stats.reads : 0.0);
+         fprintf(out, "cache_ghost_hits=%ld\n", bcache.ghost_hits);
+         fprintf(out, "cache_evictions=%ld\n", bcache.evictions);
+         fprintf(out, "cache_join_wait_ms_avg=%.3f\n",
+                 stats.cache_joins ? stats.cache_join_ns / 1e6 / stats.cache_joins : 0.0);
+         fprintf(out, "cache_device_reads_saved=%ld\n", stats.cache_hits + stats.cache_joins);
+         fprintf(out, "cache_device_ms_saved=%ld\n",
+                 (stats.cache_hits + stats.cache_joins) * config.io_ms);
+     }
+ 
+     // Leitura antecipada: blocos trazidos, usados por um READ (mesmo que
+     // ainda em leitura, ra_late) e desperdiçados (substituídos ou
+     // sobrescritos sem leitura, ou ainda não lidos no fim)
+     if (config.ra_max > 0) {
+         long unused = 0;
+         for (int b = 0; b < bcache.nbufs; b++)
+             unused += ra_unused[b];
+         fprintf(out, "ra_max_window=%d\n", config.ra_max);
+         fprintf(out, "ra_streams=%ld\n", stats.ra_streams);
+         fprintf(out, "ra_requests=%ld\n", stats.ra_requests);
+         fprintf(out, "ra_blocks=%ld\n", stats.ra_blocks);
+         fprintf(out, "ra_merged_blocks=%ld\n", stats.ra_merged);
+         fprintf(out, "ra_hits=%ld\n", stats.ra_hits);
+         fprintf(out, "ra_late=%ld\n", stats.ra_late);
+         fprintf(out, "ra_hit_rate=%.4f\n",
+                 stats.ra_blocks ? (double)stats.ra_hits / stats.ra_blocks : 0.0);
+         fprintf(out, "ra_read_share=%.4f\n",
+                 stats.reads ? (double)stats.ra_hits / stats.reads : 0.0);
+         fprintf(out, "ra_wasted_blocks=%ld\n", stats.ra_wasted + unused);
+         fprintf(out, "ra_cancels=%ld\n", stats.ra_cancels);
+         fprintf(out, "ra_cancelled_blocks=%ld\n", stats.ra_cancelled_blocks);
+     }
+ 
+     // Escritas: tempo da syscall WRITE até o app poder continuar (0 quando
+     // adiada no cache; com -B, só o freio de sujos pesa). Cada WRITE gravada
+     // na hora seria uma operação do disco; com -B, as operações usadas são
+     // os lotes, as escritas direto no disco e os lotes que ainda faltariam
+     // para os blocos sujos no fim
+     fprintf(out, "writes=%ld\n", stats.writes);
+     fprintf(out, "device_writes=%ld\n", stats.device_writes);
+     fprintf(out, "write_ms_avg=%.3f\n",
+             stats.writes ? stats.write_ns / 1e6 / stats.writes : 0.0);
+     fprintf(out, "fsyncs=%ld\n", stats.fsyncs);
+     if (config.wb_expire_ms > 0) {
+         long flushes_left = (bcache.dirty + WB_BATCH_MAX - 1) / WB_BATCH_MAX;
+         fprintf(out, "wb_expire_ms=%d\n", config.wb_expire_ms);
+         fprintf(out, "wb_proc_dirty_limit=%d\n", wb_proc_limit);
+         fprintf(out, "writes_buffered=%ld\n", stats.writes_buffered);
+         fprintf(out, "writes_absorbed=%ld\n", stats.writes_absorbed);
+         fprintf(out, "writes_bypass=%ld\n", stats.writes_bypass);
+         fprintf(out, "writes_throttled=%ld\n", stats.writes_throttled);
+         fprintf(out, "wb_throttle_ms_avg=%.3f\n",
+                 stats.writes_throttled ? stats.wb_throttle_ns / 1e6 / stats.writes_throttled : 0.0);
+         fprintf(out, "wb_flushes=%ld\n", stats.wb_flushes);
+         fprintf(out, "wb_blocks_flushed=%ld\n", stats.wb_blocks_flushed);
+         fprintf(out, "wb_blocks_per_flush=%.2f\n",
+                 stats.wb_flushes ? (double)stats.wb_blocks_flushed / stats.wb_flushes : 0.0);
+         fprintf(out, "wb_dirty_at_exit=%d\n", bcache.dirty);
+         fprintf(out, "wb_device_ops_saved=%ld\n",
+                 stats.writes - stats.device_writes - stats.wb_flushes - flushes_left);
+         fprintf(out, "fsync_waits=%ld\n", stats.fsync_waits);
+         fprintf(out, "fsync_ms_avg=%.3f\n",
+                 stats.fsync_waits ? stats.fsync_ns / 1e6 / stats.fsync_waits : 0.0);
+     }
+ 
+     // Memória virtual: TLB, faltas de página e custo do swap. As referências
+     // e os acertos da TLB vêm dos blocos de contexto (zerados no replay)
+     if (config.vm_pages > 0) {
+         uint64_t vm_refs = 0, tlb_hits = 0;
+         for (int i = 0; i < num_apps; i++) {
+             vm_refs += pcb_table[i].ctx->vm_refs;
+             tlb_hits += pcb_table[i].ctx->tlb_hits;
+         }
+         fprintf(out, "vm_pages=%d\n", config.vm_pages);
+         fprintf(out, "vm_frames=%d\n", config.vm_frames);
+         fprintf(out, "vm_refs_per_instr=%d\n", config.vm_refs);
+         fprintf(out, "swap_ms=%d\n", config.swap_ms);
+         fprintf(out, "vm_refs=%llu\n", (unsigned long long)vm_refs);
+         fprintf(out, "vm_refs_per_sec=%.0f\n", vm_refs / makespan_s);
+         fprintf(out, "tlb_hits=%llu\n", (unsigned long long)tlb_hits);
+         fprintf(out, "tlb_hit_ratio=%.4f\n", vm_refs ? (double)tlb_hits / vm_refs : 0.0);
+         fprintf(out, "page_faults=%ld\n", stats.page_faults);
+         fprintf(out, "minor_faults=%ld\n", stats.minor_faults);
+         fprintf(out, "faults_per_1k_refs=%.4f\n", vm_refs ? 1000.0 * stats.page_faults / vm_refs : 0.0);
+         fprintf(out, "faults_per_sec=%.3f\n", stats.page_faults / makespan_s);
+         fprintf(out, "evictions=%ld\n", stats.evictions);
+         fprintf(out, "dirty_evictions=%ld\n", stats.dirty_evictions);
+         fprintf(out, "swap_completed=%ld\n", stats.swap_completed);
+         fprintf(out, "swap_wait_ms_total=%.3f\n", stats.swap_wait_sum_ns / 1e6);
+         fprintf(out, "swap_wait_ms_avg=%.3f\n",
+                 stats.swap_completed ? stats.swap_wait_sum_ns / 1e6 / stats.swap_completed : 0.0);
+         fprintf(out, "page_policy=%s\n", page_repl.policy->name);
+         fprintf(out, "repl_selects=%ld\n", page_repl.selects);
+         fprintf(out, "repl_frames_scanned=%ld\n", page_repl.scanned);
+         fprintf(out, "repl_scan_per_select=%.2f\n",
+                 page_repl.selects ? (double)page_repl.scanned / page_repl.selects : 0.0);
+         fprintf(out, "repl_select_ns_avg=%.0f\n",
+                 page_repl.selects ? (double)stats.repl_select_ns / page_repl.selects : 0.0);
+         fprintf(out, "ref_harvests=%ld\n", stats.ref_harvests);
+         fprintf(out, "ref_bits_cleared=%ld\n", stats.ref_bits_cleared);
+         for (int i = 0; i < num_apps; i++) {
+             uint64_t refs = pcb_table[i].ctx->vm_refs;
+             fprintf(out, "vm_app_%d_refs=%llu\n", i, (unsigned long long)refs);
+             fprintf(out, "vm_app_%d_tlb_hit_ratio=%.4f\n", i,
+                     refs ? (double)pcb_table[i].ctx->tlb_hits / refs : 0.0);
+             fprintf(out, "vm_app_%d_faults=%ld\n", i, pcb_table[i].page_faults);
+         }
+     }
+ 
+     // Fração da CPU usada pelos apps de cada prioridade estática
+     long long cpu_total_ns = 0;
+     for (int i = 0; i < num_apps; i++)
+         cpu_total_ns += pcb_table[i].state_ns[RUNNING];
+     fprintf(out, "prio_array_swaps=%ld\n", prio_rq.swaps);
+     for (int p = 0; p < PA_LEVELS; p++) {
+         int apps = 0;
+         long long cpu_ns = 0;
+         for (int i = 0; i < num_apps; i++) {
+             if (pcb_table[i].prio_node.prio == p) {
+                 apps++;
+                 cpu_ns += pcb_table[i].state_ns[RUNNING];
+             }
+         }
+         if (!apps)
+             continue;
+         fprintf(out, "prio_%d_apps=%d\n", p, apps);
+         fprintf(out, "prio_%d_cpu_ms=%.3f\n", p, cpu_ns / 1e6);
+         fprintf(out, "prio_%d_cpu_share=%.4f\n", p,
+                 cpu_total_ns > 0 ? (double)cpu_ns / cpu_total_ns : 0.0);
+     }
+ 
+     // Tempo real: admissão, prazos perdidos e histograma do atraso
+     long rt_jobs = 0, rt_misses = 0;
+     for (int i = 0; i < num_apps; i++) {
+         rt_jobs += pcb_table[i].rt_jobs;
+         rt_misses += pcb_table[i].rt_misses;
+     }
+     fprintf(out, "rt_admitted=%d\n", rt_admitted);
+     fprintf(out, "rt_rejected=%d\n", rt_rejected);
+     fprintf(out, "rt_utilization=%.4f\n", rt_utilization);
+     fprintf(out, "rt_bound=%.4f\n", rt_bound);
+     fprintf(out, "rt_jobs=%ld\n", rt_jobs);
+     fprintf(out, "rt_misses=%ld\n", rt_misses);
+     fprintf(out, "rt_miss_ratio=%.4f\n", rt_jobs ? (double)rt_misses / rt_jobs : 0.0);
+     for (int i = 0; i < num_apps; i++) {
+         if (!pcb_table[i].rt)
+             continue;
+         fprintf(out, "rt_app_%d_jobs=%ld\n", i, pcb_table[i].rt_jobs);
+         fprintf(out, "rt_app_%d_misses=%ld\n", i, pcb_table[i].rt_misses);
+         fprintf(out, "rt_app_%d_max_lateness_ms=%.3f\n", i, pcb_table[i].rt_max_late_ns / 1e6);
+     }
+     fprintf(out, "rt_lateness_le_0ms=%ld\n", rt_lateness_hist[0]);
+     for (int b = 1; b < RT_HIST_BUCKETS - 1; b++)
+         fprintf(out, "rt_lateness_le_%dms=%ld\n", 1 << (b - 1), rt_lateness_hist[b]);
+     fprintf(out, "rt_lateness_gt_%dms=%ld\n", 1 << (RT_HIST_BUCKETS - 3),
+             rt_lateness_hist[RT_HIST_BUCKETS - 1]);
+ 
+     // Bilhetes e fração da CPU alcançada contra a alvo ao longo do tempo
+     long total_tickets = 0;
+     fprintf(out, "tickets=");
+     for (int i = 0; i < num_apps; i++) {
+         fprintf(out, "%s%d", i ? "," : "", pcb_table[i].tickets);
+         total_tickets += pcb_table[i].tickets;
+     }
+     fprintf(out, "\n");
+     fprintf(out, "lottery_draws=%ld\n", lottery_draws);
+     fprintf(out, "ticket_transfers=%ld\n", ticket_transfers);
+     fprintf(out, "share_samples=%ld\n", share_count);
+     for (long s = 0; s < share_count; s++)
+         fprintf(out, "share_err_%lldms=%.4f\n", share_at_ms[s], share_err[s]);
+     fprintf(out, "share_err_final=%.4f\n", share_count ? share_err[share_count - 1] : 0.0);
+     for (int i = 0; i < num_apps; i++) {
+         fprintf(out, "share_app_%d_target=%.4f\n", i, (double)pcb_table[i].tickets / total_tickets);
+         fprintf(out, "share_app_%d_achieved=%.4f\n", i, share_achieved[i]);
+     }
+     fclose(out);
+ }
+ 
+ /*******************************************************************************
+  * shutdown_kernel - Encerra o sistema quando todos os apps terminaram
+  *
+  * No replay, em vez de encerrar o controlador, apresenta o resultado da
+  * verificação das decisões.
+  ******************************************************************************/
+ void shutdown_kernel() {
+     printf("\nKERNEL: Todos os %d processos terminaram sua execução\n", num_apps);
+     printf("KERNEL: Encerrando o sistema...\n");
+     fflush(stdout);
+ 
+     // Encerra o InterControllerSim
+     if (controller_pid > 0) {
+         kill(controller_pid, SIGKILL);
+     }
+ 
+     if (record_file)
+         fclose(record_file);
+ 
+     if (config.tickless) {
+         long ticks_periodic = event_time_ns / 1000000 / config.quantum_ms;
+         printf("KERNEL: Tickless: %ld ticks em vez de %ld (%ld reprogramacoes do clock)\n",
+                stats.ticks, ticks_periodic, stats.clock_programs);
+         fflush(stdout);
+     }
+ 
+     if (rt_admitted) {
+         long rt_jobs = 0, rt_misses = 0;
+         for (int i = 0; i < num_apps; i++) {
+             rt_jobs += pcb_table[i].rt_jobs;
+             rt_misses += pcb_table[i].rt_misses;
+         }
+         printf("KERNEL: Tempo real (%s): %ld ativacoes, %ld prazos perdidos, utilizacao %.3f (limite %.3f)\n",
+                policy->name, rt_jobs, rt_misses, rt_utilization, rt_bound);
+         fflush(stdout);
+     }
+ 
+     kstat_publish();
+     write_metrics();
+     write_trace();
+ 
+     // Libera recursos
+     free(pcb_table);
+ 
+     printf("KERNEL: Sistema encerrado com sucesso\n");
+     fflush(stdout);
+ 
+     if (replay_mode) {
+         printf("REPLAY: %ld eventos, %ld decisoes verificadas, %ld divergencias\n",
+                replay_events, replay_checked, replay_mismatches);
+         exit(replay_mismatches ? 1 : 0);
+     }
+     exit(0);
+ }
+ 
+ /*******************************************************************************
+  * request_io - Pede ao InterControllerSim o início de uma operação de I/O
+  *
+  * O pedido leva o número do I/O em atendimento (io_current, ou o lote de
+  * escrita), devolvido pelo controlador na IRQ1. No replay não há
+  * controlador: a conclusão vem do próprio log.
+  ******************************************************************************/
+ void request_io() {
+     if (!replay_mode)
+         sig_send_retries += sig_send(controller_pid, SIG_IO_REQ, (int)io_current_request());
+ }
+ 
+ /*******************************************************************************
+  * CACHE DE BLOCOS
+  *
+  * Com -C, os blocos lidos do disco D1 ficam em um cache de config.cache_blocks
+  * buffers no kernel, com substituição 2Q (bcache.h). Uma syscall READ:
+  *   - Acerto: é concluída na hora, sem bloquear nem parar o processo e sem
+  *     pedido ao InterControllerSim; o app volta a executar (ou continua
+  *     READY, se foi preemptado depois de sinalizar)
+  *   - Bloco sendo lido para outro processo: o processo fica BLOCKED, fora
+  *     da fila do disco, até a leitura em andamento terminar
+  *   - Falta: um buffer é reservado e a leitura segue pela fila do disco,
+  *     como antes; na IRQ1 o buffer passa a ser válido e os processos que
+  *     aguardavam o bloco são desbloqueados
+  * Sem buffer disponível (todos reservados), a leitura vai ao disco sem
+  * passar pelo cache.
+  *
+  * Sem -B, WRITE segue direto para o disco. Com -B (escrita adiada), WRITE
+  * é concluída na hora, como um acerto de leitura: o bloco fica sujo em um
+  * buffer e só é gravado depois, por um lote de escrita do próprio kernel:
+  *   - Um lote é uma operação do disco com até WB_BATCH_MAX blocos sujos,
+  *     em ordem de bloco a partir de onde o lote anterior parou (C-SCAN)
+  *   - Há lote quando um bloco está sujo há mais de wb_expire_ms (verificado
+  *     a cada IRQ0), quando os buffers sujos passam de WB_BACKGROUND_PCT do
+  *     cache, ou quando um processo espera (freio ou FSYNC)
+  *   - O disco atende primeiro os processos da fila de bloqueados; um lote
+  *     urgente (processo esperando ou cache acima do limite) passa à frente
+  *   - Um processo com mais de wb_proc_limit buffers sujos tem a WRITE
+  *     concluída no cache, mas fica BLOCKED (freio) até os lotes o deixarem
+  *     dentro do limite, para que um único app não suje o cache inteiro
+  *   - FSYNC ('Y') bloqueia o processo até todos os seus blocos sujos
+  *     estarem gravados; sem blocos sujos, é concluída na hora
+  * Um WRITE de bloco que está sendo lido do disco, ou sem buffer disponível
+  * (todos sujos ou reservados), vai direto para o disco.
+  ******************************************************************************/
+ int *wb_owner = NULL;           // Processo que sujou cada buffer por último
+ long long *wb_dirty_ns = NULL;  // Instante em que cada buffer ficou sujo
+ int wb_batch[WB_BATCH_MAX];     // Buffers do lote de escrita em andamento
+ int wb_batch_count = 0;
+ uint32_t wb_cursor = 0;         // Posição da varredura dos lotes (bc_flush_batch)
+ int wb_pending = 0;             // 1 se um lote deve começar assim que possível
+ long wb_request = 0;            // Número do pedido de I/O do lote em andamento
+ 
+ /*******************************************************************************
+  * cache_create - Cria o cache de blocos
+  ******************************************************************************/
+ void cache_create() {
+     if (config.cache_blocks == 0)
+         return;
+     void *mem = malloc(bc_mem_size(config.cache_blocks));
+     if (!mem) {
+         perror("malloc");
+         exit(1);
+     }
+     bc_init(&bcache, config.cache_blocks, mem);
+ 
+     if (config.ra_max > 0) {
+         ra_unused = calloc(config.cache_blocks, 1);
+         if (!ra_unused) {
+             perror("calloc");
+             exit(1);
+         }
+     }
+     if (config.wb_expire_ms == 0)
+         return;
+     wb_owner = malloc(config.cache_blocks * sizeof(int));
+     wb_dirty_ns = malloc(config.cache_blocks * sizeof(long long));
+     if (!wb_owner || !wb_dirty_ns) {
+         perror("malloc");
+         exit(1);
+     }
+     wb_proc_limit = config.cache_blocks * WB_PROC_DIRTY_PCT / 100;
+     if (wb_proc_limit < 1)
+         wb_proc_limit = 1;
+ }
+ 
+ /*******************************************************************************
+  * cache_complete - Conclui na hora uma syscall atendida pelo cache
+  *
+  * O processo não bloqueia nem é parado: volta a executar (ou continua
+  * READY, se foi preemptado depois de sinalizar).
+  ******************************************************************************/
+ void cache_complete(int proc, char op) {
+     PCB *p = &pcb_table[proc];
+ 
+     stats.syscalls++;
+     p->full_slices = 0;
+     trace_add(TR_SYSCALL, proc, 0, 0, op);
+     if (p->state == RUNNING)
+         resume_app(proc);
+ }
+ 
+ /*******************************************************************************
+  * cache_alloc - Reserva um buffer para 'block' (bc_alloc)
+  *
+  * Um buffer da leitura antecipada substituído sem ter sido lido conta como
+  * leitura antecipada desperdiçada.
+  ******************************************************************************/
+ int cache_alloc(uint32_t block) {
+     int b = bc_alloc(&bcache, block);
+     if (b >= 0 && ra_unused && ra_unused[b]) {
+         ra_unused[b] = 0;
+         stats.ra_wasted++;
+     }
+     return b;
+ }
+ 
+ /*******************************************************************************
+  * cache_use - Um READ encontrou o buffer 'b' (válido ou sendo lido)
+  *
+  * Contabiliza o uso de um bloco trazido pela leitura antecipada.
+  ******************************************************************************/
+ void cache_use(int b) {
+     if (!ra_unused || !ra_unused[b])
+         return;
+     ra_unused[b] = 0;
+     stats.ra_hits++;
+     if (!bc_cached(&bcache, b))
+         stats.ra_late++;
+ }
+ 
+ /*******************************************************************************
+  * cache_wake_joiners - A leitura do buffer 'b' terminou: desbloqueia os
+  * processos que aguardavam o bloco
+  *
+  * Parâmetros:
+  *   reader - Quem leu o bloco, para a mensagem ("A2", "leitura antecipada")
+  ******************************************************************************/
+ void cache_wake_joiners(int b, const char *reader) {
+     for (int i = 0; i < num_apps; i++) {
+         PCB *w = &pcb_table[i];
+         if (w->cache_wait != b)
+             continue;
+         w->cache_wait = -1;
+         w->io_pending = 0;
+         stats.cache_join_ns += event_time_ns - w->io_start_ns;
+         stats.read_blocked_ns += event_time_ns - w->io_start_ns;
+         if (!w->terminated && w->state == BLOCKED) {
+             set_state(i, READY);
+             printf("KERNEL: Processo A%d (PID %d) desbloqueado (bloco %u lido por %s)\n",
+                    i, w->pid, w->io_block, reader);
+             fflush(stdout);
+         }
+     }
+ }
+ 
+ /*******************************************************************************
+  * cache_read - Procura no cache o bloco de uma syscall READ
+  *
+  * Parâmetros:
+  *   ev - Evento SYSCALL com o bloco em sc.arg
+  *
+  * Retorna:
+  *   1 se a leitura foi atendida pelo cache (nada mais a fazer), 0 se o
+  *   processo deve bloquear (com io_buf ou cache_wait preenchidos)
+  ******************************************************************************/
+ int cache_read(KernelEvent *ev) {
+     int proc = ev->proc;
+     PCB *p = &pcb_table[proc];
+     uint32_t block = (uint32_t)ev->sc.arg;
+ 
+     if (config.cache_blocks == 0)
+         return 0;
+     int b = bc_lookup(&bcache, block);
+     if (ra_unused)
+         ra_observe(proc, block, b >= 0);
+     if (b >= 0 && bc_cached(&bcache, b)) {
+         bc_touch(&bcache, b);
+         cache_use(b);
+         stats.reads++;
+         stats.cache_hits++;
+         printf("KERNEL: READ do bloco %u de A%d (PID %d) atendida pelo cache\n",
+                block, proc, p->pid);
+         fflush(stdout);
+         cache_complete(proc, 'R');
+         disk_start_next();
+         return 1;
+     }
+ 
+     if (b >= 0) {
+         cache_use(b);
+         p->cache_wait = b;
+         stats.cache_joins++;
+     } else if ((p->io_buf = cache_alloc(block)) >= 0) {
+         stats.cache_misses++;
+     } else {
+         stats.cache_bypass++;
+     }
+     return 0;
+ }
+ 
+ /*******************************************************************************
+  * cache_io_done - O I/O de 'proc' no disco terminou (IRQ1)
+  *
+  * Contabiliza a espera da leitura ou da escrita; numa leitura, torna válido
+  * o buffer reservado e desbloqueia os processos que aguardavam o mesmo
+  * bloco.
+  ******************************************************************************/
+ void cache_io_done(int proc) {
+     PCB *p = &pcb_table[proc];
+ 
+     if (p->syscall_param == 'W') {
+         stats.device_writes++;
+         stats.write_ns += event_time_ns - p->io_start_ns;
+         return;
+     }
+     if (p->syscall_param != 'R')
+         return;
+     stats.device_reads++;
+     stats.device_read_ns += event_time_ns - p->io_start_ns;
+     stats.read_blocked_ns += event_time_ns - p->io_start_ns;
+     if (p->io_buf < 0)
+         return;
+ 
+     int b = p->io_buf;
+     char reader[16];
+     p->io_buf = -1;
+     bc_fill(&bcache, b);
+     snprintf(reader, sizeof(reader), "A%d", proc);
+     cache_wake_joiners(b, reader);
+ }
+ 
+ /*******************************************************************************
+  * wb_waiting - 1 se algum processo espera por lotes de escrita
+  ******************************************************************************/
+ int wb_waiting() {
+     for (int i = 0; i < num_apps; i++)
+         if (pcb_table[i].wb_wait && !pcb_table[i].terminated)
+             return 1;
+     return 0;
+ }
+ 
+ /*******************************************************************************
+  * wb_urgent - 1 se um lote de escrita deve passar à frente da fila do disco
+  ******************************************************************************/
+ int wb_urgent() {
+     return wb_waiting() || bcache.dirty * 100 >= bcache.nbufs * WB_BACKGROUND_PCT;
+ }
+ 
+ /*******************************************************************************
+  * wb_wake - Desbloqueia os processos cuja espera por lotes terminou
+  *
+  * Um processo freado volta quando fica com até wb_proc_limit buffers
+  * sujos; um FSYNC termina quando o processo não tem mais nenhum.
+  ******************************************************************************/
+ void wb_wake() {
+     for (int i = 0; i < num_apps; i++) {
+         PCB *w = &pcb_table[i];
+         if (!w->wb_wait)
+             continue;
+         if (w->wb_wait == 'W' ? w->dirty > wb_proc_limit : w->dirty > 0)
+             continue;
+ 
+         long long waited = event_time_ns - w->io_start_ns;
+         if (w->wb_wait == 'W') {
+             stats.wb_throttle_ns += waited;
+             stats.write_ns += waited;
+         } else {
+             stats.fsync_ns += waited;
+         }
+         w->wb_wait = 0;
+         w->io_pending = 0;
+         if (!w->terminated && w->state == BLOCKED) {
+             set_state(i, READY);
+             printf("KERNEL: Processo A%d (PID %d) desbloqueado (%s)\n", i, w->pid,
+                    w->syscall_param == 'Y' ? "blocos gravados" : "dentro do limite de sujos");
+             fflush(stdout);
+         }
+     }
+ }
+ 
+ /*******************************************************************************
+  * cache_write - Adia no cache o bloco de uma syscall WRITE (-B)
+  *
+  * Parâmetros:
+  *   ev - Evento SYSCALL com o bloco em sc.arg
+  *
+  * Retorna:
+  *   1 se a escrita foi concluída no cache (nada mais a fazer), 0 se o
+  *   processo deve bloquear: freado (wb_wait = 'W', com o bloco já no cache)
+  *   ou com a escrita direto no disco
+  ******************************************************************************/
+ int cache_write(KernelEvent *ev) {
+     int proc = ev->proc;
+     PCB *p = &pcb_table[proc];
+     uint32_t block = (uint32_t)ev->sc.arg;
+ 
+     if (!wb_owner)
+         return 0;
+ 
+     int b = bc_lookup(&bcache, block);
+     if (b >= 0 && !bc_cached(&bcache, b)) {
+         stats.writes_bypass++;
+         return 0;
+     }
+     if (b >= 0) {
+         bc_touch(&bcache, b);
+         if (ra_unused && ra_unused[b]) {
+             ra_unused[b] = 0;       // Bloco antecipado sobrescrito sem ser lido
+             stats.ra_wasted++;
+         }
+     } else if ((b = cache_alloc(block)) < 0) {
+         stats.writes_bypass++;
+         return 0;
+     }
+ 
+     int state = bcache.state[b];
+     if (state == BC_DIRTY)
+         stats.writes_absorbed++;
+     if (state != BC_DIRTY)
+         wb_dirty_ns[b] = event_time_ns;
+     if (state != BC_DIRTY && state != BC_WRITING) {
+         p->dirty++;
+     } else if (wb_owner[b] != proc) {
+         // O bloco passa a ser do último a escrevê-lo (e do seu FSYNC)
+         pcb_table[wb_owner[b]].dirty--;
+         p->dirty++;
+         wb_wake();
+     }
+     wb_owner[b] = proc;
+     bc_mark_dirty(&bcache, b);
+     stats.writes_buffered++;
+     if (wb_urgent())
+         wb_pending = 1;
+ 
+     if (p->dirty > wb_proc_limit) {
+         p->wb_wait = 'W';
+         stats.writes_throttled++;
+         wb_pending = 1;
+         return 0;
+     }
+ 
+     stats.writes++;
+     printf("KERNEL: WRITE do bloco %u de A%d (PID %d) adiada no cache (%d buffers sujos)\n",
+            block, proc, p->pid, bcache.dirty);
+     fflush(stdout);
+     cache_complete(proc, 'W');
+     disk_start_next();
+     return 1;
+ }
+ 
+ /*******************************************************************************
+  * cache_fsync - Syscall FSYNC: espera a gravação dos blocos sujos do processo
+  *
+  * Retorna:
+  *   1 se não há blocos sujos (concluída na hora), 0 se o processo deve
+  *   bloquear até os lotes de escrita gravarem os seus blocos (wb_wait = 'Y')
+  ******************************************************************************/
+ int cache_fsync(KernelEvent *ev) {
+     int proc = ev->proc;
+     PCB *p = &pcb_table[proc];
+ 
+     stats.fsyncs++;
+     if (p->dirty == 0) {
+         printf("KERNEL: FSYNC de A%d (PID %d) sem blocos sujos\n", proc, p->pid);
+         fflush(stdout);
+         cache_complete(proc, 'Y');
+         return 1;
+     }
+     p->wb_wait = 'Y';
+     stats.fsync_waits++;
+     wb_pending = 1;
+     return 0;
+ }
+ 
+ /*******************************************************************************
+  * wb_start_flush - Inicia um lote de escrita no disco (que deve estar livre)
+  *
+  * Retorna:
+  *   1 se o lote foi iniciado, 0 se não há blocos sujos a gravar
+  ******************************************************************************/
+ int wb_start_flush() {
+     wb_pending = 0;
+     if (!wb_owner)
+         return 0;
+     wb_batch_count = bc_flush_batch(&bcache, &wb_cursor, wb_batch, WB_BATCH_MAX);
+     if (wb_batch_count == 0)
+         return 0;
+ 
+     io_in_progress = 1;
+     io_current = IO_FLUSH;
+     wb_request = ++io_request_seq;
+     stats.wb_flushes++;
+     stats.wb_blocks_flushed += wb_batch_count;
+     printf("KERNEL: Iniciando lote de escrita: %d blocos a partir do bloco %u (%d buffers sujos)\n",
+            wb_batch_count, bcache.block[wb_batch[0]], bcache.dirty);
+     fflush(stdout);
+     trace_add(TR_IO_START, -1, wb_batch_count, wb_request, 'F');
+     request_io();
+     return 1;
+ }
+ 
+ /*******************************************************************************
+  * wb_flush_done - O lote de escrita em andamento terminou (IRQ1)
+  *
+  * Os buffers não escritos de novo durante o lote ficam limpos; os processos
+  * que esperavam são desbloqueados, e outro lote é pedido se ainda há espera
+  * ou buffers sujos demais.
+  ******************************************************************************/
+ void wb_flush_done() {
+     for (int k = 0; k < wb_batch_count; k++) {
+         int b = wb_batch[k];
+         if (bc_clean(&bcache, b))
+             pcb_table[wb_owner[b]].dirty--;
+     }
+     wb_batch_count = 0;
+     wb_wake();
+     if (wb_urgent())
+         wb_pending = 1;
+ }
+ 
+ /*******************************************************************************
+  * wb_tick - Verificação periódica dos blocos sujos (IRQ0)
+  *
+  * Pede um lote se algum bloco está sujo há mais de wb_expire_ms.
+  ******************************************************************************/
+ void wb_tick() {
+     long long expire_ns = config.wb_expire_ms * 1000000LL;
+ 
+     if (!wb_owner || bcache.dirty == 0)
+         return;
+     for (int b = 0; b < bcache.nbufs; b++) {
+         if (bcache.state[b] == BC_DIRTY && event_time_ns - wb_dirty_ns[b] >= expire_ns) {
+             wb_pending = 1;
+             break;
+         }
+     }
+     disk_start_next();
+ }
+ 
+ /*******************************************************************************
+  * LEITURA ANTECIPADA
+  *
+  * Com -A, o kernel acompanha os blocos das READs de cada processo (a partir
+  * do cache_read, em acertos e faltas). Um READ do bloco seguinte ao último
+  * lido continua a sequência do processo:
+  *   - No segundo READ seguido, a sequência começa com janela RA_MIN_WINDOW
+  *   - Sempre que restam menos de meia janela de blocos já pedidos à frente
+  *     do processo, os próximos 'janela' blocos são pedidos e a janela
+  *     dobra, até config.ra_max
+  *   - Um READ fora da sequência a cancela: a janela volta a 0 e a leitura
+  *     antecipada que ainda não foi ao disco é descartada (a que já está no
+  *     disco termina, e os blocos que ninguém ler contam como desperdício)
+  *
+  * Como cada operação do disco custa o mesmo tempo, qualquer que seja o
+  * número de blocos, a janela é lida em uma única operação:
+  *   - Se o READ que pediu a janela foi uma falta, a janela vai junto com a
+  *     leitura do próprio processo, na mesma operação (síncrona)
+  *   - Se foi um acerto, a janela entra na fila do disco como uma operação
+  *     do kernel (assíncrona), atendida na ordem de chegada junto com os
+  *     processos da fila de bloqueados (pelo número do pedido)
+  * Os buffers são reservados no início da operação, pulando os blocos que
+  * já estão no cache, e ficam marcados em ra_unused até o primeiro READ. Um
+  * READ de um bloco antecipado ainda em leitura aguarda a operação, como
+  * qualquer leitura em andamento.
+  ******************************************************************************/
+ int ra_batch[RA_MAX_WINDOW];    // Buffers antecipados da operação em andamento
+ int ra_batch_count = 0;
+ long ra_request = 0;            // Número do pedido da leitura antecipada em andamento
+ 
+ /*******************************************************************************
+  * ra_cancel - Encerra a sequência do processo e descarta a janela pendente
+  ******************************************************************************/
+ void ra_cancel(PCB *p) {
+     stats.ra_cancels++;
+     stats.ra_cancelled_blocks += p->ra_pend_count;
+     p->ra_pend_count = 0;
+     p->ra_window = 0;
+ }
+ 
+ /*******************************************************************************
+  * ra_observe - Acompanha o READ de 'block' pelo processo 'proc'
+  *
+  * Detecta a sequência e, se preciso, deixa pendente a próxima janela.
+  *
+  * Parâmetros:
+  *   async - 1 se o READ não vai ao disco (acerto ou espera de uma leitura
+  *           em andamento): a janela será uma operação própria
+  ******************************************************************************/
+ void ra_observe(int proc, uint32_t block, int async) {
+     PCB *p = &pcb_table[proc];
+ 
+     if (block != p->ra_next) {
+         if (p->ra_window > 0) {
+             printf("KERNEL: READ fora da sequencia de A%d (bloco %u): leitura antecipada cancelada\n",
+                    proc, block);
+             fflush(stdout);
+             ra_cancel(p);
+         }
+         p->ra_next = block + 1;
+         return;
+     }
+ 
+     p->ra_next = block + 1;
+     if (p->ra_window == 0) {
+         p->ra_window = RA_MIN_WINDOW;
+         p->ra_end = block + 1;
+         stats.ra_streams++;
+     }
+     if (p->ra_end < block + 1)
+         p->ra_end = block + 1;          // O processo passou à frente da janela
+     if (p->ra_pend_count > 0 || (int)(p->ra_end - (block + 1)) >= p->ra_window / 2)
+         return;
+ 
+     p->ra_pend_start = p->ra_end;
+     p->ra_pend_count = p->ra_window;
+     p->ra_pend_seq = async ? ++io_request_seq : 0;
+     p->ra_end += p->ra_window;
+     if (p->ra_window < config.ra_max)
+         p->ra_window = p->ra_window * 2 < config.ra_max ? p->ra_window * 2 : config.ra_max;
+ }
+ 
+ /*******************************************************************************
+  * ra_reserve - Reserva os buffers da janela pendente do processo em ra_batch
+  *
+  * Retorna:
+  *   Número de blocos a ler (0 se todos já estão no cache)
+  ******************************************************************************/
+ int ra_reserve(PCB *p) {
+     ra_batch_count = 0;
+     for (int n = 0; n < p->ra_pend_count; n++) {
+         uint32_t block = p->ra_pend_start + n;
+         if (bc_lookup(&bcache, block) >= 0)
+             continue;
+         int b = cache_alloc(block);
+         if (b < 0)
+             break;
+         ra_unused[b] = 1;
+         ra_batch[ra_batch_count++] = b;
+     }
+     p->ra_pend_count = 0;
+     stats.ra_blocks += ra_batch_count;
+     return ra_batch_count;
+ }
+ 
+ /*******************************************************************************
+  * ra_attach - A leitura do processo 'i' vai começar: leva junto a janela
+  * pendente da sequência, se houver (leitura antecipada síncrona)
+  ******************************************************************************/
+ void ra_attach(int i) {
+     PCB *p = &pcb_table[i];
+ 
+     if (!ra_unused || p->ra_pend_count == 0 || p->ra_pend_seq != 0)
+         return;
+     if (ra_reserve(p) == 0)
+         return;
+     stats.ra_merged += ra_batch_count;
+     printf("KERNEL: Leitura de A%d leva %d blocos antecipados a partir do bloco %u\n",
+            i, ra_batch_count, bcache.block[ra_batch[0]]);
+     fflush(stdout);
+ }
+ 
+ /*******************************************************************************
+  * ra_oldest - Processo com a janela assíncrona pendente mais antiga (-1)
+  ******************************************************************************/
+ int ra_oldest() {
+     int oldest = -1;
+ 
+     if (!ra_unused)
+         return -1;
+     for (int i = 0; i < num_apps; i++) {
+         PCB *p = &pcb_table[i];
+         if (p->ra_pend_count > 0 && p->ra_pend_seq != 0 &&
+             (oldest < 0 || p->ra_pend_seq < pcb_table[oldest].ra_pend_seq))
+             oldest = i;
+     }
+     return oldest;
+ }
+ 
+ /*******************************************************************************
+  * ra_start_prefetch - Inicia a leitura assíncrona da janela do processo 'i'
+  *
+  * Retorna:
+  *   1 se a leitura foi iniciada, 0 se os blocos já estão todos no cache
+  ******************************************************************************/
+ int ra_start_prefetch(int i) {
+     PCB *p = &pcb_table[i];
+     long seq = p->ra_pend_seq;
+ 
+     if (ra_reserve(p) == 0)
+         return 0;
+     io_in_progress = 1;
+     io_current = IO_PREFETCH;
+     ra_request = seq;
+     stats.ra_requests++;
+     printf("KERNEL: Leitura antecipada para A%d: %d blocos a partir do bloco %u\n",
+            i, ra_batch_count, bcache.block[ra_batch[0]]);
+     fflush(stdout);
+     trace_add(TR_IO_START, -1, ra_batch_count, ra_request, 'A');
+     request_io();
+     return 1;
+ }
+ 
+ /*******************************************************************************
+  * ra_done - A operação com blocos antecipados terminou (IRQ1)
+  *
+  * Os buffers antecipados passam a ser válidos e os processos que aguardavam
+  * algum deles são desbloqueados.
+  ******************************************************************************/
+ void ra_done() {
+     for (int k = 0; k < ra_batch_count; k++) {
+         bc_fill(&bcache, ra_batch[k]);
+         cache_wake_joiners(ra_batch[k], "leitura antecipada");
+     }
+     ra_batch_count = 0;
+ }
+ 
+ /*******************************************************************************
+  * disk_start_next - Inicia a próxima operação do disco, se ele está livre
+  *
+  * Ordem: um lote de escrita urgente; depois, na ordem dos números de
+  * pedido, o primeiro processo da fila de bloqueados ou a leitura antecipada
+  * assíncrona mais antiga; por fim, um lote de escrita pedido sem urgência
+  * (wb_pending).
+  ******************************************************************************/
+ void disk_start_next() {
+     if (io_in_progress)
+         return;
+     if (wb_pending && wb_urgent() && wb_start_flush())
+         return;
+ 
+     for (int i; (i = ra_oldest()) >= 0; ) {
+         int head = blocked_head();
+         if (head >= 0 && pcb_table[head].io_request < pcb_table[i].ra_pend_seq)
+             break;
+         if (ra_start_prefetch(i))
+             return;
+     }
+ 
+     int next = dequeue_blocked();
+     if (next == -1) {
+         if (wb_pending)
+             wb_start_flush();
+         return;
+     }
+     ra_attach(next);
+     io_in_progress = 1;
+     pcb_table[next].io_pending = 1;
+     printf("KERNEL: Iniciando I/O de A%d (PID %d)\n", next, pcb_table[next].pid);
+     fflush(stdout);
+     io_current = next;
+     trace_add(TR_IO_START, next, 0, pcb_table[next].io_request,
+               pcb_table[next].syscall_param);
+     request_io();
+ }
+ 
+ /*******************************************************************************
+  * io_current_request - Número do pedido de I/O em atendimento no disco
+  ******************************************************************************/
+ long io_current_request() {
+     if (io_current == IO_FLUSH)
+         return wb_request;
+     if (io_current == IO_PREFETCH)
+         return ra_request;
+     return pcb_table[io_current].io_request;
+ }
+ 
+ /*******************************************************************************
+  * MEMÓRIA VIRTUAL
+  *
+  * Com -V, cada app tem um espaço de endereçamento paginado, descrito por uma
+  * PageTable (pagetable.h) em um memfd compartilhado com os apps, e faz
+  * referências à memória a cada instrução. As páginas ocupam quadros de uma
+  * memória física de config.vm_frames quadros, comum a todos os apps.
+  *
+  * Falta de página:
+  *   - O app entrega a falta pelo slot de syscall (operação 'F') e estaciona
+  *   - O kernel reserva um quadro livre ou, se não há, retira da memória a
+  *     página escolhida pela política de substituição (-P, pagerepl.h); os
+  *     quadros reservados para leituras em andamento não são candidatos
+  *   - O processo fica BLOCKED na fila do swap até a IRQ3 do dispositivo de
+  *     swap; só então a página é mapeada e ele volta para READY
+  *
+  * Tabela de quadros (frame_*): dono, página virtual e reserva de cada
+  * quadro, e uma pilha de quadros livres. Os metadados da substituição
+  * (bits de referência e de escrita, contadores, ordem) ficam em page_repl.
+  *
+  * Bits de referência: os apps marcam PTE_REF nas PTEs, como o hardware. A
+  * cada IRQ0 e antes de cada escolha de vítima, vm_harvest colhe esses bits
+  * para a máquina de substituição e os limpa; a tabela do dono tem o
+  * tlb_epoch incrementado, para que a próxima referência a cada página
+  * passe de novo pela tabela e volte a marcar o bit. O LRU do kernel é,
+  * portanto, exato apenas na resolução das colheitas; o benchmark
+  * bench/pagerepl alimenta a máquina com cada referência de um traço.
+  ******************************************************************************/
+ PageTable *page_tables = NULL;
+ int pt_fd = -1;
+ int *frame_owner = NULL;       // Processo dono do quadro (-1: livre)
+ uint32_t *frame_vpn = NULL;    // Página virtual guardada no quadro
+ uint8_t *frame_busy = NULL;    // 1 enquanto a página está sendo lida do swap
+ int *frame_free = NULL;        // Pilha de quadros livres
+ int frame_free_count = 0;
+ uint8_t *harvest_flush = NULL; // Tabelas com bits limpos na colheita atual
+ long swap_request_seq = 0;
+ 
+ /*******************************************************************************
+  * vm_create - Cria as tabelas de páginas e a tabela de quadros
+  *
+  * Ao vivo, as tabelas ficam em um memfd herdado pelos apps; no replay, em
+  * memória anônima, já que não há apps.
+  ******************************************************************************/
+ void vm_create() {
+     if (config.vm_pages == 0)
+         return;
+ 
+     size_t size = num_apps * sizeof(PageTable);
+     if (replay_mode) {
+         page_tables = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     } else {
+         pt_fd = memfd_create("trab1so-pagetables", 0);
+         if (pt_fd < 0 || ftruncate(pt_fd, size) < 0) {
+             perror("memfd_create");
+             exit(1);
+         }
+         page_tables = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pt_fd, 0);
+     }
+     if (page_tables == MAP_FAILED) {
+         perror("mmap");
+         exit(1);
+     }
+     for (int i = 0; i < num_apps; i++)
+         pt_init(&page_tables[i]);
+ 
+     frame_owner = malloc(config.vm_frames * sizeof(int));
+     frame_vpn = calloc(config.vm_frames, sizeof(uint32_t));
+     frame_busy = calloc(config.vm_frames, 1);
+     frame_free = malloc(config.vm_frames * sizeof(int));
+     harvest_flush = calloc(num_apps, 1);
+     void *repl_mem = malloc(pr_mem_size(config.vm_frames));
+     if (!frame_owner || !frame_vpn || !frame_busy || !frame_free || !harvest_flush || !repl_mem) {
+         perror("malloc");
+         exit(1);
+     }
+     // Os quadros livres saem da pilha em ordem crescente
+     for (int f = 0; f < config.vm_frames; f++) {
+         frame_owner[f] = -1;
+         frame_free[f] = config.vm_frames - 1 - f;
+     }
+     frame_free_count = config.vm_frames;
+     pr_init(&page_repl, pr_find(config.page_policy), config.vm_frames, repl_mem);
+     page_repl.tau = (uint64_t)WS_WINDOW_SLICES * config.quantum_ms;
+ }
+ 
+ /*******************************************************************************
+  * vm_harvest - Colhe os bits de referência e de escrita das PTEs
+  *
+  * Para cada quadro candidato, lê a PTE da página no dono. Um bit PTE_REF é
+  * limpo (and atômico, já que o app pode estar marcando PTE_DIRTY) e
+  * repassado com pr_access; PTE_DIRTY fica na PTE, para a contagem das
+  * retiradas, e é copiado para a máquina. Ao final, as tabelas que tiveram
+  * bits limpos recebem o shootdown (tlb_epoch e geração do bloco).
+  ******************************************************************************/
+ void vm_harvest() {
+     page_repl.now = (uint64_t)(event_time_ns / 1000000);
+     stats.ref_harvests++;
+     for (int w = 0; w < page_repl.words; w++) {
+         for (uint64_t m = page_repl.valid[w]; m; m &= m - 1) {
+             int f = w * 64 + __builtin_ctzll(m);
+             int owner = frame_owner[f];
+             volatile uint32_t *e = pt_entry(&page_tables[owner], frame_vpn[f]);
+             uint32_t pte = e ? __atomic_load_n(e, __ATOMIC_ACQUIRE) : 0;
+ 
+             if (pte & PTE_REF) {
+                 pte = __atomic_and_fetch(e, ~PTE_REF, __ATOMIC_ACQ_REL);
+                 pr_access(&page_repl, f, (pte & PTE_DIRTY) != 0);
+                 harvest_flush[owner] = 1;
+                 stats.ref_bits_cleared++;
+             } else if (pte & PTE_DIRTY) {
+                 pr_set(page_repl.dirty, f);
+             }
+         }
+     }
+     for (int i = 0; i < num_apps; i++) {
+         if (!harvest_flush[i])
+             continue;
+         harvest_flush[i] = 0;
+         __atomic_add_fetch(&page_tables[i].tlb_epoch, 1, __ATOMIC_RELEASE);
+         __atomic_add_fetch(&pcb_table[i].ctx->generation, 1, __ATOMIC_RELEASE);
+     }
+ }
+ 
+ /*******************************************************************************
+  * frame_take - Obtém um quadro para uma nova página
+  *
+  * Usa um quadro livre se houver; senão colhe os bits de referência e retira
+  * da memória a página do quadro escolhido pela política (no replay, o
+  * quadro gravado). A tradução do dono é desfeita, o que incrementa o
+  * tlb_epoch da sua tabela; a geração do seu bloco também é incrementada,
+  * para que ele esvazie a TLB na próxima instrução.
+  *
+  * Retorna:
+  *   Número do quadro, ou -1 se todos estão reservados para leituras em
+  *   andamento (impossível com mais quadros que processos)
+  ******************************************************************************/
+ int frame_take() {
+     if (frame_free_count > 0)
+         return frame_free[--frame_free_count];
+ 
+     vm_harvest();
+     long long t0 = now_ns();
+     int f = replay_mode ? replay_victim() : -1;
+     if (f < 0 || !pr_test(page_repl.valid, f))
+         f = pr_select(&page_repl);
+     stats.repl_select_ns += now_ns() - t0;
+     if (f < 0)
+         return -1;
+     record_victim(f);
+     pr_remove(&page_repl, f);
+ 
+     int owner = frame_owner[f];
+     uint32_t old = pt_unmap(&page_tables[owner], frame_vpn[f]);
+     stats.evictions++;
+     if (old & PTE_DIRTY)
+         stats.dirty_evictions++;
+     pcb_table[owner].resident--;
+     __atomic_add_fetch(&pcb_table[owner].ctx->generation, 1, __ATOMIC_RELEASE);
+     return f;
+ }
+ 
+ /*******************************************************************************
+  * frame_release - Devolve um quadro à pilha de livres
+  ******************************************************************************/
+ void frame_release(int f) {
+     pr_remove(&page_repl, f);
+     frame_owner[f] = -1;
+     frame_busy[f] = 0;
+     frame_free[frame_free_count++] = f;
+ }
+ 
+ /*******************************************************************************
+  * vm_release - Libera os quadros de um processo que terminou
+  *
+  * Um quadro reservado para uma leitura em andamento só é liberado quando a
+  * leitura termina (handle_swap_complete).
+  ******************************************************************************/
+ void vm_release(int i) {
+     if (!page_tables)
+         return;
+     for (int f = 0; f < config.vm_frames; f++)
+         if (frame_owner[f] == i && !frame_busy[f])
+             frame_release(f);
+     pcb_table[i].resident = 0;
+ }
+ 
+ /*******************************************************************************
+  * request_swap - Pede ao InterControllerSim a leitura da página de swap_current
+  *
+  * Como request_io, no dispositivo de swap: o número do pedido volta na IRQ3.
+  ******************************************************************************/
+ void request_swap() {
+     if (!replay_mode)
+         sig_send_retries += sig_send(controller_pid, SIG_SWAP_REQ,
+                                      (int)pcb_table[swap_current].swap_request);
+ }
+ 
+ /*******************************************************************************
+  * start_next_swap - Inicia a leitura do próximo processo da fila do swap
+  ******************************************************************************/
+ void start_next_swap() {
+     int next = dequeue_swap();
+     if (next < 0)
+         return;
+     swap_in_progress = 1;
+     swap_current = next;
+     request_swap();
+ }
+ 
+ /*******************************************************************************
+  * PROGRAMAÇÃO DO CLOCK
+  *
+  * O kernel programa o clock do InterControllerSim pelo bloco ClockControl
+  * ao final de cada evento, sinalizando o controlador só quando algo muda.
+  *
+  * Com -T (tickless) o controlador não gera IRQ0 por conta própria; o kernel
+  * pede
+  *   - IRQ0 periódica apenas quando há pelo menos dois processos executáveis
+  *     (READY ou RUNNING), ou seja, quando há preempção a fazer (um processo
+  *     READY com a CPU ociosa já é despachado no próprio evento)
+  *   - Uma IRQ0 avulsa no prazo do próximo temporizador do kernel (SLEEP)
+  * Um processo sozinho executa sem interrupções (exceto um de tempo real, que
+  * precisa da IRQ0 ao fim do seu orçamento) e, sem nenhum processo
+  * executável, o clock fica parado.
+  *
+  * Com apps de tempo real admitidos, a IRQ0 avulsa no próximo temporizador é
+  * pedida também no clock periódico, para que as ativações ocorram no
+  * instante exato e não no tick seguinte.
+  *
+  * Com a política arr, cada despacho escolhe o seu quantum
+  * (adaptive_quantum) e o time slice recomeça no instante do despacho.
+  ******************************************************************************/
+ ClockControl *clock_ctl = NULL;
+ int clock_fd = -1;
+ int clock_periodic = 1;            // Última programação enviada
+ long long clock_oneshot_ms = -1;   // Em ms de tempo de evento (-1 = nenhuma)
+ int clock_quantum_ms = 0;          // Quantum do último despacho (arr)
+ int clock_slice_restart = 0;       // 1 se houve despacho com quantum novo
+ 
+ /*******************************************************************************
+  * clock_create - Cria o bloco ClockControl repassado ao InterControllerSim
+  ******************************************************************************/
+ void clock_create() {
+     clock_fd = memfd_create("trab1so-clock", 0);
+     if (clock_fd < 0 || ftruncate(clock_fd, sizeof(ClockControl)) < 0) {
+         perror("memfd_create");
+         exit(1);
+     }
+     clock_ctl = mmap(NULL, sizeof(ClockControl), PROT_READ | PROT_WRITE, MAP_SHARED, clock_fd, 0);
+     if (clock_ctl == MAP_FAILED) {
+         perror("mmap");
+         exit(1);
+     }
+     clock_ctl->periodic = 1;
+     clock_ctl->oneshot_ns = 0;
+     clock_ctl->quantum_ms = config.quantum_ms;
+     clock_ctl->slice_seq = 0;
+ }
+ 
+ /*******************************************************************************
+  * runnable_count - Número de processos executáveis (READY ou RUNNING)
+  ******************************************************************************/
+ int runnable_count() {
+     int runnable = 0;
+     for (int i = 0; i < num_apps; i++)
+         if (!pcb_table[i].terminated &&
+             (pcb_table[i].state == READY || pcb_table[i].state == RUNNING))
+             runnable++;
+     return runnable;
+ }
+ 
+ /*******************************************************************************
+  * clock_program - Reprograma o clock de acordo com o estado atual
+  *
+  * A programação é calculada também no replay (sem controlador), para que a
+  * contagem de reprogramações seja a mesma da execução original.
+  ******************************************************************************/
+ void clock_program() {
+     int periodic = clock_periodic;
+     long long oneshot_ms = clock_oneshot_ms;
+ 
+     if (config.tickless || rt_admitted) {
+         uint64_t next = tw_next_expiry(&kernel_timers);
+         oneshot_ms = next == TW_NEVER ? -1 : (long long)next;
+     }
+     if (config.tickless)
+         periodic = runnable_count() >= 2 ||
+                    (!cpu_is_idle() && pcb_table[current_running].rt);
+ 
+     if (periodic == clock_periodic && oneshot_ms == clock_oneshot_ms && !clock_slice_restart)
+         return;
+     clock_periodic = periodic;
+     clock_oneshot_ms = oneshot_ms;
+     stats.clock_programs++;
+ 
+     if (replay_mode || !clock_ctl) {
+         clock_slice_restart = 0;
+         return;
+     }
+     clock_ctl->periodic = periodic;
+     clock_ctl->oneshot_ns = oneshot_ms < 0 ? 0 : start_ns + oneshot_ms * 1000000LL;
+     if (clock_slice_restart) {
+         clock_ctl->quantum_ms = clock_quantum_ms;
+         clock_ctl->slice_seq++;
+         clock_slice_restart = 0;
+     }
+     sig_send_retries += sig_send(controller_pid, SIG_CLOCK, 0);
+ }
+ 
+ /*******************************************************************************
+  * QUANTUM ADAPTATIVO
+  *
+  * Na política arr o quantum é calculado a cada despacho:
+  *   - Latência: ADAPT_LATENCY_SLICES quanta base divididos entre os processos
+  *     executáveis, de modo que a espera de um processo pronto fique limitada
+  *     mesmo com a fila cheia
+  *   - Uso da CPU: cada fatia usada até o fim em sequência aumenta o quantum
+  *     em 1/ADAPT_MAX_STREAK (até o dobro), reduzindo as trocas de processos
+  *     CPU-bound; uma syscall zera a sequência
+  *   - O resultado fica entre 1/4 e 2 vezes o quantum base (-q)
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * adaptive_quantum - Quantum do próximo despacho do processo i
+  ******************************************************************************/
+ int adaptive_quantum(int i) {
+     int base = config.quantum_ms;
+     int runnable = runnable_count();
+     int streak = pcb_table[i].full_slices < ADAPT_MAX_STREAK ?
+                  pcb_table[i].full_slices : ADAPT_MAX_STREAK;
+ 
+     int q = base * ADAPT_LATENCY_SLICES / (runnable > 0 ? runnable : 1);
+     q = q * (ADAPT_MAX_STREAK + streak) / ADAPT_MAX_STREAK;
+ 
+     int q_min = base / 4 > 0 ? base / 4 : 1;
+     if (q < q_min)
+         q = q_min;
+     if (q > 2 * base)
+         q = 2 * base;
+     return q;
+ }
+ 
+ /*******************************************************************************
+  * slice_used_up - Indica se o processo em execução usou toda a sua fatia
+  *
+  * Tolera 1 ms de diferença entre o relógio do controlador e o do kernel.
+  ******************************************************************************/
+ int slice_used_up(int i) {
+     return event_time_ns - pcb_table[i].dispatch_ns >= (pcb_table[i].slice_ms - 1) * 1000000LL;
+ }
+ 
+ /*******************************************************************************
+  * POLÍTICAS DE ESCALONAMENTO
+  *
+  * Cada política é uma tabela SchedPolicy escolhida por -p:
+  *   - rr:   fila FIFO de prontos e quantum fixo (-q)
+  *   - arr:  fila FIFO de prontos e quantum adaptativo
+  *   - prio: prioridades estáticas (nice) em filas O(1) por nível, com mapa de
+  *           bits e arrays ativo/expirado (prioarray.h). O processo pronto de
+  *           maior prioridade preempta o atual; quem esgota a fatia só volta
+  *           a executar depois que todos os do array ativo executaram, o que
+  *           impede a inanição dos de menor prioridade. O quantum cresce com a
+  *           prioridade, como no escalonador O(1) do Linux 2.6: para nice 0 é
+  *           o quantum base (-q), para nice -20 é 8 vezes maior e para nice
+  *           19 é 1/20
+  *   - edf:  apps de tempo real admitidos (ver TEMPO REAL) ficam em uma fila
+  *           de prazos em heap (dlheap.h), ordenada pelo prazo absoluto da
+  *           ativação atual (Earliest Deadline First); os demais são
+  *           atendidos em Round-Robin quando não há nenhum de tempo real
+  *           pronto
+  *   - rm:   como edf, mas a fila é ordenada pelo período (rate-monotonic:
+  *           prioridade fixa, maior para o menor período)
+  * Nas políticas de tempo real o quantum de um app admitido é o que resta do
+  * orçamento da ativação, de modo que a IRQ0 chega quando ele se esgota.
+  *   - lottery: a cada fim de fatia, sorteia um bilhete entre os do processo
+  *           atual e os dos prontos; os bilhetes dos prontos ficam em uma
+  *           árvore de Fenwick (fenwick.h), de modo que o sorteio é O(log n)
+  *   - stride: cada processo tem um passo STRIDE1/bilhetes e um passe, que
+  *           avança pelo passo a cada quantum de CPU usado (proporcionalmente,
+  *           se usou menos); executa o de menor passe, em um heap (dlheap.h).
+  *           Quem volta de um bloqueio recomeça do passe global, sem acumular
+  *           crédito
+  * Nas duas, um app bloqueado em I/O empresta os seus bilhetes a outro app
+  * executável do mesmo tenant (-J tenant=), para que o grupo mantenha a sua
+  * fração da CPU; o empréstimo é desfeito quando ele volta a ficar READY.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * fifo_pick - Próximo processo READY da fila FIFO (políticas rr e arr)
+  *
+  * A fila só contém processos READY: quem deixa de estar pronto sem ser
+  * escolhido sai dela por fifo_remove. O processo atual nunca é mantido: ao
+  * fim do quantum, ele cede a CPU ao próximo da fila.
+  ******************************************************************************/
+ int fifo_pick(int current) {
+     (void)current;
+     return dequeue_ready();
+ }
+ 
+ /*******************************************************************************
+  * fifo_empty - Verifica se há algum processo READY na fila FIFO
+  ******************************************************************************/
+ int fifo_empty() {
+     return ready_count == 0;
+ }
+ 
+ /*******************************************************************************
+  * fifo_remove - Retira o processo da fila de prontos, se estiver nela
+  *
+  * Compacta a fila mantendo a ordem dos demais. Só acontece no término de um
+  * processo ou em uma syscall de um processo recém-preemptado, nunca no
+  * caminho do despacho.
+  ******************************************************************************/
+ void fifo_remove(int i) {
+     int kept = 0;
+     for (int n = 0; n < ready_count; n++) {
+         int p = ready_queue[(ready_front + n) % MAX_PROCESSES];
+         if (p != i)
+             ready_queue[(ready_front + kept++) % MAX_PROCESSES] = p;
+     }
+     ready_count = kept;
+ }
+ 
+ /*******************************************************************************
+  * fixed_quantum - Quantum base (-q) em todos os despachos
+  ******************************************************************************/
+ int fixed_quantum(int i) {
+     (void)i;
+     return config.quantum_ms;
+ }
+ 
+ /*******************************************************************************
+  * prio_enqueue - Insere o processo no array ativo, ou no expirado se ele
+  *                esgotou a fatia do último despacho
+  ******************************************************************************/
+ void prio_enqueue(int i) {
+     prq_enqueue(&prio_rq, &pcb_table[i].prio_node, pcb_table[i].slice_expired);
+ }
+ 
+ /*******************************************************************************
+  * prio_pick - Processo pronto de maior prioridade, se ele deve assumir a CPU
+  *
+  * O processo atual continua enquanto a sua fatia não acabou e não há pronto
+  * de prioridade estritamente maior.
+  ******************************************************************************/
+ int prio_pick(int current) {
+     PrioNode *best = prq_peek(&prio_rq);
+     if (!best)
+         return -1;
+ 
+     if (current != -1 && pcb_table[current].state == RUNNING &&
+         !pcb_table[current].slice_expired &&
+         best->prio >= pcb_table[current].prio_node.prio)
+         return -1;
+ 
+     pa_remove(best);
+     return (int)(((char *)best - (char *)pcb_table - offsetof(PCB, prio_node)) / sizeof(PCB));
+ }
+ 
+ /*******************************************************************************
+  * prio_empty - Verifica se há algum processo READY nos arrays
+  ******************************************************************************/
+ int prio_empty() {
+     return prq_count(&prio_rq) == 0;
+ }
+ 
+ /*******************************************************************************
+  * prio_remove - Retira dos arrays um processo que terminou
+  ******************************************************************************/
+ void prio_remove(int i) {
+     pa_remove(&pcb_table[i].prio_node);
+ }
+ 
+ /*******************************************************************************
+  * prio_quantum - Quantum proporcional à prioridade estática
+  *
+  * Fórmula do escalonador O(1): (140 - prio) * base / 20, multiplicado por 4
+  * acima de nice 0. Com prioridade 120 (nice 0) o resultado é o quantum base.
+  ******************************************************************************/
+ int prio_quantum(int i) {
+     int p = pcb_table[i].prio_node.prio;
+     int q = config.quantum_ms * (PA_LEVELS - p) * (p < PRIO_NICE_0 ? 4 : 1) / 20;
+     return q > 0 ? q : 1;
+ }
+ 
+ /*******************************************************************************
+  * prio_preempts - Há processo READY de prioridade maior que a do atual
+  ******************************************************************************/
+ int prio_preempts(int current) {
+     PrioNode *best = pa_peek(prio_rq.active);
+     return best && best->prio < pcb_table[current].prio_node.prio;
+ }
+ 
+ 
+ /*******************************************************************************
+  * rt_key - Chave do processo na fila de prazos: prazo absoluto (edf) ou
+  *          período (rm)
+  ******************************************************************************/
+ long long rt_key(int i) {
+     return policy->rt == RT_EDF ? pcb_table[i].rt_deadline_ms : jobs[i].period_ms;
+ }
+ 
+ /*******************************************************************************
+  * rt_index - Índice do processo dono de um nó da fila de prazos
+  ******************************************************************************/
+ int rt_index(DlNode *n) {
+     return (int)(((char *)n - (char *)pcb_table - offsetof(PCB, rt_node)) / sizeof(PCB));
+ }
+ 
+ /*******************************************************************************
+  * rt_enqueue - Apps de tempo real vão para a fila de prazos; os demais, para
+  *              a fila FIFO
+  ******************************************************************************/
+ void rt_enqueue(int i) {
+     if (pcb_table[i].rt)
+         dl_insert(&rt_heap, &pcb_table[i].rt_node, rt_key(i));
+     else
+         enqueue_ready(i);
+ }
+ 
+ /*******************************************************************************
+  * rt_pick - App de tempo real de menor chave ou, sem nenhum, o próximo da
+  *           fila FIFO
+  *
+  * Um app de tempo real em execução continua enquanto nenhum pronto tiver
+  * chave estritamente menor.
+  ******************************************************************************/
+ int rt_pick(int current) {
+     DlNode *best = dl_peek(&rt_heap);
+ 
+     if (current != -1 && pcb_table[current].state == RUNNING && pcb_table[current].rt &&
+         (!best || rt_key(current) <= best->key))
+         return -1;
+     if (best) {
+         dl_remove(&rt_heap, best);
+         return rt_index(best);
+     }
+     return fifo_pick(current);
+ }
+ 
+ /*******************************************************************************
+  * rt_empty - Verifica se há algum processo READY em uma das duas filas
+  ******************************************************************************/
+ int rt_empty() {
+     return rt_heap.size == 0 && fifo_empty();
+ }
+ 
+ /*******************************************************************************
+  * rt_remove - Retira da fila de prazos um processo que terminou e cancela a
+  *             sua próxima ativação
+  ******************************************************************************/
+ void rt_remove(int i) {
+     dl_remove(&rt_heap, &pcb_table[i].rt_node);
+     tw_cancel(&kernel_timers, &pcb_table[i].rt_timer);
+ }
+ 
+ /*******************************************************************************
+  * rt_quantum - Orçamento restante da ativação (tempo real) ou quantum base
+  ******************************************************************************/
+ int rt_quantum(int i) {
+     PCB *p = &pcb_table[i];
+     if (!p->rt)
+         return config.quantum_ms;
+ 
+     long long left_ns = jobs[i].runtime_ms * 1000000LL - (p->state_ns[RUNNING] - p->rt_cpu_start_ns);
+     int q = (int)((left_ns + 999999) / 1000000);
+     return q > 0 ? q : 1;
+ }
+ 
+ /*******************************************************************************
+  * rt_preempts - Há app de tempo real pronto com chave menor que a do atual
+  *               (ou qualquer um, se o atual não é de tempo real)
+  ******************************************************************************/
+ int rt_preempts(int current) {
+     DlNode *best = dl_peek(&rt_heap);
+     return best && (!pcb_table[current].rt || best->key < rt_key(current));
+ }
+ 
+ /*******************************************************************************
+  * cpu_ns - Tempo em RUNNING do processo até o evento atual
+  ******************************************************************************/
+ long long cpu_ns(int i) {
+     PCB *p = &pcb_table[i];
+     return p->state_ns[RUNNING] + (p->state == RUNNING ? event_time_ns - p->state_since_ns : 0);
+ }
+ 
+ /*******************************************************************************
+  * lottery_sync - Ajusta o peso do processo na árvore aos seus bilhetes
+  *                efetivos (zero se não está READY)
+  *
+  * A árvore só é inicializada na política lottery; nas demais, nada a fazer.
+  ******************************************************************************/
+ void lottery_sync(int i) {
+     PCB *p = &pcb_table[i];
+     long weight = p->state == READY && !p->terminated ? p->eff_tickets : 0;
+     if (lottery_tree.tree && weight != p->lot_weight) {
+         fw_add(&lottery_tree, i, weight - p->lot_weight);
+         p->lot_weight = weight;
+     }
+ }
+ 
+ /*******************************************************************************
+  * ticket_revoke - Desfaz o empréstimo de bilhetes feito pelo processo i
+  ******************************************************************************/
+ void ticket_revoke(int i) {
+     int b = pcb_table[i].lent_to;
+     if (b < 0)
+         return;
+     pcb_table[b].eff_tickets -= pcb_table[i].tickets;
+     pcb_table[i].lent_to = -1;
+     lottery_sync(b);
+ }
+ 
+ /*******************************************************************************
+  * ticket_block - O processo bloqueou em I/O: empresta os seus bilhetes ao
+  *                primeiro app executável do mesmo tenant
+  ******************************************************************************/
+ void ticket_block(int i) {
+     int tenant = jobs[i].tenant;
+     if (tenant < 0)
+         return;
+ 
+     for (int b = 0; b < num_apps; b++) {
+         PCB *p = &pcb_table[b];
+         if (b == i || p->terminated || jobs[b].tenant != tenant ||
+             (p->state != READY && p->state != RUNNING))
+             continue;
+         p->eff_tickets += pcb_table[i].tickets;
+         pcb_table[i].lent_to = b;
+         lottery_sync(b);
+         ticket_transfers++;
+         printf("KERNEL: A%d bloqueado em I/O transfere %d bilhetes para A%d\n",
+                i, pcb_table[i].tickets, b);
+         fflush(stdout);
+         return;
+     }
+ }
+ 
+ /*******************************************************************************
+  * ticket_remove - O processo terminou: desfaz os empréstimos feitos por ele
+  *                 e os recebidos de outros
+  ******************************************************************************/
+ void ticket_remove(int i) {
+     ticket_revoke(i);
+     for (int j = 0; j < num_apps; j++)
+         if (pcb_table[j].lent_to == i)
+             ticket_revoke(j);
+ }
+ 
+ /*******************************************************************************
+  * lottery_enqueue - Os bilhetes do processo passam a concorrer
+  ******************************************************************************/
+ void lottery_enqueue(int i) {
+     ticket_revoke(i);
+     lottery_sync(i);
+ }
+ 
+ /*******************************************************************************
+  * lottery_pick - Sorteia o próximo processo
+  *
+  * O processo atual continua até o fim da sua fatia; então concorre com os
+  * seus bilhetes junto com os prontos.
+  ******************************************************************************/
+ int lottery_pick(int current) {
+     long current_tickets = 0;
+     if (current != -1 && pcb_table[current].state == RUNNING) {
+         if (!pcb_table[current].slice_expired)
+             return -1;
+         current_tickets = pcb_table[current].eff_tickets;
+     }
+     if (lottery_tree.total == 0)
+         return -1;
+ 
+     lottery_rng ^= lottery_rng << 13;
+     lottery_rng ^= lottery_rng >> 7;
+     lottery_rng ^= lottery_rng << 17;
+     lottery_draws++;
+     long r = (long)(lottery_rng % (uint64_t)(lottery_tree.total + current_tickets));
+     if (r >= lottery_tree.total)
+         return -1;
+ 
+     int winner = fw_find(&lottery_tree, r);
+     fw_add(&lottery_tree, winner, -pcb_table[winner].lot_weight);
+     pcb_table[winner].lot_weight = 0;
+     return winner;
+ }
+ 
+ /*******************************************************************************
+  * lottery_empty - Verifica se há bilhetes de processos READY
+  ******************************************************************************/
+ int lottery_empty() {
+     return lottery_tree.total == 0;
+ }
+ 
+ /*******************************************************************************
+  * lottery_remove - Retira os bilhetes de um processo que terminou
+  ******************************************************************************/
+ void lottery_remove(int i) {
+     ticket_remove(i);
+     lottery_sync(i);
+ }
+ 
+ /*******************************************************************************
+  * stride_charge - Passe do processo com o tempo de CPU ainda não cobrado
+  *
+  * Multiplica antes de dividir, para que o passo de contagens grandes de
+  * bilhetes não seja truncado; o tempo vai em microssegundos, de modo que
+  * STRIDE1 * tempo só estoura com horas de CPU não cobrada.
+  ******************************************************************************/
+ long long stride_charge(int i) {
+     PCB *p = &pcb_table[i];
+     long long used_us = (cpu_ns(i) - p->stride_cpu_ns) / 1000;
+     return p->stride_pass + STRIDE1 * used_us / ((long long)p->eff_tickets * config.quantum_ms * 1000);
+ }
+ 
+ /*******************************************************************************
+  * stride_enqueue - Cobra a CPU usada e insere o processo pelo seu passe
+  ******************************************************************************/
+ void stride_enqueue(int i) {
+     PCB *p = &pcb_table[i];
+     ticket_revoke(i);
+     p->stride_pass = stride_charge(i);
+     p->stride_cpu_ns = cpu_ns(i);
+     if (p->stride_pass < stride_global_pass)
+         p->stride_pass = stride_global_pass;
+     dl_insert(&stride_heap, &p->stride_node, p->stride_pass);
+ }
+ 
+ /*******************************************************************************
+  * stride_pick - Processo de menor passe
+  *
+  * O processo atual continua até o fim da sua fatia e, depois dela, enquanto
+  * o seu passe (já com a fatia cobrada) não for maior que o menor dos prontos.
+  ******************************************************************************/
+ int stride_pick(int current) {
+     DlNode *best = dl_peek(&stride_heap);
+ 
+     if (current != -1 && pcb_table[current].state == RUNNING &&
+         (!pcb_table[current].slice_expired || !best || stride_charge(current) <= best->key))
+         return -1;
+     if (!best)
+         return -1;
+ 
+     dl_remove(&stride_heap, best);
+     stride_global_pass = best->key;
+     return (int)(((char *)best - (char *)pcb_table - offsetof(PCB, stride_node)) / sizeof(PCB));
+ }
+ 
+ /*******************************************************************************
+  * stride_empty - Verifica se há algum processo no heap de passes
+  ******************************************************************************/
+ int stride_empty() {
+     return stride_heap.size == 0;
+ }
+ 
+ /*******************************************************************************
+  * stride_remove - Retira do heap um processo que terminou
+  ******************************************************************************/
+ void stride_remove(int i) {
+     ticket_remove(i);
+     dl_remove(&stride_heap, &pcb_table[i].stride_node);
+ }
+ 
+ SchedPolicy sched_policies[] = {
+     { "rr",      enqueue_ready,   fifo_pick,    fifo_empty,    fifo_remove,    fixed_quantum,
+                  NULL,          NULL,         0, 0 },
+     { "arr",     enqueue_ready,   fifo_pick,    fifo_empty,    fifo_remove,    adaptive_quantum,
+                  NULL,          NULL,         1, 0 },
+     { "prio",    prio_enqueue,    prio_pick,    prio_empty,    prio_remove,    prio_quantum,
+                  prio_preempts, NULL,         1, 0 },
+     { "edf",     rt_enqueue,      rt_pick,      rt_empty,      rt_remove,      rt_quantum,
+                  rt_preempts,   NULL,         1, RT_EDF },
+     { "rm",      rt_enqueue,      rt_pick,      rt_empty,      rt_remove,      rt_quantum,
+                  rt_preempts,   NULL,         1, RT_RM },
+     { "lottery", lottery_enqueue, lottery_pick, lottery_empty, lottery_remove, fixed_quantum,
+                  NULL,          ticket_block, 1, 0 },
+     { "stride",  stride_enqueue,  stride_pick,  stride_empty,  stride_remove,  fixed_quantum,
+                  NULL,          ticket_block, 1, 0 },
+ };
+ 
+ /*******************************************************************************
+  * find_policy - Tabela da política de nome 'name' (NULL se desconhecida)
+  ******************************************************************************/
+ SchedPolicy *find_policy(const char *name) {
+     for (size_t p = 0; p < sizeof(sched_policies) / sizeof(sched_policies[0]); p++)
+         if (strcmp(sched_policies[p].name, name) == 0)
+             return &sched_policies[p];
+     return NULL;
+ }
+ 
+ /*******************************************************************************
+  * TEMPO REAL
+  *
+  * Um app de tempo real é periódico: a cada período_ms ele é ativado e tem
+  * direito a runtime_ms de CPU, que devem ser usados até o prazo relativo
+  * deadline_ms. O kernel mede o tempo de CPU de cada ativação; quando o
+  * orçamento se esgota (IRQ0 ao fim do quantum), a ativação está concluída
+  * e o app espera em SLEEPING pela próxima, agendada na roda do kernel. Uma
+  * ativação concluída depois do próximo período faz a seguinte começar de
+  * imediato.
+  *
+  * Controle de admissão, na ordem dos jobs, pela densidade runtime/min(prazo,
+  * período) (igual à utilização quando prazo = período):
+  *   - edf: soma das densidades <= 1
+  *   - rm:  soma das densidades <= n(2^(1/n) - 1) (limite de Liu e Layland)
+  * Um app rejeitado é executado como melhor esforço, sem garantia.
+  *
+  * O atraso de cada ativação (conclusão - prazo) alimenta o histograma
+  * rt_lateness_hist; atraso positivo é um prazo perdido.
+  ******************************************************************************/
+ 
+ /* n(2^(1/n) - 1) para n = 0..MAX_PROCESSES */
+ static const double rm_bounds[MAX_PROCESSES + 1] = {
+     1.0, 1.0, 0.828427, 0.779763, 0.756828, 0.743492, 0.734772
+ };
+ 
+ /*******************************************************************************
+  * rt_admission - Decide quais jobs de tempo real são admitidos
+  ******************************************************************************/
+ void rt_admission(int n) {
+     int periodic = 0;
+     for (int i = 0; i < n; i++)
+         periodic += jobs[i].period_ms > 0;
+     if (!periodic)
+         return;
+     if (!policy->rt) {
+         printf("KERNEL: Parametros de tempo real ignorados pela politica %s\n", policy->name);
+         return;
+     }
+ 
+     rt_utilization = 0.0;
+     for (int i = 0; i < n; i++) {
+         JobSpec *job = &jobs[i];
+         if (job->period_ms <= 0)
+             continue;
+ 
+         double density = (double)job->runtime_ms / job->deadline_ms;
+         double bound = policy->rt == RT_EDF ? 1.0 : rm_bounds[rt_admitted + 1];
+         if (rt_utilization + density <= bound + 1e-9) {
+             job->admitted = 1;
+             rt_admitted++;
+             rt_utilization += density;
+             rt_bound = bound;
+             printf("KERNEL: A%d admitido em tempo real (periodo %d ms, execucao %d ms, prazo %d ms)\n",
+                    i, job->period_ms, job->runtime_ms, job->deadline_ms);
+         } else {
+             rt_rejected++;
+             printf("KERNEL: A%d rejeitado pelo controle de admissao (utilizacao %.3f > limite %.3f), "
+                    "executa como melhor esforco\n", i, rt_utilization + density, bound);
+         }
+     }
+     if (!rt_admitted)
+         rt_bound = policy->rt == RT_EDF ? 1.0 : rm_bounds[1];
+     fflush(stdout);
+ }
+ 
+ /*******************************************************************************
+  * rt_start_job - Inicia uma ativação do processo i no instante release_ms
+  ******************************************************************************/
+ void rt_start_job(int i, long long release_ms) {
+     PCB *p = &pcb_table[i];
+     account_state(i);
+     p->rt_release_ms = release_ms;
+     p->rt_deadline_ms = release_ms + jobs[i].deadline_ms;
+     p->rt_cpu_start_ns = p->state_ns[RUNNING];
+ }
+ 
+ /*******************************************************************************
+  * rt_record_job - Contabiliza a ativação atual, concluída neste evento
+  ******************************************************************************/
+ void rt_record_job(int i) {
+     PCB *p = &pcb_table[i];
+     long long late_ns = event_time_ns - p->rt_deadline_ms * 1000000LL;
+ 
+     if (p->rt_jobs == 0 || late_ns > p->rt_max_late_ns)
+         p->rt_max_late_ns = late_ns;
+     p->rt_jobs++;
+ 
+     int b = 0;
+     if (late_ns > 0) {
+         long long late_ms = (late_ns + 999999) / 1000000;
+         p->rt_misses++;
+         for (b = 1; b < RT_HIST_BUCKETS - 1 && late_ms > (1LL << (b - 1)); b++)
+             ;
+         printf("KERNEL: A%d perdeu o prazo da ativacao %ld por %.3f ms\n",
+                i, p->rt_jobs, late_ns / 1e6);
+         fflush(stdout);
+     }
+     rt_lateness_hist[b]++;
+ }
+ 
+ /*******************************************************************************
+  * rt_release_expired - Callback da roda: início da próxima ativação
+  ******************************************************************************/
+ void rt_release_expired(Timer *t) {
+     int i = (int)((PCB *)t->data - pcb_table);
+ 
+     rt_start_job(i, (long long)t->expires);
+     printf("KERNEL: Ativacao de A%d (PID %d), prazo em %lld ms\n",
+            i, pcb_table[i].pid, pcb_table[i].rt_deadline_ms);
+     fflush(stdout);
+     set_state(i, READY);
+ }
+ 
+ /*******************************************************************************
+  * rt_check_budget - Encerra a ativação do processo em execução se ele já
+  *                   usou todo o seu orçamento
+  *
+  * Tolera 1 ms de diferença entre os relógios, como slice_used_up.
+  ******************************************************************************/
+ void rt_check_budget(int i) {
+     PCB *p = &pcb_table[i];
+     account_state(i);
+     if (p->state_ns[RUNNING] - p->rt_cpu_start_ns < (jobs[i].runtime_ms - 1) * 1000000LL)
+         return;
+ 
+     rt_record_job(i);
+     long long next_ms = p->rt_release_ms + jobs[i].period_ms;
+     if (next_ms * 1000000LL <= event_time_ns) {
+         // Ativação atrasada: a próxima já começou
+         rt_start_job(i, event_time_ns / 1000000);
+         return;
+     }
+ 
+     printf("KERNEL: A%d concluiu a ativacao, aguardando a proxima em %lld ms\n", i, next_ms);
+     fflush(stdout);
+     stop_app(i);
+     set_state(i, SLEEPING);
+     tw_add(&kernel_timers, &p->rt_timer, (uint64_t)next_ms);
+ }
+ 
+ /*******************************************************************************
+  * FRAÇÃO DA CPU
+  *
+  * A cada SHARE_SAMPLE_MS de tempo de evento (na primeira IRQ0 depois do
+  * prazo), enquanto nenhum app terminou, compara a fração acumulada da CPU
+  * de cada app com a sua fração alvo, bilhetes / total de bilhetes. O maior
+  * erro absoluto de cada amostra mostra a convergência da política.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * share_sample - Registra uma amostra se o prazo da próxima já passou
+  ******************************************************************************/
+ void share_sample() {
+     if (event_time_ns / 1000000 < share_next_ms || finished_processes > 0 ||
+         share_count == SHARE_MAX_SAMPLES)
+         return;
+     share_next_ms = event_time_ns / 1000000 / SHARE_SAMPLE_MS * SHARE_SAMPLE_MS + SHARE_SAMPLE_MS;
+ 
+     long long total_ns = 0;
+     long total_tickets = 0;
+     for (int i = 0; i < num_apps; i++) {
+         total_ns += cpu_ns(i);
+         total_tickets += pcb_table[i].tickets;
+     }
+     if (total_ns == 0)
+         return;
+ 
+     double err = 0.0;
+     for (int i = 0; i < num_apps; i++) {
+         share_achieved[i] = (double)cpu_ns(i) / total_ns;
+         double diff = share_achieved[i] - (double)pcb_table[i].tickets / total_tickets;
+         if (diff < 0)
+             diff = -diff;
+         if (diff > err)
+             err = diff;
+     }
+     share_at_ms[share_count] = event_time_ns / 1000000;
+     share_err[share_count++] = err;
+ }
+ 
+ /*******************************************************************************
+  * JOBS
+  *
+  * A carga e o nice de cada app vêm de -m e -n (listas repetidas
+  * ciclicamente) ou de um arquivo de jobs (-J), com um app por linha:
+  *
+  *     # comentário
+  *     load=c nice=-5
+  *     load=i nice=10
+  *     load=c period=200 runtime=40 deadline=150
+  *     load=i tickets=300 tenant=1
+  *
+  * Campos omitidos ficam com o padrão (load=c, nice=0, sem tempo real, 100
+  * bilhetes, sem tenant; o prazo padrão é o período). Com -J o número de apps é o número de linhas
+  * de job, e o argumento <num_apps>, se dado, deve coincidir.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * job_defaults - Preenche um job com os valores dos campos omitidos
+  ******************************************************************************/
+ void job_defaults(JobSpec *job) {
+     memset(job, 0, sizeof(*job));
+     job->load = 'c';
+     job->tickets = DEFAULT_TICKETS;
+     job->tenant = -1;
+ }
+ 
+ /*******************************************************************************
+  * parse_job_field - Aplica um campo chave=valor a um job
+  *
+  * Retorna:
+  *   0 em caso de sucesso, -1 se a chave ou o valor forem inválidos
+  ******************************************************************************/
+ int parse_job_field(JobSpec *job, const char *field) {
+     char *end;
+     if (strncmp(field, "load=", 5) == 0) {
+         if (strlen(field + 5) != 1 || !strchr("ciswq", field[5]))
+             return -1;
+         job->load = field[5];
+     } else if (strncmp(field, "nice=", 5) == 0) {
+         long nice = strtol(field + 5, &end, 10);
+         if (end == field + 5 || *end != '\0' || nice < NICE_MIN || nice > NICE_MAX)
+             return -1;
+         job->nice = (int)nice;
+     } else if (strncmp(field, "period=", 7) == 0) {
+         job->period_ms = atoi(field + 7);
+     } else if (strncmp(field, "runtime=", 8) == 0) {
+         job->runtime_ms = atoi(field + 8);
+     } else if (strncmp(field, "deadline=", 9) == 0) {
+         job->deadline_ms = atoi(field + 9);
+     } else if (strncmp(field, "tickets=", 8) == 0) {
+         long tickets = strtol(field + 8, &end, 10);
+         if (end == field + 8 || *end != '\0' || tickets < 1 || tickets > MAX_TICKETS)
+             return -1;
+         job->tickets = (int)tickets;
+     } else if (strncmp(field, "tenant=", 7) == 0) {
+         long tenant = strtol(field + 7, &end, 10);
+         if (end == field + 7 || *end != '\0' || tenant < 0)
+             return -1;
+         job->tenant = (int)tenant;
+     } else {
+         return -1;
+     }
+     return 0;
+ }
+ 
+ /*******************************************************************************
+  * load_jobs - Lê o arquivo de jobs para 'jobs' e 'num_jobs'
+  ******************************************************************************/
+ void load_jobs(const char *path) {
+     char line[256];
+     int lineno = 0;
+     FILE *f = fopen(path, "r");
+     if (!f) {
+         perror("fopen");
+         exit(1);
+     }
+ 
+     while (fgets(line, sizeof(line), f)) {
+         lineno++;
+         char *hash = strchr(line, '#');
+         if (hash)
+             *hash = '\0';
+ 
+         char *save, *field = strtok_r(line, " \t\r\n", &save);
+         if (!field)
+             continue;
+         if (num_jobs == MAX_PROCESSES) {
+             printf("ERRO: %s tem mais de %d jobs\n", path, MAX_PROCESSES);
+             exit(1);
+         }
+ 
+         JobSpec *job = &jobs[num_jobs++];
+         job_defaults(job);
+         for (; field; field = strtok_r(NULL, " \t\r\n", &save)) {
+             if (parse_job_field(job, field) < 0) {
+                 printf("ERRO: %s:%d: campo invalido '%s'\n", path, lineno, field);
+                 exit(1);
+             }
+         }
+         if (job->period_ms > 0 && job->deadline_ms == 0)
+             job->deadline_ms = job->period_ms;
+         if (job->period_ms < 0 || job->runtime_ms < 0 || job->deadline_ms < 0 ||
+             (job->period_ms == 0 && (job->runtime_ms || job->deadline_ms)) ||
+             (job->period_ms > 0 && (job->runtime_ms <= 0 || job->runtime_ms > job->deadline_ms ||
+                                     job->deadline_ms > job->period_ms))) {
+             printf("ERRO: %s:%d: tempo real exige 0 < runtime <= deadline <= period\n", path, lineno);
+             exit(1);
+         }
+     }
+     fclose(f);
+ }
+ 
+ /*******************************************************************************
+  * build_jobs - Preenche os jobs dos apps a partir de -m e -n
+  ******************************************************************************/
+ void build_jobs(int n) {
+     const char *nice = config.nice;
+     for (int i = 0; i < n; i++) {
+         char *end;
+         jobs[i].load = config.io_mix[i % strlen(config.io_mix)];
+         jobs[i].nice = (int)strtol(nice, &end, 10);
+         jobs[i].period_ms = jobs[i].runtime_ms = jobs[i].deadline_ms = 0;
+         jobs[i].tickets = DEFAULT_TICKETS;
+         jobs[i].tenant = -1;
+         nice = *end == ',' ? end + 1 : config.nice;
+     }
+ }
+ 
+ /*******************************************************************************
+  * init_job_mix - Refaz config.io_mix com a carga de cada job, para as métricas
+  ******************************************************************************/
+ void init_job_mix() {
+     static char mix[MAX_PROCESSES + 1];
+     for (int i = 0; i < num_apps; i++)
+         mix[i] = jobs[i].load;
+     mix[num_apps] = '\0';
+     config.io_mix = mix;
+ }
+ 
+ /*******************************************************************************
+  * init_sched - Prepara os campos de escalonamento do PCB i antes de ele ficar
+  *              READY pela primeira vez
+  ******************************************************************************/
+ void init_sched(int i) {
+     PCB *p = &pcb_table[i];
+     p->nice = jobs[i].nice;
+     pa_node_init(&p->prio_node, PRIO_NICE_0 + jobs[i].nice);
+     p->rt = jobs[i].admitted;
+     dl_node_init(&p->rt_node);
+     tw_timer_init(&p->rt_timer, rt_release_expired, p);
+     if (p->rt)
+         rt_start_job(i, event_time_ns / 1000000);
+     p->tickets = p->eff_tickets = jobs[i].tickets;
+     p->lent_to = -1;
+     p->lot_weight = 0;
+     dl_node_init(&p->stride_node);
+     p->stride_pass = 0;
+     p->stride_cpu_ns = 0;
+ }
+ 
+ /*******************************************************************************
+  * parse_config_field - Aplica um campo chave=valor da linha '# config'
+  *
+  * Retorna:
+  *   0 em caso de sucesso, -1 se a chave ou o valor forem inválidos
+  ******************************************************************************/
+ int parse_config_field(const char *field) {
+     const char *value = strchr(field, '=');
+     if (!value)
+         return -1;
+     size_t len = value++ - field;
+ 
+     if (strncmp(field, "policy=", 7) == 0) {
+         SchedPolicy *p = find_policy(value);
+         if (!p)
+             return -1;
+         config.policy = p->name;
+         return 0;
+     }
+     if (strncmp(field, "page_policy=", 12) == 0) {
+         const PrPolicy *p = pr_find(value);
+         if (!p)
+             return -1;
+         config.page_policy = p->name;
+         return 0;
+     }
+     for (size_t k = 0; k < sizeof(config_fields) / sizeof(config_fields[0]); k++) {
+         if (strlen(config_fields[k].key) != len || strncmp(field, config_fields[k].key, len) != 0)
+             continue;
+         char *end;
+         long v = strtol(value, &end, 10);
+         if (end == value || *end != '\0')
+             return -1;
+         *config_fields[k].value = (int)v;
+         return 0;
+     }
+     return -1;
+ }
+ 
+ /*******************************************************************************
+  * replay_header - Restaura a configuração e os jobs gravados em um log v3
+  *
+  * Substitui as opções da linha de comando que influenciam as decisões pelas
+  * da gravação, para que o replay não dependa de repeti-las.
+  ******************************************************************************/
+ void replay_header(FILE *log, const char *path) {
+     char line[512];
+     char *save, *field;
+     int ok = fgets(line, sizeof(line), log) && strncmp(line, "# config ", 9) == 0;
+ 
+     if (ok)
+         for (field = strtok_r(line + 9, " \n", &save); ok && field; field = strtok_r(NULL, " \n", &save))
+             ok = parse_config_field(field) == 0;
+     for (int i = 0; ok && i < num_apps; i++) {
+         ok = fgets(line, sizeof(line), log) && strncmp(line, "# job ", 6) == 0;
+         job_defaults(&jobs[i]);
+         if (ok)
+             for (field = strtok_r(line + 6, " \n", &save); ok && field; field = strtok_r(NULL, " \n", &save))
+                 ok = parse_job_field(&jobs[i], field) == 0;
+     }
+     if (!ok) {
+         printf("ERRO: configuracao invalida no cabecalho de %s\n", path);
+         exit(1);
+     }
+ 
+     num_jobs = num_apps;
+     policy = find_policy(config.policy);
+     if (policy->pick == lottery_pick)
+         fw_init(&lottery_tree, lottery_tree_buf, MAX_PROCESSES);
+ }
+ 
+ /*******************************************************************************
+  * run_replay - Reexecuta um log gravado com --record
+  *
+  * Lê o cabeçalho para recriar a tabela de processos (com os PIDs originais,
+  * apenas para reproduzir a mesma saída), a configuração e os jobs da
+  * gravação (logs v3) e os blocos de contexto em memória
+  * privada. Em seguida aplica cada evento 'E', fecha cada lote 'B' e compara
+  * cada decisão 'D' com a produzida pelo escalonador.
+  *
+  * Parâmetros:
+  *   path - Caminho do log
+  *
+  * Retorna:
+  *   Não retorna: termina via shutdown_kernel ou exit
+  ******************************************************************************/
+ void run_replay(const char *path) {
+     char line[256];
+     int version = 0;
+     FILE *log = fopen(path, "r");
+     if (!log) {
+         perror("fopen");
+         exit(1);
+     }
+     replay_file = log;
+ 
+     if (!fgets(line, sizeof(line), log) ||
+         sscanf(line, "# trab1so-log v%d num_apps=%d", &version, &num_apps) != 2 ||
+         version < 1 || version > 3 ||
+         num_apps < 1 || num_apps > MAX_PROCESSES) {
+         printf("ERRO: cabecalho de log invalido em %s\n", path);
+         exit(1);
+     }
+     if (version >= 3)
+         replay_header(log, path);
+ 
+     replay_mode = 1;
+     if (num_jobs && num_jobs != num_apps) {
+         printf("ERRO: %s descreve %d jobs, mas o log tem %d processos\n",
+                config.jobs_path, num_jobs, num_apps);
+         exit(1);
+     }
+     if (!num_jobs)
+         build_jobs(num_apps);
+     init_job_mix();
+     rt_admission(num_apps);
+     pcb_table = calloc(num_apps, sizeof(PCB));
+     pid_index_create();
+     context_area = mmap(NULL, num_apps * sizeof(ContextBlock), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+ 
+     char *pids = strstr(line, "pids=");
+     if (pids)
+         pids += strlen("pids=");
+     for (int i = 0; i < num_apps; i++) {
+         pcb_table[i].pid = pids ? (pid_t)strtol(pids, &pids, 10) : 0;
+         if (pids && *pids == ',')
+             pids++;
+         ph_insert(&pid_index, pcb_table[i].pid, i);
+         init_sched(i);
+         set_state(i, READY);
+         pcb_table[i].ctx = &context_area[i];
+         pcb_table[i].fault_frame = -1;
+         pcb_table[i].io_buf = -1;
+         pcb_table[i].cache_wait = -1;
+         pcb_table[i].dirty = 0;
+         pcb_table[i].wb_wait = 0;
+         pcb_table[i].ra_next = UINT32_MAX;
+     }
+     vm_create();
+     cache_create();
+ 
+     printf("REPLAY: reexecutando %s com %d processos\n", path, num_apps);
+     fflush(stdout);
+ 
+     while (fgets(line, sizeof(line), log)) {
+         KernelEvent ev;
+         char name[16], op;
+         long seq;
+         int next;
+ 
+         memset(&ev, 0, sizeof(ev));
+         if (line[0] == 'E' && sscanf(line, "E %ld %lld %15s", &seq, &ev.ts, name) == 3) {
+             for (int t = EV_START; t <= EV_SWAP_DONE; t++)
+                 if (strcmp(name, event_names[t]) == 0)
+                     ev.type = (EventType)t;
+             if (ev.type == EV_SYSCALL) {
+                 sscanf(line, "E %*d %*d %*s %d %d %c %d %d %d %d %d %d", &ev.proc,
+                        &ev.sc.pending, &op, &ev.sc.pc, &ev.sc.regs[0],
+                        &ev.sc.regs[1], &ev.sc.regs[2], &ev.sc.regs[3], &ev.sc.arg);
+                 ev.sc.operation = op == '-' ? '\0' : op;
+             } else if (ev.type == EV_EXIT) {
+                 sscanf(line, "E %*d %*d %*s %d", &ev.proc);
+             }
+             replay_events++;
+             deliver_event(&ev);
+             if (version == 1) {
+                 replay_decisions_count = 0;
+                 end_batch();
+             }
+         } else if (line[0] == 'B') {
+             replay_decisions_count = 0;
+             end_batch();
+         } else if (line[0] == 'D' && sscanf(line, "D %ld %d", &seq, &next) == 2) {
+             int produced = replay_decisions_count > 0 ? replay_decisions[0] : -2;
+             if (replay_decisions_count > 0) {
+                 memmove(replay_decisions, replay_decisions + 1,
+                         (replay_decisions_count - 1) * sizeof(int));
+                 replay_decisions_count--;
+             }
+             replay_checked++;
+             if (produced != next) {
+                 replay_mismatches++;
+                 printf("REPLAY: DIVERGENCIA no evento %ld: registrado A%d, reproduzido A%d\n",
+                        seq, next, produced);
+                 fflush(stdout);
+             }
+         }
+     }
+ 
+     fclose(log);
+     printf("REPLAY: log terminou antes do fim da simulacao\n");
+     printf("REPLAY: %ld eventos, %ld decisoes verificadas, %ld divergencias\n",
+            replay_events, replay_checked, replay_mismatches);
+     exit(replay_mismatches ? 1 : 0);
+ }
+ 
+ /*******************************************************************************
+  * TEMPORIZADORES DE SLEEP
+  *
+  * Um processo que faz a syscall SLEEP passa para o estado SLEEPING e tem o
+  * seu temporizador agendado na roda do kernel (kernel_timers), com prazo
+  * em milissegundos de tempo de evento. A roda é avançada a cada IRQ0, que
+  * acorda de uma só vez todos os processos cujo prazo venceu; assim o
+  * escalonador nunca precisa examinar os processos que estão dormindo.
+  ******************************************************************************/
+ 
+ /*******************************************************************************
+  * sleep_expired - Callback da roda: o prazo de SLEEP do processo venceu
+  ******************************************************************************/
+ void sleep_expired(Timer *t) {
+     int i = (int)((PCB *)t->data - pcb_table);
  
- /*
-  * SyscallContext - Contexto de uma chamada de sistema
-  *
-  * Armazena as informações enviadas por um processo quando ele faz uma syscall.
-  * Permite que o kernel saiba exatamente em que ponto do código a syscall foi
-  * feita e qual operação foi solicitada.
-  *
-  * Campos:
-  *   pc        - Program Counter (contador de programa) no momento da syscall
-  *   operation - Tipo de operação ('R' para READ, 'W' para WRITE)
-  */
- typedef struct {
-     int pc;
-     char operation;
- } SyscallContext;
+     printf("KERNEL: Processo A%d (PID %d) acordou\n", i, pcb_table[i].pid);
+     fflush(stdout);
+     set_state(i, READY);
+     stats.wakeups++;
+ }
  
- /*
-  * PCB - Process Control Block (Bloco de Controle de Processo)
-  *
-  * Estrutura fundamental que mantém todas as informações sobre um processo
-  * que o kernel precisa para gerenciá-lo adequadamente.
+ /*******************************************************************************
+  * sleep_process - Coloca o processo para dormir por 'ms' milissegundos
+  ******************************************************************************/
+ void sleep_process(int i, int ms) {
+     PCB *p = &pcb_table[i];
+ 
+     printf("KERNEL: Processo A%d (PID %d) dormindo por %d ms\n", i, p->pid, ms);
+     fflush(stdout);
+     set_state(i, SLEEPING);
+     tw_timer_init(&p->sleep_timer, sleep_expired, p);
+     tw_add(&kernel_timers, &p->sleep_timer, event_time_ns / 1000000 + (ms > 0 ? ms : 0));
+     stats.sleeps++;
+ }
+ 
+ /*******************************************************************************
+  * TAREFA IDLE
   *
-  * Campos:
-  *   pid            - ID do processo no sistema operacional
-  *   state          - Estado atual do processo (READY, RUNNING ou BLOCKED)
-  *   io_pending     - Flag indicando se há uma operação de I/O em andamento
-  *   io_timer       - Timer para controlar a duração de operações de I/O
-  *   pipe_read_fd   - Descriptor do pipe para ler dados do app (App → Kernel)
-  *   pipe_write_fd  - Descriptor do pipe para enviar dados ao app (Kernel → App)
-  *   saved_pc       - Program Counter salvo durante uma syscall
-  *   syscall_param  - Parâmetro da syscall (tipo de operação solicitada)
-  *   saved_pc_valid - Flag que indica se há um PC válido para restaurar
-  */
- typedef struct {
-     pid_t pid;
-     ProcessState state;
-     int io_pending;
-     int io_timer;
-     int pipe_read_fd;
-     int pipe_write_fd;
-     int saved_pc;
-     char syscall_param;
-     int saved_pc_valid;
- } PCB;
+  * Quando o processo atual deixa a CPU (bloqueia, dorme ou termina) e não há
+  * nenhum processo READY, a CPU passa a executar a tarefa idle:
+  * current_running = -1 e o tempo ocioso é contabilizado até o próximo
+  * despacho. Ao final de cada evento, se a CPU está ociosa e algum processo
+  * ficou READY (conclusão de I/O, fim de SLEEP, término do processo atual),
+  * ele é despachado imediatamente, sem esperar a próxima IRQ0.
+  ******************************************************************************/
+ /*******************************************************************************
+  * cpu_is_idle - Indica se nenhum processo está em RUNNING
+  ******************************************************************************/
+ int cpu_is_idle() {
+     return current_running == -1 || pcb_table[current_running].state != RUNNING;
+ }
  
  /*******************************************************************************
-  * VARIÁVEIS GLOBAIS DO KERNEL
+  * enter_idle - A CPU passa a executar a tarefa idle
   ******************************************************************************/
- int num_apps = 0;
- PCB *pcb_table = NULL;
- pid_t controller_pid;
- int current_running = -1;
- int finished_processes = 0;
+ void enter_idle() {
+     if (idle_since_ns >= 0)
+         return;
+     printf("KERNEL: Nenhum processo READY, CPU ociosa (idle)\n");
+     fflush(stdout);
+     current_running = -1;
+     idle_since_ns = event_time_ns;
+     stats.idle_periods++;
+     trace_add(TR_IDLE, -1, 1, 0, 0);
+ }
  
  /*******************************************************************************
-  * PROTÓTIPOS DE FUNÇÕES
+  * leave_idle - A tarefa idle cede a CPU a um processo
   ******************************************************************************/
- void schedule();
+ void leave_idle() {
+     if (idle_since_ns < 0)
+         return;
+     stats.idle_ns += event_time_ns - idle_since_ns;
+     idle_since_ns = -1;
+     trace_add(TR_IDLE, -1, 0, 0, 0);
+ }
+ 
+ /*******************************************************************************
+  * idle_ns_total - Tempo ocioso acumulado até o evento atual
+  ******************************************************************************/
+ long long idle_ns_total() {
+     return stats.idle_ns + (idle_since_ns >= 0 ? event_time_ns - idle_since_ns : 0);
+ }
+ 
+ /*******************************************************************************
+  * idle_fast_path - Despacha imediatamente um processo READY se a CPU está ociosa
+  *
+  * Chamada ao final de cada evento. Os handlers que já acionam o escalonador
+  * deixam a CPU ocupada sempre que há alguém pronto; este caminho cobre os
+  * demais (por exemplo, o término do processo em execução). Nas políticas
+  * com preempts, também entrega a CPU a um processo que ficou READY com
+  * prioridade maior que a do atual.
+  ******************************************************************************/
+ void idle_fast_path() {
+     if (!cpu_is_idle() && policy->preempts && policy->preempts(current_running)) {
+         printf("KERNEL: Processo READY de maior prioridade, preemptando A%d\n", current_running);
+         fflush(stdout);
+         schedule();
+         return;
+     }
+     if (!cpu_is_idle() || policy->empty())
+         return;
+     printf("KERNEL: CPU ociosa com processo READY, despachando sem esperar a IRQ0\n");
+     fflush(stdout);
+     stats.fast_dispatches++;
+     schedule();
+ }
  
  /*******************************************************************************
   * HANDLERS DE INTERRUPÇÕES (IRQs)
@@ -164,18 +4122,37 @@
   * É o coração do escalonamento preemptivo Round-Robin.
   *
   * Parâmetros:
-  *   sig - Número do sinal recebido (SIGUSR1)
+  *   ev - Evento TICK (originado do SIG_IRQ0)
   *
   * Comportamento:
   *   - Registra a ocorrência da interrupção
+  *   - Encerra a ativação do processo de tempo real que esgotou o orçamento
+  *   - Acorda em lote os processos cujo prazo de SLEEP venceu e inicia as
+  *     ativações de tempo real que chegaram
+  *   - Com memória virtual, colhe os bits de referência das páginas e fecha
+  *     o intervalo da política de substituição (envelhecimento)
+  *   - Com escrita adiada, inicia um lote se há blocos sujos vencidos
   *   - Aciona o escalonador para selecionar o próximo processo
-  *
-  * Contexto: Handler de sinal - executado de forma assíncrona
   ******************************************************************************/
- void handle_irq0(int sig) {
+ void handle_irq0(KernelEvent *ev) {
      printf("\nKERNEL: IRQ0 (fim do time slice)\n");
      fflush(stdout);
-     schedule();
+     stats.ticks++;
+     trace_add(TR_IRQ, -1, 0, 0, 0);
+     if (!cpu_is_idle() && slice_used_up(current_running)) {
+         pcb_table[current_running].full_slices++;
+         pcb_table[current_running].slice_expired = 1;
+     }
+     if (!cpu_is_idle() && pcb_table[current_running].rt)
+         rt_check_budget(current_running);
+     tw_advance(&kernel_timers, event_time_ns / 1000000);
+     share_sample();
+     if (page_tables) {
+         vm_harvest();
+         pr_tick(&page_repl);
+     }
+     wb_tick();
+     need_resched = 1;
  }
  
  /*******************************************************************************
@@ -187,123 +4164,219 @@
   * processo e gerenciamento da fila de I/O.
   *
   * Parâmetros:
-  *   sig - Número do sinal recebido (SIGUSR2)
+  *   ev - Evento SYSCALL com a cópia do slot de syscall do processo
   *
   * Fluxo de execução:
-  *   1. Lê o contexto da syscall (PC e operação) através do pipe
+  *   1. Usa a cópia do slot de syscall (PC, registradores e operação)
   *   2. Salva o contexto do processo para posterior restauração
+  *   (SLEEP: o processo passa para SLEEPING com o seu temporizador agendado
+  *   e o escalonador é acionado, sem passar pela fila de I/O)
   *   3. Bloqueia o processo (estado BLOCKED) e o envia para fila
   *   4. Se não há I/O em andamento, inicia a próxima operação
   *   5. Aciona o escalonador para selecionar outro processo
   *
   * Importante:
-  *   - O processo é pausado (SIGSTOP) para evitar execução durante I/O
+  *   - O próprio app fecha o seu run_gate antes de sinalizar; o kernel apenas
+  *     registra o pedido de parada (com fallback de SIGSTOP)
   *   - A flag saved_pc_valid garante que o contexto só será restaurado uma vez
   *   - A fila de bloqueados mantém a ordem FIFO para justiça no atendimento
-  *
-  * Contexto: Handler de sinal - executado de forma assíncrona
+  *   - O processo é o remetente do sinal, que pode já estar READY se foi
+  *     preemptado logo depois de sinalizar; nesse caso ele sai da fila de
+  *     prontos antes de bloquear
   ******************************************************************************/
- void handle_syscall_from_app(int sig) {
-     printf("KERNEL: Syscall de I/O do processo A%d (PID %d)\n",
-            current_running, pcb_table[current_running].pid);
+ void handle_syscall_from_app(KernelEvent *ev) {
+     int proc = ev->proc;
+     int is_sleep = ev->sc.pending && ev->sc.operation == 'S';
+     long io_id = 0;
+ 
+     if (ev->sc.pending && ev->sc.operation == 'X') {
+         handle_exit_syscall(ev);
+         return;
+     }
+     if (ev->sc.pending && ev->sc.operation == 'F') {
+         handle_page_fault(ev);
+         return;
+     }
+     if (ev->sc.pending && ev->sc.operation == 'R' && cache_read(ev))
+         return;
+     if (ev->sc.pending && ev->sc.operation == 'W' && cache_write(ev))
+         return;
+     if (ev->sc.pending && ev->sc.operation == 'Y' && cache_fsync(ev))
+         return;
+ 
+     printf("KERNEL: Syscall de %s do processo A%d (PID %d)\n",
+            is_sleep ? "SLEEP" : ev->sc.operation == 'Y' ? "FSYNC" : "I/O",
+            proc, pcb_table[proc].pid);
      fflush(stdout);
+     stats.syscalls++;
+     pcb_table[proc].full_slices = 0;
+ 
+     // O app foi preemptado depois de sinalizar: sai da fila de prontos
+     if (pcb_table[proc].state == READY)
+         policy->remove(proc);
  
-     SyscallContext ctx;
-     int fd = pcb_table[current_running].pipe_read_fd;
-     if (read(fd, &ctx, sizeof(SyscallContext)) > 0) {
-         pcb_table[current_running].saved_pc = ctx.pc;
-         pcb_table[current_running].syscall_param = ctx.operation;
-         pcb_table[current_running].saved_pc_valid = 1;
+     if (ev->sc.pending) {
+         pcb_table[proc].saved_pc = ev->sc.pc;
+         for (int r = 0; r < NUM_REGS; r++)
+             pcb_table[proc].saved_regs[r] = ev->sc.regs[r];
+         pcb_table[proc].syscall_param = ev->sc.operation;
+         pcb_table[proc].saved_pc_valid = 1;
+         if (!is_sleep) {
+             // Só vai para a fila do disco quem não espera o cache
+             if (pcb_table[proc].cache_wait < 0 && !pcb_table[proc].wb_wait)
+                 io_id = pcb_table[proc].io_request = ++io_request_seq;
+             pcb_table[proc].io_block = (uint32_t)ev->sc.arg;
+             pcb_table[proc].io_start_ns = event_time_ns;
+             if (ev->sc.operation == 'R')
+                 stats.reads++;
+             if (ev->sc.operation == 'W')
+                 stats.writes++;
+         }
+         trace_add(TR_SYSCALL, proc, 0, io_id, ev->sc.operation);
          printf("KERNEL: Contexto salvo: PC=%d, OP=%c\n\n",
-                pcb_table[current_running].saved_pc,
-                pcb_table[current_running].syscall_param);
+                pcb_table[proc].saved_pc,
+                pcb_table[proc].syscall_param);
          fflush(stdout);
      } else {
-         printf("KERNEL: ERRO ao ler pipe do app A%d\n", current_running);
+         printf("KERNEL: ERRO: nenhuma syscall pendente no contexto de A%d\n", proc);
          fflush(stdout);
      }
  
-     kill(pcb_table[current_running].pid, SIGSTOP);
-     pcb_table[current_running].state = BLOCKED;
-     pcb_table[current_running].io_pending = 1;
+     stop_app(proc);
+ 
+     if (is_sleep) {
+         sleep_process(proc, ev->sc.arg);
+         need_resched = 1;
+         return;
+     }
  
-     enqueue_blocked(current_running);
+     set_state(proc, BLOCKED);
+     pcb_table[proc].io_pending = 1;
+     if (policy->block)
+         policy->block(proc);
  
-     if (!io_in_progress) {
-         int first = dequeue_blocked();
-         if (first != -1) {
-             io_in_progress = 1;
-             pcb_table[first].io_pending = 1;
-             printf("KERNEL: Iniciando I/O de A%d (PID %d)\n",
-                    first, pcb_table[first].pid);
-             kill(controller_pid, SIGUSR2);
-         }
+     // O bloco já está sendo lido para outro processo: espera essa leitura
+     if (pcb_table[proc].cache_wait >= 0) {
+         printf("KERNEL: A%d aguarda a leitura do bloco %u ja em andamento\n",
+                proc, pcb_table[proc].io_block);
+         fflush(stdout);
+         need_resched = 1;
+         return;
      }
  
-     schedule();
+     // Freio de escrita ou FSYNC: espera os lotes de escrita, fora da fila
+     if (pcb_table[proc].wb_wait) {
+         printf("KERNEL: A%d aguarda lotes de escrita (%s, %d blocos sujos)\n", proc,
+                pcb_table[proc].wb_wait == 'Y' ? "FSYNC" : "limite de sujos",
+                pcb_table[proc].dirty);
+         fflush(stdout);
+         disk_start_next();
+         need_resched = 1;
+         return;
+     }
+ 
+     enqueue_blocked(proc);
+     disk_start_next();
+     need_resched = 1;
  }
  
  /*******************************************************************************
-  * handle_process_finished - Handler do SIGCHLD (Processo Terminado)
+  * process_exit - Retira um processo terminado do escalonamento
   *
-  * Tratador de sinal chamado quando um processo filho termina sua execução.
-  * Esta função é responsável por contabilizar os processos finalizados e
-  * encerrar o kernel quando todos os processos de aplicação tiverem terminado.
-  *
-  * Parâmetros:
-  *   sig - Número do sinal recebido (SIGCHLD)
+  * O processo passa para TERMINATED e sai na hora de todas as estruturas de
+  * escalonamento (fila da política, temporizadores), de modo que nenhuma
+  * busca volta a encontrá-lo. Os seus quadros de memória física são
+  * liberados. Se ele estava na CPU, a CPU fica livre e o
+  * escalonador é acionado.
+  ******************************************************************************/
+ void process_exit(int i) {
+     account_state(i);
+     pcb_table[i].state = TERMINATED;
+     tw_cancel(&kernel_timers, &pcb_table[i].sleep_timer);
+     pcb_table[i].terminated = 1;
+     policy->remove(i);
+     if (pcb_table[i].rt)
+         rt_record_job(i);
+     vm_release(i);
+     pcb_table[i].exit_ns = event_time_ns;
+     trace_add(TR_EXIT, i, 0, 0, 0);
+     need_resched = 1;
+ }
+ 
+ /*******************************************************************************
+  * handle_exit_syscall - Handler da syscall EXIT
   *
-  * Fluxo de execução:
-  *   1. Coleta o status do processo filho terminado
-  *   2. Identifica qual processo terminou
-  *   3. Incrementa o contador de processos finalizados
-  *   4. Verifica se todos os processos terminaram
-  *   5. Se todos terminaram, encerra o InterControllerSim e o kernel
+  * O app avisa o seu término pelo canal de syscalls antes de sair, com o
+  * código de saída e os contadores finais. O processo é retirado do
+  * escalonamento imediatamente e o próximo é despachado ao fim do lote, sem
+  * esperar que o término seja observado pelo pidfd; a coleta (evento EXIT)
+  * vem depois e só conta o processo como finalizado.
   *
-  * Contexto: Handler de sinal - executado de forma assíncrona
+  * Parâmetros:
+  *   ev - Evento SYSCALL com operação 'X'
   ******************************************************************************/
- void handle_process_finished(int sig) {
-     int status;
-     pid_t terminated_pid;
- 
-     while ((terminated_pid = waitpid(-1, &status, WNOHANG)) > 0) {
-         // Verifica se é um processo de aplicação
-         int is_app = 0;
-         for (int i = 0; i < num_apps; i++) {
-             if (pcb_table[i].pid == terminated_pid) {
-                 printf("\nKERNEL: Processo A%d (PID %d) terminou sua execução\n", i, terminated_pid);
-                 fflush(stdout);
-                 finished_processes++;
-                 is_app = 1;
-                 break;
-             }
-         }
+ void handle_exit_syscall(KernelEvent *ev) {
+     int i = ev->proc;
+     PCB *p = &pcb_table[i];
  
-         // Se não é um app, pode ser o InterControllerSim
-         if (!is_app && terminated_pid == controller_pid) {
-             printf("KERNEL: InterControllerSim terminou\n");
-             fflush(stdout);
-         }
-     }
+     stats.exit_syscalls++;
+     p->exit_syscall = 1;
+     p->exit_code = ev->sc.arg;
+     p->exit_instr = ev->sc.pc;
+     for (int r = 0; r < NUM_REGS; r++)
+         p->exit_ctrs[r] = ev->sc.regs[r];
+     trace_add(TR_SYSCALL, i, 0, 0, 'X');
  
-     // Verifica se todos os processos de aplicação terminaram
-     if (finished_processes == num_apps) {
-         printf("\nKERNEL: Todos os %d processos terminaram sua execução\n", num_apps);
-         printf("KERNEL: Encerrando o sistema...\n");
-         fflush(stdout);
+     printf("KERNEL: Syscall EXIT do processo A%d (PID %d): codigo %d, %d instrucoes, "
+            "%d syscalls, %d estacionamentos, %d ms de CPU\n",
+            i, p->pid, p->exit_code, p->exit_instr, p->exit_ctrs[EXIT_CTR_SYSCALLS],
+            p->exit_ctrs[EXIT_CTR_PARKS], p->exit_ctrs[EXIT_CTR_CPU_MS]);
+     fflush(stdout);
  
-         // Encerra o InterControllerSim
-         if (controller_pid > 0) {
-             kill(controller_pid, SIGKILL);
-         }
+     process_exit(i);
+ }
  
-         // Libera recursos
-         free(pcb_table);
+ /*******************************************************************************
+  * handle_process_finished - Handler do término de um processo
+  *
+  * Chamado para cada evento EXIT gerado por reap_children (pidfd do app
+  * legível). Contabiliza os processos finalizados e encerra o kernel quando
+  * todos os processos de aplicação tiverem terminado.
+  *
+  * Se o app já avisou o término pela syscall EXIT, ele já saiu do
+  * escalonamento; o intervalo entre a syscall e a coleta é o tempo em que a
+  * CPU ficaria parada esperando por ela (exit_gap_saved). Caso contrário
+  * (término sem a syscall), o processo é retirado do escalonamento aqui.
+  *
+  * Parâmetros:
+  *   ev - Evento EXIT com o índice do processo terminado
+  *
+  * Fluxo de execução:
+  *   1. Marca o processo como terminado (TERMINATED) e o retira das filas,
+  *      se a syscall EXIT ainda não o fez
+  *   2. Incrementa o contador de processos finalizados
+  *   3. Verifica se todos os processos terminaram
+  *   4. Se todos terminaram, encerra o InterControllerSim e o kernel
+  ******************************************************************************/
+ void handle_process_finished(KernelEvent *ev) {
+     int i = ev->proc;
  
-         printf("KERNEL: Sistema encerrado com sucesso\n");
-         fflush(stdout);
-         exit(0);
+     printf("\nKERNEL: Processo A%d (PID %d) terminou sua execução\n", i, pcb_table[i].pid);
+     finished_processes++;
+     if (pcb_table[i].terminated) {
+         long long gap = event_time_ns - pcb_table[i].exit_ns;
+         stats.exit_gap_sum_ns += gap;
+         if (gap > stats.exit_gap_max_ns)
+             stats.exit_gap_max_ns = gap;
+         printf("KERNEL: A%d coletado %.3f ms depois da syscall EXIT\n", i, gap / 1e6);
+     } else {
+         process_exit(i);
      }
+     fflush(stdout);
+ 
+     // Verifica se todos os processos de aplicação terminaram
+     if (finished_processes == num_apps)
+         shutdown_kernel();
  }
  
  /*******************************************************************************
@@ -315,50 +4388,171 @@
   * novas operações de I/O pendentes.
   *
   * Parâmetros:
-  *   sig - Número do sinal recebido (SIGALRM)
+  *   ev - Evento IODONE (originado do SIG_IRQ1)
   *
   * Fluxo de execução:
   *   1. Marca que não há mais I/O em progresso
-  *   2. Localiza o processo que estava aguardando e o desbloqueia
+  *   2. Desbloqueia o processo cujo I/O estava em atendimento (io_current)
+  *      ou, se era um lote de escrita ou uma leitura antecipada, atualiza os
+  *      seus buffers e desbloqueia os processos que esperavam por ele
   *   3. Move o processo do estado BLOCKED para READY
-  *   4. Se há mais processos na fila, inicia a próxima operação de I/O
+  *   4. Inicia a próxima operação do disco (disk_start_next)
   *   5. Aciona o escalonador para redistribuir o processamento
   *
   * Importante:
-  *   - Apenas o primeiro processo bloqueado com io_pending é desbloqueado
+  *   - Apenas o dono do I/O concluído é desbloqueado; os que aguardam na
+  *     fila continuam BLOCKED até o seu próprio I/O
+  *   - Se a CPU estava ociosa, o processo desbloqueado é despachado já nesta
+  *     interrupção
   *   - Se houver mais processos na fila, automaticamente inicia próxima I/O
   *   - Garante que sempre haja no máximo uma operação de I/O ativa
-  *
-  * Contexto: Handler de sinal - executado de forma assíncrona
   ******************************************************************************/
- void handle_io_complete(int sig) {
+ void handle_io_complete(KernelEvent *ev) {
      printf("\nKERNEL: IRQ1 (I/O concluída) recebido do InterControllerSim\n");
      fflush(stdout);
  
      io_in_progress = 0;
+     stats.io_completed++;
+     trace_add(TR_IRQ, -1, 1, 0, 0);
  
-     for (int i = 0; i < num_apps; i++) {
-         if (pcb_table[i].state == BLOCKED && pcb_table[i].io_pending) {
-             pcb_table[i].state = READY;
-             pcb_table[i].io_pending = 0;
+     int done = io_current;
+     io_current = -1;
+     if (done == IO_FLUSH) {
+         trace_add(TR_IO_DONE, -1, 0, wb_request, 0);
+         wb_flush_done();
+     } else if (done == IO_PREFETCH) {
+         trace_add(TR_IO_DONE, -1, 0, ra_request, 0);
+         ra_done();
+     } else if (done >= 0) {
+         trace_add(TR_IO_DONE, done, 0, pcb_table[done].io_request, 0);
+         pcb_table[done].io_pending = 0;
+         cache_io_done(done);
+         ra_done();
+         if (!pcb_table[done].terminated && pcb_table[done].state == BLOCKED) {
+             set_state(done, READY);
              printf("KERNEL: Processo A%d (PID %d) desbloqueado\n",
-                    i, pcb_table[i].pid);
+                    done, pcb_table[done].pid);
              fflush(stdout);
-             break;
          }
      }
  
-     if (!blocked_is_empty()) {
-         int next = dequeue_blocked();
-         io_in_progress = 1;
-         pcb_table[next].io_pending = 1;
-         printf("KERNEL: Iniciando próxima I/O de A%d (PID %d)\n",
-                next, pcb_table[next].pid);
+     disk_start_next();
+     need_resched = 1;
+ }
+ 
+ /*******************************************************************************
+  * handle_page_fault - Handler de uma falta de página (operação 'F' na IRQ2)
+  *
+  * Parâmetros:
+  *   ev - Evento SYSCALL com a página virtual da falta em sc.arg
+  *
+  * Fluxo de execução:
+  *   1. Página fora do espaço do app (ou sem folha disponível na tabela): o
+  *      app é encerrado
+  *   2. Página já presente (falta menor, por exemplo de uma tradução refeita
+  *      enquanto o sinal estava a caminho): o app apenas volta a executar
+  *   3. Senão, reserva um quadro (frame_take), bloqueia o processo na fila
+  *      do swap e inicia a leitura se o dispositivo está livre
+  *
+  * Importante:
+  *   - Como em uma syscall de I/O, o processo pode já estar READY se foi
+  *     preemptado logo depois de sinalizar; ele sai da fila de prontos
+  *   - O contexto não é salvo: o app repete a referência ao voltar
+  ******************************************************************************/
+ void handle_page_fault(KernelEvent *ev) {
+     int proc = ev->proc;
+     PCB *p = &pcb_table[proc];
+     uint32_t vpn = (uint32_t)ev->sc.arg;
+     PageTable *pt = page_tables ? &page_tables[proc] : NULL;
+ 
+     trace_add(TR_SYSCALL, proc, 0, 0, 'F');
+     if (!pt || vpn >= PT_MAX_PAGES ||
+         (!pt_entry(pt, vpn) && pt->leaves_used == PT_MAX_LEAVES)) {
+         printf("KERNEL: A%d (PID %d) acessou a pagina invalida %u, encerrando\n",
+                proc, p->pid, vpn);
          fflush(stdout);
-         kill(controller_pid, SIGUSR2);
+         if (!replay_mode)
+             kill(p->pid, SIGKILL);
+         process_exit(proc);
+         return;
      }
  
-     schedule();
+     if (pt_walk(pt, vpn) & PTE_PRESENT) {
+         stats.minor_faults++;
+         if (p->state == RUNNING)
+             resume_app(proc);
+         return;
+     }
+ 
+     if (p->state == READY)
+         policy->remove(proc);
+     stop_app(proc);
+ 
+     int f = frame_take();
+     if (f < 0) {
+         printf("KERNEL: ERRO: nenhum quadro disponivel para A%d\n", proc);
+         fflush(stdout);
+         exit(1);
+     }
+     frame_owner[f] = proc;
+     frame_vpn[f] = vpn;
+     frame_busy[f] = 1;
+ 
+     stats.page_faults++;
+     p->page_faults++;
+     p->fault_vpn = vpn;
+     p->fault_frame = f;
+     p->fault_ns = event_time_ns;
+     p->swap_request = ++swap_request_seq;
+     printf("KERNEL: Falta de pagina de A%d (PID %d): pagina %u -> quadro %d\n",
+            proc, p->pid, vpn, f);
+     fflush(stdout);
+ 
+     set_state(proc, BLOCKED);
+     if (policy->block)
+         policy->block(proc);
+     enqueue_swap(proc);
+     if (!swap_in_progress)
+         start_next_swap();
+     need_resched = 1;
+ }
+ 
+ /*******************************************************************************
+  * handle_swap_complete - Handler da IRQ3 (página lida do swap)
+  *
+  * Mapeia a página no quadro reservado, desbloqueia o processo e inicia a
+  * próxima leitura da fila. Se o processo terminou enquanto esperava, o
+  * quadro é liberado.
+  ******************************************************************************/
+ void handle_swap_complete(KernelEvent *ev) {
+     int done = swap_current;
+ 
+     swap_in_progress = 0;
+     swap_current = -1;
+     stats.swap_completed++;
+     trace_add(TR_IRQ, -1, 3, 0, 0);
+ 
+     if (done >= 0 && pcb_table[done].fault_frame >= 0) {
+         PCB *p = &pcb_table[done];
+         int f = p->fault_frame;
+ 
+         p->fault_frame = -1;
+         stats.swap_wait_sum_ns += event_time_ns - p->fault_ns;
+         if (p->terminated) {
+             frame_release(f);
+         } else {
+             frame_busy[f] = 0;
+             pt_map(&page_tables[done], p->fault_vpn, (uint32_t)f);
+             page_repl.now = (uint64_t)(event_time_ns / 1000000);
+             pr_load(&page_repl, f);
+             p->resident++;
+             if (p->state == BLOCKED)
+                 set_state(done, READY);
+         }
+     }
+ 
+     start_next_swap();
+     need_resched = 1;
  }
  
  /*******************************************************************************
@@ -366,83 +4560,51 @@
   ******************************************************************************/
  
  /*******************************************************************************
-  * schedule - Escalonador Round-Robin de Processos
+  * schedule - Escalonador de Processos
   *
-  * Implementa a política de escalonamento Round-Robin, selecionando o próximo
-  * processo READY para executar. Esta é a função central do gerenciamento de
-  * processos do kernel.
+  * Seleciona, pela política escolhida em -p (tabela sched_policies), o
+  * próximo processo READY para executar. Esta é a função central do
+  * gerenciamento de processos do kernel.
   *
-  * Algoritmo Round-Robin:
-  *   - Percorre a tabela de processos de forma circular
-  *   - Seleciona o primeiro processo no estado READY encontrado
+  * Política Round-Robin (rr, padrão):
+  *   - Retira o próximo processo da fila de prontos (FIFO)
+  *   - O processo preemptado volta para o final da fila
   *   - Garante distribuição justa do tempo de CPU entre todos os processos
+  * As demais políticas (arr, prio, edf, rm, lottery, stride) trocam a fila e
+  * o quantum pelos seus (ver POLÍTICAS DE ESCALONAMENTO).
   *
   * Fluxo de execução:
-  *   1. Busca o próximo processo READY (política Round-Robin)
-  *   2. Se não houver processos READY, retorna sem fazer nada
-  *   3. Se há processo em execução, realiza preempção (pausa o processo)
+  *   1. Pede à política o próximo processo (policy->pick)
+  *   2. Se não houver processo a despachar, retorna; se a CPU ficou livre,
+  *      ela passa para a tarefa idle
+  *   3. Se há processo em execução, realiza preempção (fecha o run_gate)
   *   4. Atualiza o processo atual para o próximo selecionado
   *   5. Restaura o contexto salvo (PC) se houver syscall anterior
-  *   6. Resume a execução do processo selecionado
+  *   6. Resume a execução do processo selecionado (abre o run_gate)
   *
   * Tratamento de contexto:
   *   - Verifica a flag saved_pc_valid antes de restaurar contexto
-  *   - Envia o PC restaurado (+1) através do pipe para o processo
+  *   - Publica PC e registradores no bloco de contexto (resume_app)
   *   - Limpa a flag após restaurar para evitar restaurações duplicadas
   *
   * Importante:
-  *   - Processos BLOCKED não são considerados para escalonamento
+  *   - Processos BLOCKED e SLEEPING não estão na fila e nunca são examinados
   *   - A preempção garante que nenhum processo monopolize a CPU
   *   - O contexto só é restaurado se houve uma syscall anterior
   ******************************************************************************/
  void schedule() {
-     // Verifica se algum processo terminou antes de escalonar
-     int status;
-     pid_t terminated_pid;
-     while ((terminated_pid = waitpid(-1, &status, WNOHANG)) > 0) {
-         for (int i = 0; i < num_apps; i++) {
-             if (pcb_table[i].pid == terminated_pid) {
-                 printf("\nKERNEL: Processo A%d (PID %d) terminou sua execução\n", i, terminated_pid);
-                 fflush(stdout);
-                 finished_processes++;
-                 // Marca o processo como inativo removendo do escalonamento
-                 pcb_table[i].state = BLOCKED; // Marca como BLOCKED para não escalonar mais
-                 break;
-             }
-         }
-     }
- 
-     // Verifica se todos os processos terminaram
-     if (finished_processes == num_apps) {
-         printf("\nKERNEL: Todos os %d processos terminaram sua execução\n", num_apps);
-         printf("KERNEL: Encerrando o sistema...\n");
-         fflush(stdout);
- 
-         // Encerra o InterControllerSim
-         if (controller_pid > 0) {
-             kill(controller_pid, SIGKILL);
-         }
- 
-         // Libera recursos
-         free(pcb_table);
+     // Os términos de processos já chegam como eventos EXIT (reap_children)
+     if (!replay_mode)
+         enforce_preemption();
  
-         printf("KERNEL: Sistema encerrado com sucesso\n");
-         fflush(stdout);
-         exit(0);
-     }
+     int next = policy->pick(cpu_is_idle() ? -1 : current_running);
  
-     int next = -1;
-     for (int i = (current_running + 1) % num_apps; ; i = (i + 1) % num_apps) {
-         if (pcb_table[i].state == READY) {
-             next = i;
-             break;
-         }
-         if (i == current_running) break;
-     }
+     record_decision(next);
  
      if (next == -1) {
-         printf("KERNEL: Nenhum processo READY, aguardando...\n");
-         fflush(stdout);
+         // O processo atual continua, se ainda estiver executando
+         if (cpu_is_idle())
+             enter_idle();
          return;
      }
  
@@ -450,25 +4612,35 @@
          printf("KERNEL: Preemptando processo A%d (PID %d)\n",
                 current_running, pcb_table[current_running].pid);
          fflush(stdout);
-         kill(pcb_table[current_running].pid, SIGSTOP);
-         pcb_table[current_running].state = READY;
+         stop_app(current_running);
+         set_state(current_running, READY);
+         stats.preemptions++;
      }
  
+     leave_idle();
      current_running = next;
-     pcb_table[current_running].state = RUNNING;
+     set_state(current_running, RUNNING);
+     stats.dispatches++;
+     pcb_table[current_running].dispatches++;
  
-     printf("KERNEL: Executando processo A%d (PID %d)\n",
-            current_running, pcb_table[current_running].pid);
-     fflush(stdout);
- 
-     // --- Restaura o contexto salvo ---
-     if (pcb_table[current_running].saved_pc_valid) {
-         int restored_pc = pcb_table[current_running].saved_pc;
-         write(pcb_table[current_running].pipe_write_fd, &restored_pc, sizeof(int));
-         pcb_table[current_running].saved_pc_valid = 0;
+     // Quantum do despacho, definido pela política
+     PCB *p = &pcb_table[current_running];
+     p->dispatch_ns = event_time_ns;
+     p->slice_expired = 0;
+     p->slice_ms = policy->quantum(current_running);
+     stats.quantum_sum_ms += p->slice_ms;
+     if (policy->per_dispatch) {
+         clock_quantum_ms = p->slice_ms;
+         clock_slice_restart = 1;
+         printf("KERNEL: Executando processo A%d (PID %d) com quantum de %d ms\n",
+                current_running, p->pid, p->slice_ms);
+     } else {
+         printf("KERNEL: Executando processo A%d (PID %d)\n", current_running, p->pid);
      }
+     fflush(stdout);
  
-     kill(pcb_table[current_running].pid, SIGCONT);
+     // Restaura o contexto salvo (se houver) e libera o processo
+     resume_app(current_running);
  }
  
  /*******************************************************************************
@@ -479,124 +4651,403 @@
   * main - Ponto de entrada do kernel
   *
   * Inicializa todo o sistema operacional, criando os processos de aplicação,
-  * configurando os canais de comunicação (pipes), registrando os handlers de
-  * interrupções e iniciando o controlador de I/O.
+  * configurando os blocos de contexto compartilhados, registrando os handlers
+  * de interrupções e iniciando o controlador de I/O.
   *
   * Parâmetros:
   *   argc - Número de argumentos da linha de comando
-  *   argv - Array de argumentos (espera-se argv[1] = número de processos)
+  *   argv - Array de argumentos:
+  *          kernel [opções] <num_apps>
+  *          kernel [opções] --jobs <arquivo> [num_apps]
+  *          kernel [opções] --replay <arquivo>
+  *
+  * Opções:
+  *   -q, --quantum <ms>      Time slice do InterControllerSim
+  *   -d, --io-duration <ms>  Duração de cada operação de I/O
+  *   -i, --instr <ms>        Duração de cada instrução dos apps
+  *   -s, --sleep <ms>        Duração de cada SLEEP dos apps
+  *   -m, --io-mix <cargas>   Carga de cada app: 'c' (CPU), 'i' (I/O), 's' (SLEEP),
+  *                           'w' (escritas) ou 'q' (leitura sequencial)
+  *   -p, --policy <nome>     Política de escalonamento: rr, arr (quantum adaptativo),
+  *                           prio (prioridades estáticas), edf ou rm (tempo real),
+  *                           lottery ou stride (bilhetes)
+  *   -n, --nice <lista>      Valores nice dos apps (-20..19), separados por vírgula
+  *   -J, --jobs <arq>        Arquivo de jobs com a carga, o nice, os parâmetros
+  *                           de tempo real e os bilhetes de cada app
+  *   -o, --metrics <arq>     Grava as métricas ao final
+  *   -t, --trace <arq>       Grava a linha do tempo (trace-events JSON) ao final
+  *   -T, --tickless          IRQ0 apenas quando necessária (clock programado)
+  *   -V, --vm-pages <n>      Páginas de dados de cada app (ativa a memória virtual)
+  *   -F, --frames <n>        Quadros de memória física compartilhados pelos apps
+  *   -M, --vm-refs <n>       Referências à memória por instrução dos apps
+  *   -w, --swap-duration <ms> Duração de cada leitura do dispositivo de swap
+  *   -P, --page-policy <nome> Substituição de páginas: fifo, lru, second (segunda
+  *                           chance), clock, aging (envelhecimento) ou wsclock
+  *   -C, --cache-blocks <n>  Buffers do cache de blocos do disco (0: sem cache)
+  *   -B, --write-back <ms>   Escrita adiada no cache, com blocos sujos gravados
+  *                           em lotes em até <ms> (0: cada WRITE vai ao disco)
+  *   -A, --read-ahead <n>    Leitura antecipada das sequências de READs, com
+  *                           janela de até <n> blocos (0: desativada)
+  *   -r, --record <arq>      Grava eventos e decisões para replay
+  *   -R, --replay <arq>      Reexecuta um log gravado
   *
   * Fluxo de inicialização:
   *   1. Valida os argumentos de entrada (número de apps entre 3 e 6)
   *   2. Aloca a tabela PCB para gerenciar os processos
-  *   3. Cria os processos de aplicação via fork/exec
-  *   4. Configura pipes bidirecionais para cada processo
+  *   3. Cria a área de blocos de contexto em memória compartilhada
+  *   4. Cria os processos de aplicação via fork/exec
   *   5. Inicializa os PCBs com estado READY
-  *   6. Pausa todos os processos para controle inicial
-  *   7. Registra os handlers de sinais (IRQ0, IRQ1, IRQ2)
+  *   6. Fecha o run_gate de todos os processos (aguardam o primeiro despacho)
+  *   7. Registra o top half dos sinais (IRQ0, IRQ1, IRQ2, IRQ3), serializado
   *   8. Cria o processo InterControllerSim
-  *   9. Inicia o escalonamento
-  *   10. Entra em loop infinito aguardando interrupções
+  *   9. Inicia o escalonamento (evento START)
+  *   10. Entra no bottom half, que trata as interrupções em lotes
   *
   * Comunicação inter-processos:
-  *   - Cada app possui dois pipes: app→kernel e kernel→app
-  *   - O kernel fecha as pontas não utilizadas dos pipes
-  *   - Os file descriptors são passados via argumentos do execl
+  *   - Cada app possui um bloco de contexto (uma página) na área compartilhada
+  *   - O descriptor da área (memfd) e o índice do app são passados via
+  *     argumentos do execl; o app mapeia apenas o seu bloco
   *
   * Mapeamento de sinais:
-  *   SIGUSR1  → IRQ0 (fim do time slice)
-  *   SIGUSR2  → IRQ2 (syscall de I/O)
-  *   SIGALRM  → IRQ1 (conclusão de I/O)
+  *   SIG_IRQ0    → IRQ0 (fim do time slice)
+  *   SIG_SYSCALL → IRQ2 (syscall de I/O)
+  *   SIG_IRQ1    → IRQ1 (conclusão de I/O)
+  *   SIG_IRQ3    → IRQ3 (página lida do swap)
+  *   SIG_* são sinais de tempo real enfileirados, com valor (shared.h)
+  *   O término de processo (evento EXIT) chega pelo pidfd de cada filho
   *
   * Retorna:
   *   0 em caso de término normal (na prática, roda indefinidamente)
   ******************************************************************************/
  int main(int argc, char *argv[]) {
-     if (argc < 2) {
-         printf("Uso: %s <num_apps>\n", argv[0]);
+     static struct option long_options[] = {
+         { "quantum",     required_argument, NULL, 'q' },
+         { "io-duration", required_argument, NULL, 'd' },
+         { "instr",       required_argument, NULL, 'i' },
+         { "sleep",       required_argument, NULL, 's' },
+         { "io-mix",      required_argument, NULL, 'm' },
+         { "policy",      required_argument, NULL, 'p' },
+         { "metrics",     required_argument, NULL, 'o' },
+         { "trace",       required_argument, NULL, 't' },
+         { "tickless",    no_argument,       NULL, 'T' },
+         { "record",      required_argument, NULL, 'r' },
+         { "replay",      required_argument, NULL, 'R' },
+         { "nice",        required_argument, NULL, 'n' },
+         { "jobs",        required_argument, NULL, 'J' },
+         { "vm-pages",    required_argument, NULL, 'V' },
+         { "frames",      required_argument, NULL, 'F' },
+         { "vm-refs",     required_argument, NULL, 'M' },
+         { "swap-duration", required_argument, NULL, 'w' },
+         { "page-policy", required_argument, NULL, 'P' },
+         { "cache-blocks", required_argument, NULL, 'C' },
+         { "write-back",  required_argument, NULL, 'B' },
+         { "read-ahead",  required_argument, NULL, 'A' },
+         { NULL, 0, NULL, 0 }
+     };
+     const char *record_path = NULL, *replay_path = NULL;
+     int opt;
+ 
+     while ((opt = getopt_long(argc, argv, "q:d:i:s:m:p:o:t:Tr:R:n:J:V:F:M:w:P:C:B:A:", long_options, NULL)) != -1) {
+         switch (opt) {
+         case 'q': config.quantum_ms = atoi(optarg); break;
+         case 'd': config.io_ms = atoi(optarg); break;
+         case 'i': config.instr_ms = atoi(optarg); break;
+         case 's': config.sleep_ms = atoi(optarg); break;
+         case 'm': config.io_mix = optarg; break;
+         case 'p': config.policy = optarg; break;
+         case 'o': config.metrics_path = optarg; break;
+         case 't': config.trace_path = optarg; break;
+         case 'T': config.tickless = 1; break;
+         case 'r': record_path = optarg; break;
+         case 'R': replay_path = optarg; break;
+         case 'n': config.nice = optarg; break;
+         case 'J': config.jobs_path = optarg; break;
+         case 'V': config.vm_pages = atoi(optarg); break;
+         case 'F': config.vm_frames = atoi(optarg); break;
+         case 'M': config.vm_refs = atoi(optarg); break;
+         case 'w': config.swap_ms = atoi(optarg); break;
+         case 'P': config.page_policy = optarg; break;
+         case 'C': config.cache_blocks = atoi(optarg); break;
+         case 'B': config.wb_expire_ms = atoi(optarg); break;
+         case 'A': config.ra_max = atoi(optarg); break;
+         default:
+             printf("Uso: %s [opcoes] <num_apps>\n", argv[0]);
+             printf("     %s [opcoes] --replay <arquivo>\n", argv[0]);
+             exit(1);
+         }
+     }
+ 
+     if (config.quantum_ms <= 0 || config.io_ms <= 0 || config.instr_ms <= 0 ||
+         config.sleep_ms <= 0) {
+         printf("ERRO: quantum e duracoes de I/O, instrucao e sleep devem ser positivos\n");
+         exit(1);
+     }
+     if (config.vm_pages < 0 || config.vm_pages > VM_MAX_PAGES ||
+         config.vm_frames <= MAX_PROCESSES || config.vm_frames > (int)PTE_FRAME_MASK ||
+         config.vm_refs <= 0 || config.swap_ms <= 0) {
+         printf("ERRO: memoria virtual: paginas entre 0 e %d, mais de %d quadros, "
+                "referencias e duracao do swap positivas\n", VM_MAX_PAGES, MAX_PROCESSES);
+         exit(1);
+     }
+     if (config.cache_blocks < 0) {
+         printf("ERRO: o cache de blocos nao pode ter tamanho negativo\n");
+         exit(1);
+     }
+     if (config.wb_expire_ms < 0 || (config.wb_expire_ms > 0 && config.cache_blocks == 0)) {
+         printf("ERRO: a escrita adiada (-B) exige o cache de blocos (-C) e prazo positivo\n");
+         exit(1);
+     }
+     if (config.ra_max < 0 || config.ra_max > RA_MAX_WINDOW ||
+         (config.ra_max > 0 && (config.cache_blocks == 0 || config.ra_max < RA_MIN_WINDOW))) {
+         printf("ERRO: a leitura antecipada (-A) exige o cache de blocos (-C) e janela "
+                "entre %d e %d blocos\n", RA_MIN_WINDOW, RA_MAX_WINDOW);
+         exit(1);
+     }
+     if (!pr_find(config.page_policy)) {
+         printf("ERRO: politica de substituicao desconhecida '%s' "
+                "(disponiveis: fifo, lru, second, clock, aging, wsclock)\n", config.page_policy);
+         exit(1);
+     }
+     if (strspn(config.io_mix, "ciswq") != strlen(config.io_mix) || config.io_mix[0] == '\0') {
+         printf("ERRO: io-mix deve conter apenas 'c' (CPU), 'i' (I/O), 's' (SLEEP), 'w' (escritas) "
+                "e 'q' (leitura sequencial)\n");
+         exit(1);
+     }
+     policy = find_policy(config.policy);
+     if (!policy) {
+         printf("ERRO: politica desconhecida '%s' (disponiveis: rr, arr, prio, edf, rm, lottery, stride)\n",
+                config.policy);
+         exit(1);
+     }
+     for (const char *s = config.nice; ; s++) {
+         char *end;
+         long nice = strtol(s, &end, 10);
+         if (end == s || nice < NICE_MIN || nice > NICE_MAX || (*end != ',' && *end != '\0')) {
+             printf("ERRO: nice deve ser uma lista de valores entre %d e %d\n", NICE_MIN, NICE_MAX);
+             exit(1);
+         }
+         if (*end == '\0')
+             break;
+         s = end;
+     }
+     if (config.jobs_path)
+         load_jobs(config.jobs_path);
+     prq_init(&prio_rq);
+     dl_init(&rt_heap, rt_heap_nodes, MAX_PROCESSES);
+     if (policy->pick == lottery_pick)
+         fw_init(&lottery_tree, lottery_tree_buf, MAX_PROCESSES);
+     dl_init(&stride_heap, stride_heap_nodes, MAX_PROCESSES);
+ 
+     if (config.trace_path) {
+         trace_buf = malloc(TRACE_MAX_RECORDS * sizeof(TraceRecord));
+         if (!trace_buf) {
+             perror("malloc");
+             exit(1);
+         }
+     }
+ 
+     tw_init(&kernel_timers, 0);
+ 
+     if (replay_path)
+         run_replay(replay_path);
+ 
+     if (optind >= argc && !num_jobs) {
+         printf("Uso: %s [opcoes] <num_apps>\n", argv[0]);
+         printf("     %s [opcoes] --replay <arquivo>\n", argv[0]);
          exit(1);
      }
  
-     num_apps = atoi(argv[1]);
+     num_apps = optind < argc ? atoi(argv[optind]) : num_jobs;
      if (num_apps < 3 || num_apps > 6) {
          printf("ERRO: num_apps deve estar entre 3 e 6\n");
          exit(1);
      }
+     if (num_jobs && num_jobs != num_apps) {
+         printf("ERRO: %s descreve %d jobs, mas num_apps e %d\n", config.jobs_path, num_jobs, num_apps);
+         exit(1);
+     }
+     if (!num_jobs)
+         build_jobs(num_apps);
+     init_job_mix();
+     rt_admission(num_apps);
+ 
+     if (record_path) {
+         record_file = fopen(record_path, "w");
+         if (!record_file) {
+             perror("fopen");
+             exit(1);
+         }
+         setvbuf(record_file, NULL, _IOLBF, 0);
+     }
+     start_ns = now_ns();
+ 
+     // Os executáveis do app e do controlador ficam no mesmo diretório do kernel
+     char exe_dir[PATH_MAX], app_path[PATH_MAX + 8], controller_path[PATH_MAX + 24];
+     ssize_t len = readlink("/proc/self/exe", exe_dir, sizeof(exe_dir) - 1);
+     if (len < 0) {
+         perror("readlink");
+         exit(1);
+     }
+     exe_dir[len] = '\0';
+     dirname(exe_dir);
+     snprintf(app_path, sizeof(app_path), "%s/app", exe_dir);
+     snprintf(controller_path, sizeof(controller_path), "%s/InterControllerSim", exe_dir);
  
-     pcb_table = malloc(num_apps * sizeof(PCB));
+     pcb_table = calloc(num_apps, sizeof(PCB));
+     pid_index_create();
+     exit_watch_create();
+ 
+     context_fd = memfd_create("trab1so-contexts", 0);
+     if (context_fd < 0 || ftruncate(context_fd, num_apps * sizeof(ContextBlock)) < 0) {
+         perror("memfd_create");
+         exit(1);
+     }
+     context_area = mmap(NULL, num_apps * sizeof(ContextBlock), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, context_fd, 0);
+     if (context_area == MAP_FAILED) {
+         perror("mmap");
+         exit(1);
+     }
+     for (int i = 0; i < num_apps; i++) {
+         memset(&context_area[i], 0, sizeof(ContextBlock));
+         context_area[i].run_gate = GATE_STOPPED;
+         context_area[i].preempt = 1;
+         context_area[i].generation = 1;
+     }
+     vm_create();
+     cache_create();
  
      printf("KERNEL: Criando %d processos de aplicacao...\n", num_apps);
      fflush(stdout);
  
      for (int i = 0; i < num_apps; i++) {
-         int app_to_kernel[2], kernel_to_app[2];
-         pipe(app_to_kernel);
-         pipe(kernel_to_app);
- 
          pid_t pid = fork();
          if (pid == 0) {
-             close(app_to_kernel[0]);
-             close(kernel_to_app[1]);
+             char load_str[2], ctx_fd_str[12], index_str[12], instr_str[12], sleep_str[12];
+             char pt_fd_str[12], pages_str[12], refs_str[12];
  
-             char fd_read_str[10], fd_write_str[10], use_io_str[2];
-             sprintf(fd_read_str, "%d", kernel_to_app[0]);
-             sprintf(fd_write_str, "%d", app_to_kernel[1]);
+             // Carga definida por -m (repetida ciclicamente) ou pelo arquivo de jobs
+             // Teste 1: Todos sem I/O -> -m c (padrão)
+             // Teste 2: Todos com I/O -> -m i
+             // Teste 3: Primeiros 3 sem I/O, últimos 3 com I/O -> -m ccciii
+             // Teste 4: Apps que dormem -> -m s
+             load_str[0] = jobs[i].load;
+             load_str[1] = '\0';
  
-             // ALTERAR PARA TESTES
-             // Teste 1: Todos sem I/O -> use_io = 0
-             // Teste 2: Todos com I/O -> use_io = 1
-             // Teste 3: Primeiros 3 sem I/O, últimos 3 com I/O -> use_io = (i >= 3) ? 1 : 0
-             int use_io = 0;  // <-- TESTE 1: Todos sem I/O
+             sprintf(ctx_fd_str, "%d", context_fd);
+             sprintf(index_str, "%d", i);
+             sprintf(instr_str, "%d", config.instr_ms);
+             sprintf(sleep_str, "%d", config.sleep_ms);
  
-             sprintf(fd_read_str, "%d", kernel_to_app[0]);
-             sprintf(fd_write_str, "%d", app_to_kernel[1]);
-             sprintf(use_io_str, "%d", use_io);
+             sprintf(pt_fd_str, "%d", pt_fd);
+             sprintf(pages_str, "%d", config.vm_pages);
+             sprintf(refs_str, "%d", config.vm_refs);
  
-             execl("./app", "app", fd_read_str, fd_write_str, use_io_str, NULL);
+             // Sem memória virtual, o app não recebe as tabelas de páginas
+             if (config.vm_pages > 0)
+                 execl(app_path, "app", load_str, ctx_fd_str, index_str, instr_str, sleep_str,
+                       pt_fd_str, pages_str, refs_str, NULL);
+             else
+                 execl(app_path, "app", load_str, ctx_fd_str, index_str, instr_str, sleep_str, NULL);
              perror("execl");
              exit(1);
          }
  
-         close(app_to_kernel[1]);
-         close(kernel_to_app[0]);
- 
          pcb_table[i].pid = pid;
-         pcb_table[i].state = READY;
+         ph_insert(&pid_index, pid, i);
+         exit_watch(i, pid);
+         init_sched(i);
+         set_state(i, READY);
          pcb_table[i].io_pending = 0;
          pcb_table[i].io_timer = 0;
-         pcb_table[i].pipe_read_fd  = app_to_kernel[0];
-         pcb_table[i].pipe_write_fd = kernel_to_app[1];
          pcb_table[i].saved_pc = 0;
+         memset(pcb_table[i].saved_regs, 0, sizeof(pcb_table[i].saved_regs));
          pcb_table[i].syscall_param = '\0';
          pcb_table[i].saved_pc_valid = 0;
+         pcb_table[i].ctx = &context_area[i];
+         pcb_table[i].preempt_ns = now_ns();
+         pcb_table[i].signal_stopped = 0;
+         pcb_table[i].terminated = 0;
+         pcb_table[i].exit_ns = 0;
+         pcb_table[i].io_request = 0;
+         pcb_table[i].syscall_seq = 0;
+         pcb_table[i].fault_frame = -1;
+         pcb_table[i].io_buf = -1;
+         pcb_table[i].cache_wait = -1;
+         pcb_table[i].dirty = 0;
+         pcb_table[i].wb_wait = 0;
+         pcb_table[i].ra_next = UINT32_MAX;
  
          printf("KERNEL: Processo A%d criado (PID %d)\n", i, pid);
-         kill(pcb_table[i].pid, SIGSTOP);
-         printf("KERNEL: Processo A%d PARADO INICIALMENTE (PID %d)\n", i, pid);
+         printf("KERNEL: Processo A%d aguardando despacho no run_gate (PID %d)\n", i, pid);
          fflush(stdout);
      }      
  
-     signal(SIGUSR1, handle_irq0);
-     signal(SIGUSR2, handle_syscall_from_app);
-     signal(SIGALRM, handle_io_complete);
-     signal(SIGCHLD, handle_process_finished);
+     if (record_file)
+         record_header();
+ 
+     kstat_create();
+     clock_create();
+ 
+     // Todos os sinais do kernel ficam bloqueados enquanto um deles é tratado
+     struct sigaction sa;
+     sigset_t kernel_signals;
+     memset(&sa, 0, sizeof(sa));
+     sa.sa_sigaction = irq_top_half;
+     sa.sa_flags = SA_SIGINFO;
+     sigemptyset(&kernel_signals);
+     sigaddset(&kernel_signals, SIG_IRQ0);
+     sigaddset(&kernel_signals, SIG_IRQ1);
+     sigaddset(&kernel_signals, SIG_IRQ3);
+     sigaddset(&kernel_signals, SIG_SYSCALL);
+     sa.sa_mask = kernel_signals;
+     sigaction(SIG_IRQ0, &sa, NULL);
+     sigaction(SIG_IRQ1, &sa, NULL);
+     sigaction(SIG_IRQ3, &sa, NULL);
+     sigaction(SIG_SYSCALL, &sa, NULL);
  
      printf("KERNEL: Criando InterControllerSim...\n");
      fflush(stdout);
  
      controller_pid = fork();
      if (controller_pid == 0) {
-         execl("./InterControllerSim", "InterControllerSim", NULL);
+         char quantum_str[12], io_str[12], clock_str[12], swap_str[12];
+         sprintf(quantum_str, "%d", config.quantum_ms);
+         sprintf(io_str, "%d", config.io_ms);
+         sprintf(clock_str, "%d", clock_fd);
+         sprintf(swap_str, "%d", config.swap_ms);
+ 
+         // O controlador lê SIG_IO_REQ/SIG_SWAP_REQ/SIG_CLOCK com sigtimedwait; bloqueá-los
+         // antes do exec evita que um pedido enviado durante a sua
+         // inicialização o mate
+         sigset_t requests;
+         sigemptyset(&requests);
+         sigaddset(&requests, SIG_IO_REQ);
+         sigaddset(&requests, SIG_SWAP_REQ);
+         sigaddset(&requests, SIG_CLOCK);
+         sigprocmask(SIG_BLOCK, &requests, NULL);
+ 
+         execl(controller_path, "InterControllerSim", quantum_str, io_str, clock_str, swap_str, NULL);
          perror("execl");
          exit(1);
      }
+     exit_watch(num_apps, controller_pid);
  
-     sleep(1);
-     printf("KERNEL: Iniciando escalonamento...\n");
-     fflush(stdout);
-     schedule();
+     // Aguarda os apps estacionarem no run_gate (no máximo 1 segundo)
+     for (int waited_ms = 0; waited_ms < 1000; waited_ms++) {
+         int all_parked = 1;
+         for (int i = 0; i < num_apps; i++)
+             all_parked &= context_area[i].parked;
+         if (all_parked)
+             break;
+         usleep(1000);
+     }
+ 
+     KernelEvent start = { .type = EV_START };
+     deliver_event(&start);
+     end_batch();
  
-     while (1) pause();
+     bottom_half_loop(&kernel_signals);
      return 0;
  }
- 
\ No newline at end of file
+ 
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*******************************************************************************
+ * KSTAT - Visualizador das estatísticas ao vivo do kernel
+ *
+ * Mapeia o segmento de estatísticas publicado pelo kernel (kstat.h) e exibe
+ * os contadores e o estado de cada processo na taxa de atualização pedida.
+ * A leitura é feita direto da memória compartilhada, protegida por seqlock:
+ * o kernel nunca é sinalizado nem espera pelo leitor.
+ *
+ * O segmento é localizado procurando, em /proc/<pid>/fd, o memfd
+ * "trab1so-kstat" do kernel. Sem PID, usa o primeiro kernel encontrado.
+ *
+ * Uso: kstat [-i intervalo_ms] [-n amostras] [pid_do_kernel]
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include "kstat.h"
+
+#define DEFAULT_INTERVAL_MS 500
+
+#define NUM_STATES 5
+
+static const char *state_names[NUM_STATES] = { "READY", "RUNNING", "BLOCKED", "SLEEPING", "TERMINATED" };
+
+/*******************************************************************************
+ * find_segment - Procura o memfd de estatísticas entre os fds de um processo
+ *
+ * Retorna:
+ *   fd aberto para o segmento, ou -1 se o processo não publica estatísticas
+ ******************************************************************************/
+int find_segment(const char *pid) {
+    char dir_path[64], link_path[PATH_MAX], target[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "/proc/%s/fd", pid);
+
+    DIR *dir = opendir(dir_path);
+    if (!dir)
+        return -1;
+
+    struct dirent *entry;
+    int fd = -1;
+    while (fd < 0 && (entry = readdir(dir)) != NULL) {
+        snprintf(link_path, sizeof(link_path), "%s/%s", dir_path, entry->d_name);
+        ssize_t len = readlink(link_path, target, sizeof(target) - 1);
+        if (len < 0)
+            continue;
+        target[len] = '\0';
+        if (strncmp(target, "/memfd:" KSTAT_MEMFD_NAME, strlen("/memfd:" KSTAT_MEMFD_NAME)) == 0)
+            fd = open(link_path, O_RDONLY);
+    }
+    closedir(dir);
+    return fd;
+}
+
+/*******************************************************************************
+ * find_any_segment - Procura o segmento no primeiro kernel em execução
+ ******************************************************************************/
+int find_any_segment() {
+    DIR *proc = opendir("/proc");
+    if (!proc)
+        return -1;
+
+    struct dirent *entry;
+    int fd = -1;
+    while (fd < 0 && (entry = readdir(proc)) != NULL) {
+        if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9')
+            fd = find_segment(entry->d_name);
+    }
+    closedir(proc);
+    return fd;
+}
+
+/*******************************************************************************
+ * show - Exibe um instantâneo do segmento
+ *
+ * O tempo no estado atual de cada processo é somado ao acumulado usando o
+ * relógio monotônico local, de modo que os tempos avançam entre os eventos.
+ ******************************************************************************/
+void show(const KstatSegment *s, long retries) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long now = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec - s->start_mono_ns;
+    if (!s->running)
+        now = s->update_ns;
+
+    printf("kstat - kernel PID %d - %s - t=%.3f s - evento #%lld (releituras: %ld)\n",
+           s->kernel_pid, s->running ? "executando" : "encerrado", now / 1e9,
+           (long long)s->events, retries);
+    printf("quantum %d ms | I/O %d ms | ticks %lld | despachos %lld | preempcoes %lld | "
+           "syscalls %lld\n", s->quantum_ms, s->io_ms, (long long)s->ticks,
+           (long long)s->dispatches, (long long)s->preemptions, (long long)s->syscalls);
+    printf("I/O: na fila %lld | em andamento %lld | concluidas %lld\n",
+           (long long)s->io_queued, (long long)s->io_in_flight, (long long)s->io_completed);
+
+    long long idle_ns = s->idle_ns;
+    if (s->idle_since_ns >= 0 && now > s->idle_since_ns)
+        idle_ns += now - s->idle_since_ns;
+    printf("CPU: %s | ociosa %.1f ms (%.1f%%)\n\n", s->idle_since_ns >= 0 ? "idle" : "ocupada",
+           idle_ns / 1e6, now > 0 ? 100.0 * idle_ns / now : 0.0);
+
+    printf("PROC  PID      ESTADO      PC   CPU(ms)  READY(ms)  BLOCKED(ms)  SLEEP(ms)  DESPACHOS\n");
+    for (int i = 0; i < s->num_apps && i < KSTAT_MAX_PROCS; i++) {
+        const KstatProc *p = &s->procs[i];
+        long long time_ns[NUM_STATES] = { p->ready_ns, p->cpu_ns, p->blocked_ns, p->sleep_ns };
+        if (!p->terminated && p->state >= 0 && p->state < NUM_STATES && now > p->state_since_ns)
+            time_ns[p->state] += now - p->state_since_ns;
+
+        printf("A%-3d  %-7d  %-10s  %3d  %8.1f  %9.1f  %11.1f  %9.1f  %9lld%s\n",
+               i, p->pid, p->terminated ? "TERMINADO" : state_names[p->state], p->pc,
+               time_ns[1] / 1e6, time_ns[0] / 1e6, time_ns[2] / 1e6, time_ns[3] / 1e6,
+               (long long)p->dispatches, i == s->current ? "  <" : "");
+    }
+    fflush(stdout);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do kstat
+ *
+ * Parâmetros:
+ *   -i <ms>  Intervalo entre atualizações (padrão 500 ms)
+ *   -n <n>   Número de amostras (padrão: até o kernel encerrar)
+ *   pid      PID do kernel (opcional)
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    int interval_ms = DEFAULT_INTERVAL_MS;
+    long samples = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+        switch (opt) {
+        case 'i': interval_ms = atoi(optarg); break;
+        case 'n': samples = atol(optarg); break;
+        default:
+            fprintf(stderr, "Uso: %s [-i intervalo_ms] [-n amostras] [pid_do_kernel]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (interval_ms <= 0) {
+        fprintf(stderr, "ERRO: intervalo deve ser positivo\n");
+        exit(1);
+    }
+
+    int fd = optind < argc ? find_segment(argv[optind]) : find_any_segment();
+    if (fd < 0) {
+        fprintf(stderr, "ERRO: nenhum kernel com estatisticas ao vivo encontrado\n");
+        exit(1);
+    }
+
+    const KstatSegment *seg = mmap(NULL, sizeof(KstatSegment), PROT_READ, MAP_SHARED, fd, 0);
+    if (seg == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+    if (seg->magic != KSTAT_MAGIC) {
+        fprintf(stderr, "ERRO: segmento de estatisticas com formato desconhecido\n");
+        exit(1);
+    }
+
+    // Em um terminal, redesenha a tela; caso contrário, acumula as amostras
+    int redraw = isatty(STDOUT_FILENO);
+    struct timespec pause = { interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L };
+    KstatSegment snap;
+
+    for (long n = 0; samples < 0 || n < samples; n++) {
+        long retries = kstat_read(seg, &snap);
+        if (redraw)
+            printf("\033[H\033[2J");
+        else if (n > 0)
+            printf("\n");
+        show(&snap, retries);
+        if (!snap.running)
+            break;
+        nanosleep(&pause, NULL);
+    }
+
+    return 0;
+}
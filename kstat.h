@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * KSTAT - Segmento de estatísticas ao vivo do kernel
+ *
+ * O kernel publica os seus contadores e o estado de cada processo em um
+ * segmento de memória compartilhada (memfd "trab1so-kstat"), atualizado ao
+ * final do tratamento de cada evento. Leitores externos (a ferramenta kstat)
+ * mapeiam o segmento por /proc/<pid>/fd/<n> e o leem sem nenhuma chamada de
+ * sistema ao kernel e sem atrasá-lo.
+ *
+ * Consistência via seqlock:
+ *   - O escritor (kernel) torna 'seq' ímpar antes de alterar o segmento e
+ *     par de novo ao terminar
+ *   - O leitor copia o segmento e só aceita a cópia se 'seq' era par e não
+ *     mudou durante a cópia; caso contrário, tenta de novo
+ *   - O escritor nunca espera pelos leitores
+ ******************************************************************************/
+
+#ifndef KSTAT_H
+#define KSTAT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define KSTAT_MAGIC 0x6b737433          // "kst3"
+#define KSTAT_MAX_PROCS 6               // Igual a MAX_PROCESSES do kernel
+#define KSTAT_MEMFD_NAME "trab1so-kstat"
+
+/*
+ * KstatProc - Estado publicado de um processo
+ *
+ * Campos:
+ *   pid            - PID do app
+ *   state          - Estado (0 = READY, 1 = RUNNING, 2 = BLOCKED, 3 = SLEEPING,
+ *                    4 = TERMINATED)
+ *   terminated     - 1 se o processo já terminou
+ *   pc             - Último PC publicado pelo app no seu bloco de contexto
+ *   state_since_ns - Instante da última mudança de estado
+ *   cpu_ns         - Tempo acumulado em RUNNING até state_since_ns
+ *   ready_ns       - Tempo acumulado em READY até state_since_ns
+ *   blocked_ns     - Tempo acumulado em BLOCKED até state_since_ns
+ *   sleep_ns       - Tempo acumulado em SLEEPING até state_since_ns
+ *   dispatches     - Número de vezes que o processo foi despachado
+ */
+typedef struct {
+    int32_t pid;
+    int32_t state;
+    int32_t terminated;
+    int32_t pc;
+    int64_t state_since_ns;
+    int64_t cpu_ns;
+    int64_t ready_ns;
+    int64_t blocked_ns;
+    int64_t sleep_ns;
+    int64_t dispatches;
+} KstatProc;
+
+/*
+ * KstatSegment - Conteúdo do segmento de estatísticas
+ *
+ * Os instantes são em nanossegundos desde o início do kernel; start_mono_ns
+ * é o CLOCK_MONOTONIC desse início, para que o leitor calcule o tempo
+ * decorrido no estado atual.
+ */
+typedef struct {
+    uint32_t magic;
+    volatile uint32_t seq;
+    int32_t kernel_pid;
+    int32_t running;            // 0 depois que o kernel encerrou
+    int32_t num_apps;
+    int32_t current;            // Processo em RUNNING (-1 se nenhum)
+    int32_t quantum_ms;
+    int32_t io_ms;
+    int64_t start_mono_ns;
+    int64_t update_ns;          // Instante do último evento publicado
+    int64_t events;
+    int64_t ticks;
+    int64_t dispatches;
+    int64_t preemptions;
+    int64_t syscalls;
+    int64_t io_queued;
+    int64_t io_in_flight;
+    int64_t io_completed;
+    int64_t idle_ns;            // Tempo ocioso acumulado até idle_since_ns
+    int64_t idle_since_ns;      // Início do período ocioso atual (-1 se ocupada)
+    KstatProc procs[KSTAT_MAX_PROCS];
+} KstatSegment;
+
+/*******************************************************************************
+ * kstat_write_begin / kstat_write_end - Delimitam uma atualização do escritor
+ ******************************************************************************/
+static inline void kstat_write_begin(KstatSegment *seg) {
+    __atomic_store_n(&seg->seq, seg->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void kstat_write_end(KstatSegment *seg) {
+    __atomic_store_n(&seg->seq, seg->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+ * kstat_read - Copia um instantâneo consistente do segmento
+ *
+ * Retorna:
+ *   Número de tentativas descartadas por escrita concorrente
+ ******************************************************************************/
+static inline long kstat_read(const KstatSegment *seg, KstatSegment *out) {
+    long retries = 0;
+    uint32_t before, after;
+
+    for (;;) {
+        before = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+        if (!(before & 1)) {
+            memcpy(out, (const void *)seg, sizeof(*out));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&seg->seq, __ATOMIC_RELAXED);
+            if (before == after)
+                return retries;
+        }
+        retries++;
+    }
+}
+
+#endif
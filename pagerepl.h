@@ -0,0 +1,420 @@
+/*******************************************************************************
+ * PAGEREPL - Máquina de substituição de páginas com políticas plugáveis
+ *
+ * Escolhe o quadro de memória física cuja página sai quando falta quadro
+ * livre. Usada pelo kernel (memória virtual, -P) e pelo benchmark
+ * bench/pagerepl, que reexecuta traços de referências.
+ *
+ * Quem usa a máquina informa os eventos de cada quadro:
+ *   pr_load   - Uma página foi carregada no quadro (passa a ser candidata)
+ *   pr_access - A página do quadro foi referenciada; no kernel, chamada ao
+ *               colher os bits de referência das PTEs; no benchmark, a cada
+ *               referência do traço
+ *   pr_remove - O quadro deixou de ser candidato (página retirada ou dono
+ *               terminado)
+ *   pr_tick   - Fim de um intervalo de tempo (IRQ0 no kernel)
+ *   pr_select - Quadro a ser liberado (continua candidato até pr_remove)
+ *
+ * Políticas (PrPolicy):
+ *   fifo   - A página carregada há mais tempo
+ *   lru    - LRU exato: lista duplamente encadeada, com a página movida para
+ *            o fim a cada acesso; a vítima é a do início da lista
+ *   second - Segunda chance: a fila FIFO, mas uma página referenciada volta
+ *            para o fim da fila com o bit de referência limpo
+ *   clock  - Relógio: um ponteiro circular sobre os quadros limpa os bits de
+ *            referência até achar um quadro não referenciado
+ *   aging  - Envelhecimento: contador de PR_AGE_BITS bits por quadro,
+ *            deslocado a cada pr_tick com o bit de referência entrando no
+ *            bit mais alto; a vítima é a de menor contador
+ *   wsclock - Relógio com conjunto de trabalho: como o relógio, mas só
+ *            retira páginas não usadas há mais de 'tau' unidades de tempo,
+ *            preferindo as não modificadas
+ *
+ * Metadados em estrutura de arrays: os bits de quadro válido, referenciado e
+ * modificado ficam em mapas de bits de 64 quadros por palavra, e os contadores
+ * do envelhecimento em PR_AGE_BITS planos de bits (bit k do contador de cada
+ * quadro no plano k). Assim o relógio examina 64 quadros por operação, o
+ * tick do envelhecimento desloca os contadores de 64 quadros de uma vez e a
+ * busca do menor contador é feita plano a plano, sem percorrer os quadros.
+ *
+ * A memória da máquina é fornecida por quem inicializa (pr_mem_size). Todas
+ * as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef PAGEREPL_H
+#define PAGEREPL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PR_AGE_BITS 8
+
+typedef struct PrPolicy PrPolicy;
+
+/*
+ * PrEngine - Estado da máquina de substituição
+ *
+ * Campos:
+ *   policy     - Política em uso
+ *   nframes    - Número de quadros
+ *   words      - Palavras de 64 bits de cada mapa
+ *   valid      - Mapa de quadros candidatos (com página carregada)
+ *   ref        - Mapa de quadros referenciados desde a última varredura
+ *   dirty      - Mapa de quadros modificados
+ *   age        - Planos de bits dos contadores do envelhecimento
+ *   cand       - Mapa temporário da busca do menor contador
+ *   prev, next - Lista em ordem de carga ou de uso (-1 nas pontas)
+ *   head, tail - Pontas da lista: início (mais antiga) e fim
+ *   last_use   - Instante do último uso de cada quadro (wsclock)
+ *   hand       - Ponteiro circular (clock e wsclock)
+ *   now        - Tempo atual, na unidade de quem usa
+ *   tau        - Janela do conjunto de trabalho (wsclock), mesma unidade
+ *   selects    - Vítimas escolhidas (estatística)
+ *   scanned    - Quadros examinados nas escolhas (estatística)
+ */
+typedef struct {
+    const PrPolicy *policy;
+    int nframes;
+    int words;
+    uint64_t *valid;
+    uint64_t *ref;
+    uint64_t *dirty;
+    uint64_t *age;
+    uint64_t *cand;
+    int *prev;
+    int *next;
+    int head;
+    int tail;
+    uint64_t *last_use;
+    int hand;
+    uint64_t now;
+    uint64_t tau;
+    long selects;
+    long scanned;
+} PrEngine;
+
+/*
+ * PrPolicy - Operações de uma política
+ *
+ * Campos:
+ *   name   - Nome usado na linha de comando
+ *   access - Acesso a uma página (NULL: só o bit de referência)
+ *   select - Escolhe a vítima entre os quadros válidos (-1 se nenhum)
+ *   tick   - Fim de um intervalo (NULL: nada a fazer)
+ */
+struct PrPolicy {
+    const char *name;
+    void (*access)(PrEngine *e, int f);
+    int (*select)(PrEngine *e);
+    void (*tick)(PrEngine *e);
+};
+
+static inline int pr_test(const uint64_t *map, int f) {
+    return (map[f >> 6] >> (f & 63)) & 1;
+}
+
+static inline void pr_set(uint64_t *map, int f) {
+    map[f >> 6] |= 1ull << (f & 63);
+}
+
+static inline void pr_clear(uint64_t *map, int f) {
+    map[f >> 6] &= ~(1ull << (f & 63));
+}
+
+/*******************************************************************************
+ * pr_mem_size - Bytes de memória necessários para 'nframes' quadros
+ ******************************************************************************/
+static inline size_t pr_mem_size(int nframes) {
+    size_t words = (size_t)(nframes + 63) / 64;
+    return words * (4 + PR_AGE_BITS) * sizeof(uint64_t) +
+           (size_t)nframes * (2 * sizeof(int) + sizeof(uint64_t));
+}
+
+/*******************************************************************************
+ * pr_init - Inicializa a máquina sem nenhum quadro candidato
+ *
+ * Parâmetros:
+ *   mem - Memória com pr_mem_size(nframes) bytes, alinhada a 8
+ ******************************************************************************/
+static inline void pr_init(PrEngine *e, const PrPolicy *policy, int nframes, void *mem) {
+    int words = (nframes + 63) / 64;
+    uint64_t *w = mem;
+
+    memset(mem, 0, pr_mem_size(nframes));
+    e->policy = policy;
+    e->nframes = nframes;
+    e->words = words;
+    e->valid = w;
+    e->ref = w + words;
+    e->dirty = w + 2 * words;
+    e->cand = w + 3 * words;
+    e->age = w + 4 * words;
+    e->last_use = w + (4 + PR_AGE_BITS) * words;
+    e->prev = (int *)(e->last_use + nframes);
+    e->next = e->prev + nframes;
+    e->head = e->tail = -1;
+    e->hand = 0;
+    e->now = 0;
+    e->tau = 0;
+    e->selects = 0;
+    e->scanned = 0;
+}
+
+static inline void pr_unlink(PrEngine *e, int f) {
+    if (e->prev[f] >= 0)
+        e->next[e->prev[f]] = e->next[f];
+    else
+        e->head = e->next[f];
+    if (e->next[f] >= 0)
+        e->prev[e->next[f]] = e->prev[f];
+    else
+        e->tail = e->prev[f];
+}
+
+static inline void pr_append(PrEngine *e, int f) {
+    e->prev[f] = e->tail;
+    e->next[f] = -1;
+    if (e->tail >= 0)
+        e->next[e->tail] = f;
+    else
+        e->head = f;
+    e->tail = f;
+}
+
+/*******************************************************************************
+ * pr_load - Uma página foi carregada no quadro 'f'
+ ******************************************************************************/
+static inline void pr_load(PrEngine *e, int f) {
+    pr_set(e->valid, f);
+    pr_set(e->ref, f);
+    pr_clear(e->dirty, f);
+    for (int k = 0; k < PR_AGE_BITS; k++)
+        pr_clear(e->age + k * e->words, f);
+    e->last_use[f] = e->now;
+    pr_append(e, f);
+}
+
+/*******************************************************************************
+ * pr_access - A página do quadro 'f' foi referenciada (escrita se 'write')
+ ******************************************************************************/
+static inline void pr_access(PrEngine *e, int f, int write) {
+    pr_set(e->ref, f);
+    if (write)
+        pr_set(e->dirty, f);
+    e->last_use[f] = e->now;
+    if (e->policy->access)
+        e->policy->access(e, f);
+}
+
+/*******************************************************************************
+ * pr_remove - O quadro 'f' deixou de ser candidato (sem efeito se não era)
+ ******************************************************************************/
+static inline void pr_remove(PrEngine *e, int f) {
+    if (!pr_test(e->valid, f))
+        return;
+    pr_clear(e->valid, f);
+    pr_clear(e->ref, f);
+    pr_clear(e->dirty, f);
+    pr_unlink(e, f);
+}
+
+/*******************************************************************************
+ * pr_tick - Fim de um intervalo de tempo
+ ******************************************************************************/
+static inline void pr_tick(PrEngine *e) {
+    if (e->policy->tick)
+        e->policy->tick(e);
+}
+
+/*******************************************************************************
+ * pr_select - Quadro cuja página deve sair (-1 se não há candidatos)
+ ******************************************************************************/
+static inline int pr_select(PrEngine *e) {
+    e->selects++;
+    return e->policy->select(e);
+}
+
+/*******************************************************************************
+ * POLÍTICAS
+ ******************************************************************************/
+
+static inline void pr_lru_access(PrEngine *e, int f) {
+    if (e->tail != f && pr_test(e->valid, f)) {
+        pr_unlink(e, f);
+        pr_append(e, f);
+    }
+}
+
+static inline int pr_head_select(PrEngine *e) {
+    if (e->head >= 0)
+        e->scanned++;
+    return e->head;
+}
+
+static inline int pr_second_select(PrEngine *e) {
+    while (e->head >= 0) {
+        int f = e->head;
+        e->scanned++;
+        if (!pr_test(e->ref, f))
+            return f;
+        pr_clear(e->ref, f);
+        pr_unlink(e, f);
+        pr_append(e, f);
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * pr_clock_select - Relógio, 64 quadros por vez
+ *
+ * Na palavra do ponteiro, os quadros válidos a partir dele que não estão
+ * referenciados são candidatos; se há algum, o primeiro é a vítima e os
+ * referenciados antes dele perdem o bit. Senão, todos os bits da palavra
+ * são limpos de uma vez e o ponteiro passa para a palavra seguinte. Duas
+ * voltas bastam: na segunda, nenhum quadro continua referenciado.
+ ******************************************************************************/
+static inline int pr_clock_select(PrEngine *e) {
+    for (int n = 0; n <= 2 * e->words; n++) {
+        int w = e->hand >> 6;
+        uint64_t mask = e->valid[w] & (~0ull << (e->hand & 63));
+        uint64_t cand = mask & ~e->ref[w];
+
+        if (cand) {
+            int bit = __builtin_ctzll(cand);
+            uint64_t before = mask & ((1ull << bit) - 1);
+            e->ref[w] &= ~before;
+            e->scanned += __builtin_popcountll(before) + 1;
+            e->hand = (w * 64 + bit + 1) % e->nframes;
+            return w * 64 + bit;
+        }
+        e->ref[w] &= ~mask;
+        e->scanned += __builtin_popcountll(mask);
+        e->hand = (w + 1) * 64 < e->nframes ? (w + 1) * 64 : 0;
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * pr_aging_tick - Desloca os contadores de 64 quadros por operação
+ *
+ * Em cada palavra, os planos descem uma posição e o mapa de referenciados
+ * entra no plano mais alto; os bits de referência são limpos.
+ ******************************************************************************/
+static inline void pr_aging_tick(PrEngine *e) {
+    for (int w = 0; w < e->words; w++) {
+        for (int k = 0; k < PR_AGE_BITS - 1; k++)
+            e->age[k * e->words + w] = e->age[(k + 1) * e->words + w];
+        e->age[(PR_AGE_BITS - 1) * e->words + w] = e->ref[w] & e->valid[w];
+        e->ref[w] = 0;
+    }
+}
+
+/*******************************************************************************
+ * pr_aging_select - Menor contador, plano a plano
+ *
+ * Os candidatos começam pelos quadros válidos não referenciados no intervalo
+ * atual (ou todos os válidos, se todos foram referenciados). Do plano mais
+ * alto para o mais baixo, se algum candidato tem o bit zerado, ficam só os
+ * que o têm zerado. Sobram os de menor contador; a vítima é o primeiro a
+ * partir do ponteiro, que avança para distribuir os empates.
+ ******************************************************************************/
+static inline int pr_aging_select(PrEngine *e) {
+    uint64_t any = 0;
+    for (int w = 0; w < e->words; w++)
+        any |= e->cand[w] = e->valid[w] & ~e->ref[w];
+    if (!any)
+        for (int w = 0; w < e->words; w++)
+            any |= e->cand[w] = e->valid[w];
+    if (!any)
+        return -1;
+
+    for (int k = PR_AGE_BITS - 1; k >= 0; k--) {
+        const uint64_t *plane = e->age + k * e->words;
+        uint64_t zero = 0;
+        for (int w = 0; w < e->words; w++)
+            zero |= e->cand[w] & ~plane[w];
+        if (zero)
+            for (int w = 0; w < e->words; w++)
+                e->cand[w] &= ~plane[w];
+    }
+    e->scanned += e->words * (PR_AGE_BITS + 1);
+
+    for (int n = 0; n <= e->words; n++) {
+        int w = ((e->hand >> 6) + n) % e->words;
+        uint64_t c = e->cand[w] & (n == 0 ? ~0ull << (e->hand & 63) : ~0ull);
+        if (c) {
+            int f = w * 64 + __builtin_ctzll(c);
+            e->hand = (f + 1) % e->nframes;
+            return f;
+        }
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * pr_wsclock_select - Relógio com conjunto de trabalho
+ *
+ * Um quadro referenciado perde o bit e tem o último uso atualizado. Um
+ * quadro não referenciado e fora da janela (now - last_use > tau) é a
+ * vítima se não está modificado; os modificados são lembrados e usados se
+ * nenhum limpo for achado em uma volta (depois dela, todos os usos estão
+ * atualizados e mais voltas não mudariam nada). Sem nenhum quadro fora da
+ * janela, sai o não referenciado de uso mais antigo ou, se todos estavam
+ * referenciados, o primeiro examinado, como no relógio.
+ ******************************************************************************/
+static inline int pr_wsclock_select(PrEngine *e) {
+    int old_dirty = -1, unref = -1, first = -1;
+
+    for (int n = 0; n < e->nframes; n++) {
+        int f = e->hand;
+        e->hand = (e->hand + 1) % e->nframes;
+        if (!pr_test(e->valid, f))
+            continue;
+        e->scanned++;
+        if (first < 0)
+            first = f;
+        if (pr_test(e->ref, f)) {
+            pr_clear(e->ref, f);
+            e->last_use[f] = e->now;
+            continue;
+        }
+        if (e->now - e->last_use[f] > e->tau) {
+            if (!pr_test(e->dirty, f))
+                return f;
+            if (old_dirty < 0)
+                old_dirty = f;
+        } else if (unref < 0 || e->last_use[f] < e->last_use[unref]) {
+            unref = f;
+        }
+    }
+    if (old_dirty >= 0 || unref >= 0) {
+        int f = old_dirty >= 0 ? old_dirty : unref;
+        e->hand = (f + 1) % e->nframes;
+        return f;
+    }
+    return first;
+}
+
+static const PrPolicy pr_policies[] = {
+    { "fifo",    NULL,          pr_head_select,    NULL },
+    { "lru",     pr_lru_access, pr_head_select,    NULL },
+    { "second",  NULL,          pr_second_select,  NULL },
+    { "clock",   NULL,          pr_clock_select,   NULL },
+    { "aging",   NULL,          pr_aging_select,   pr_aging_tick },
+    { "wsclock", NULL,          pr_wsclock_select, NULL },
+};
+
+#define PR_NUM_POLICIES ((int)(sizeof(pr_policies) / sizeof(pr_policies[0])))
+
+/*******************************************************************************
+ * pr_find - Política de nome 'name' (NULL se desconhecida)
+ ******************************************************************************/
+static inline const PrPolicy *pr_find(const char *name) {
+    for (int p = 0; p < PR_NUM_POLICIES; p++)
+        if (strcmp(pr_policies[p].name, name) == 0)
+            return &pr_policies[p];
+    return NULL;
+}
+
+#endif
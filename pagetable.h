@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * PAGETABLE - Tabela de páginas em radix de dois níveis e TLB simulada
+ *
+ * Estruturas da memória virtual paginada, compartilhadas pelo kernel e pelos
+ * apps. Cada app tem um espaço de endereçamento de PT_MAX_PAGES páginas
+ * virtuais, descrito por uma PageTable que o kernel cria em memória
+ * compartilhada (memfd) e que o app mapeia após o exec:
+ *
+ *   - O kernel é o único que cria e desfaz traduções (pt_map, pt_unmap)
+ *   - O app percorre a tabela (pt_walk) a cada falta na sua TLB e marca nas
+ *     entradas os bits de referência e de escrita, como o hardware faria
+ *
+ * Organização:
+ *   - Diretório de PT_DIR_SIZE entradas; cada entrada aponta para uma folha
+ *     de PT_LEAF_SIZE PTEs de 32 bits (0: sem folha)
+ *   - As folhas vêm de um estoque fixo de PT_MAX_LEAVES por app e só são
+ *     alocadas quando a primeira página da sua faixa é mapeada: um espaço
+ *     esparso (código, dados e pilha em regiões distantes) ocupa poucas
+ *     folhas, em vez de uma tabela linear com todas as páginas
+ *   - Uma tradução custa duas leituras (diretório e folha), sem laços
+ *
+ * TLB:
+ *   - Cada app guarda a sua própria TLB (Tlb), totalmente associativa com
+ *     TLB_ENTRIES entradas e substituição circular; como cada app tem a
+ *     sua, ela se comporta como uma TLB com identificadores de espaço de
+ *     endereçamento, que não precisa ser esvaziada na troca de contexto
+ *   - Quando o kernel desfaz uma tradução, incrementa 'tlb_epoch' da tabela;
+ *     o app esvazia a TLB ao ver a mudança (shootdown)
+ *
+ * Todas as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include <stdint.h>
+
+#define PT_LEAF_BITS   9
+#define PT_LEAF_SIZE   (1 << PT_LEAF_BITS)            // PTEs por folha
+#define PT_DIR_SIZE    128                             // Entradas do diretório
+#define PT_MAX_PAGES   (PT_DIR_SIZE * PT_LEAF_SIZE)    // Páginas virtuais por app
+#define PT_MAX_LEAVES  8                               // Folhas disponíveis por app
+
+// Bits de uma PTE: presente, referenciada, escrita e número do quadro
+#define PTE_PRESENT    0x80000000u
+#define PTE_REF        0x40000000u
+#define PTE_DIRTY      0x20000000u
+#define PTE_FRAME_MASK 0x00ffffffu
+
+#define TLB_ENTRIES    32
+#define TLB_INVALID    UINT32_MAX
+
+/*
+ * PageTable - Tabela de páginas de um app na memória compartilhada
+ *
+ * Campos:
+ *   dir         - Diretório: índice da folha + 1 (0: faixa sem folha)
+ *   tlb_epoch   - Incrementado pelo kernel a cada tradução desfeita
+ *   leaves_used - Folhas já alocadas do estoque
+ *   leaves      - Estoque de folhas
+ *
+ * Cada tabela começa em uma página própria, como os blocos de contexto.
+ */
+typedef struct {
+    volatile uint32_t dir[PT_DIR_SIZE];
+    volatile uint32_t tlb_epoch;
+    uint32_t leaves_used;
+    volatile uint32_t leaves[PT_MAX_LEAVES][PT_LEAF_SIZE];
+} __attribute__((aligned(4096))) PageTable;
+
+/*
+ * Tlb - TLB privada de um app
+ *
+ * Campos:
+ *   vpn    - Página virtual de cada entrada (TLB_INVALID: entrada vazia)
+ *   pte    - Cópia da PTE de cada entrada
+ *   next   - Próxima entrada a ser substituída
+ *   epoch  - tlb_epoch da tabela no último esvaziamento
+ *   hits   - Referências resolvidas na TLB (estatística)
+ *   misses - Referências que precisaram percorrer a tabela (estatística)
+ */
+typedef struct {
+    uint32_t vpn[TLB_ENTRIES];
+    uint32_t pte[TLB_ENTRIES];
+    uint32_t next;
+    uint32_t epoch;
+    uint64_t hits;
+    uint64_t misses;
+} Tlb;
+
+/*******************************************************************************
+ * pt_init - Prepara uma tabela sem nenhuma tradução
+ ******************************************************************************/
+static inline void pt_init(PageTable *pt) {
+    for (int d = 0; d < PT_DIR_SIZE; d++)
+        pt->dir[d] = 0;
+    pt->tlb_epoch = 0;
+    pt->leaves_used = 0;
+}
+
+/*******************************************************************************
+ * pt_entry - Endereço da PTE de 'vpn' (NULL se a faixa não tem folha)
+ ******************************************************************************/
+static inline volatile uint32_t *pt_entry(PageTable *pt, uint32_t vpn) {
+    uint32_t leaf = pt->dir[vpn >> PT_LEAF_BITS];
+    if (leaf == 0)
+        return NULL;
+    return &pt->leaves[leaf - 1][vpn & (PT_LEAF_SIZE - 1)];
+}
+
+/*******************************************************************************
+ * pt_walk - Lê a PTE de 'vpn' (0 se não há tradução)
+ ******************************************************************************/
+static inline uint32_t pt_walk(PageTable *pt, uint32_t vpn) {
+    volatile uint32_t *e = pt_entry(pt, vpn);
+    return e ? __atomic_load_n(e, __ATOMIC_ACQUIRE) : 0;
+}
+
+/*******************************************************************************
+ * pt_map - Traduz 'vpn' para o quadro 'frame' (kernel)
+ *
+ * Aloca a folha da faixa se ela ainda não existe.
+ *
+ * Retorna:
+ *   0 em caso de sucesso, -1 se o estoque de folhas acabou
+ ******************************************************************************/
+static inline int pt_map(PageTable *pt, uint32_t vpn, uint32_t frame) {
+    uint32_t d = vpn >> PT_LEAF_BITS;
+    if (pt->dir[d] == 0) {
+        if (pt->leaves_used == PT_MAX_LEAVES)
+            return -1;
+        uint32_t leaf = pt->leaves_used++;
+        for (int e = 0; e < PT_LEAF_SIZE; e++)
+            pt->leaves[leaf][e] = 0;
+        __atomic_store_n(&pt->dir[d], leaf + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(pt_entry(pt, vpn), PTE_PRESENT | (frame & PTE_FRAME_MASK), __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*******************************************************************************
+ * pt_unmap - Desfaz a tradução de 'vpn' (kernel)
+ *
+ * Retorna:
+ *   A PTE anterior, com os bits de referência e escrita marcados pelo app
+ ******************************************************************************/
+static inline uint32_t pt_unmap(PageTable *pt, uint32_t vpn) {
+    volatile uint32_t *e = pt_entry(pt, vpn);
+    if (!e)
+        return 0;
+    uint32_t old = __atomic_exchange_n(e, 0, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&pt->tlb_epoch, 1, __ATOMIC_RELEASE);
+    return old;
+}
+
+/*******************************************************************************
+ * pt_mark - Marca bits em uma PTE presente (app)
+ *
+ * Só altera a entrada se ela ainda traduz para o mesmo quadro: o kernel
+ * pode tê-la desfeito depois da cópia guardada na TLB.
+ ******************************************************************************/
+static inline void pt_mark(PageTable *pt, uint32_t vpn, uint32_t pte, uint32_t bits) {
+    volatile uint32_t *e = pt_entry(pt, vpn);
+    uint32_t cur = pte;
+    if (!e)
+        return;
+    while ((cur & (PTE_PRESENT | PTE_FRAME_MASK)) == (pte & (PTE_PRESENT | PTE_FRAME_MASK)) &&
+           (cur & bits) != bits &&
+           !__atomic_compare_exchange_n(e, &cur, cur | bits, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        ;
+}
+
+/*******************************************************************************
+ * tlb_flush - Esvazia a TLB
+ ******************************************************************************/
+static inline void tlb_flush(Tlb *t) {
+    for (int e = 0; e < TLB_ENTRIES; e++)
+        t->vpn[e] = TLB_INVALID;
+    t->next = 0;
+}
+
+/*******************************************************************************
+ * tlb_lookup - Entrada da TLB que traduz 'vpn' (-1 se nenhuma)
+ ******************************************************************************/
+static inline int tlb_lookup(const Tlb *t, uint32_t vpn) {
+    for (int e = 0; e < TLB_ENTRIES; e++)
+        if (t->vpn[e] == vpn)
+            return e;
+    return -1;
+}
+
+/*******************************************************************************
+ * tlb_fill - Guarda a tradução de 'vpn' no lugar da entrada mais antiga
+ ******************************************************************************/
+static inline int tlb_fill(Tlb *t, uint32_t vpn, uint32_t pte) {
+    int e = (int)t->next;
+    t->vpn[e] = vpn;
+    t->pte[e] = pte;
+    t->next = (t->next + 1) % TLB_ENTRIES;
+    return e;
+}
+
+#endif
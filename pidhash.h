@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * PIDHASH - Índice de PID para processo em tabela hash
+ *
+ * Estrutura usada pelo kernel para encontrar o PCB de um processo a partir do
+ * seu PID: o remetente de uma syscall (si_pid do sinal) e cada filho coletado
+ * por waitpid. Substitui a busca linear na tabela de processos.
+ *
+ * Organização:
+ *   - Endereçamento aberto com sondagem linear: cada posição guarda um PID e
+ *     o índice do processo; PID 0 marca posição livre
+ *   - Hash multiplicativo (Fibonacci) do PID, com capacidade potência de 2
+ *     e ocupação de no máximo metade, o que mantém as sondagens curtas
+ *   - Remoção por deslocamento para trás (backward shift), sem lápides: as
+ *     entradas seguintes do mesmo agrupamento voltam para perto da sua
+ *     posição de origem
+ *
+ * Custos:
+ *   - Inserção, busca e remoção O(1) esperado
+ *
+ * O vetor de posições é fornecido por quem inicializa. Todas as funções são
+ * static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef PIDHASH_H
+#define PIDHASH_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * PidSlot - Posição da tabela
+ *
+ * Campos:
+ *   pid   - PID da entrada (0: posição livre)
+ *   index - Índice do processo na tabela de PCBs
+ */
+typedef struct {
+    pid_t pid;
+    int index;
+} PidSlot;
+
+/*
+ * PidHash - Tabela hash de PIDs
+ *
+ * Campos:
+ *   slots   - Vetor de posições
+ *   mask    - Capacidade - 1
+ *   count   - Entradas ocupadas
+ *   lookups - Buscas feitas (estatística)
+ *   probes  - Posições examinadas nas buscas (estatística)
+ */
+typedef struct {
+    PidSlot *slots;
+    unsigned long mask;
+    long count;
+    long lookups;
+    long probes;
+} PidHash;
+
+/*******************************************************************************
+ * ph_capacity - Menor potência de 2 com pelo menos o dobro de 'n' posições
+ ******************************************************************************/
+static inline unsigned long ph_capacity(long n) {
+    unsigned long cap = 8;
+    while (cap < (unsigned long)n * 2)
+        cap *= 2;
+    return cap;
+}
+
+/*******************************************************************************
+ * ph_init - Inicializa uma tabela vazia sobre 'slots' (cap: potência de 2)
+ ******************************************************************************/
+static inline void ph_init(PidHash *h, PidSlot *slots, unsigned long cap) {
+    h->slots = slots;
+    h->mask = cap - 1;
+    h->count = 0;
+    h->lookups = 0;
+    h->probes = 0;
+    for (unsigned long i = 0; i < cap; i++)
+        slots[i].pid = 0;
+}
+
+static inline unsigned long ph_home(const PidHash *h, pid_t pid) {
+    return (unsigned long)(((uint64_t)(uint32_t)pid * 0x9E3779B97F4A7C15ull) >> 32) & h->mask;
+}
+
+/*******************************************************************************
+ * ph_insert - Associa 'pid' ao índice 'index' (substitui se já existe)
+ ******************************************************************************/
+static inline void ph_insert(PidHash *h, pid_t pid, int index) {
+    unsigned long i = ph_home(h, pid);
+    while (h->slots[i].pid != 0 && h->slots[i].pid != pid)
+        i = (i + 1) & h->mask;
+    if (h->slots[i].pid == 0)
+        h->count++;
+    h->slots[i].pid = pid;
+    h->slots[i].index = index;
+}
+
+/*******************************************************************************
+ * ph_lookup - Índice do processo de PID 'pid' (-1 se não está na tabela)
+ ******************************************************************************/
+static inline int ph_lookup(PidHash *h, pid_t pid) {
+    unsigned long i = ph_home(h, pid);
+    h->lookups++;
+    if (pid <= 0)
+        return -1;
+    for (;;) {
+        h->probes++;
+        if (h->slots[i].pid == pid)
+            return h->slots[i].index;
+        if (h->slots[i].pid == 0)
+            return -1;
+        i = (i + 1) & h->mask;
+    }
+}
+
+/*******************************************************************************
+ * ph_remove - Retira 'pid' da tabela (sem efeito se não está)
+ *
+ * Depois de liberar a posição, percorre o agrupamento seguinte e move para a
+ * vaga cada entrada cuja posição de origem não fica entre a vaga e ela, de
+ * modo que nenhuma busca pare antes de encontrá-la.
+ ******************************************************************************/
+static inline void ph_remove(PidHash *h, pid_t pid) {
+    unsigned long i = ph_home(h, pid);
+    while (h->slots[i].pid != pid) {
+        if (h->slots[i].pid == 0)
+            return;
+        i = (i + 1) & h->mask;
+    }
+
+    unsigned long hole = i;
+    for (unsigned long j = (i + 1) & h->mask; h->slots[j].pid != 0; j = (j + 1) & h->mask) {
+        unsigned long home = ph_home(h, h->slots[j].pid);
+        // A entrada pode ocupar a vaga se a origem não está em (hole, j]
+        if (((j - home) & h->mask) >= ((j - hole) & h->mask)) {
+            h->slots[hole] = h->slots[j];
+            hole = j;
+        }
+    }
+    h->slots[hole].pid = 0;
+    h->count--;
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * PRIOARRAY - Fila de prontos O(1) por prioridade (estilo Linux 2.6)
+ *
+ * Estrutura usada pelo escalonador por prioridades do kernel (política prio)
+ * e pelo benchmark bench/prioarray. Há PA_LEVELS níveis de prioridade; quanto
+ * menor o número, maior a prioridade. No kernel, 0..99 ficam reservados para
+ * tempo real e os nice -20..19 ocupam 100..139.
+ *
+ * Organização:
+ *   - PrioArray: uma lista FIFO por nível e um mapa de bits dos níveis não
+ *     vazios; o próximo a executar é o primeiro da lista do primeiro bit
+ *     ligado (find-first-set), sem depender do número de processos
+ *   - PrioRunqueue: dois PrioArray, 'active' e 'expired'. Quem esgota a sua
+ *     fatia vai para 'expired'; quando 'active' esvazia, os dois são trocados
+ *     (só os ponteiros), o que impede que um processo de alta prioridade
+ *     monopolize a CPU
+ *
+ * Custos:
+ *   - Inserção, remoção e escolha O(1): listas duplamente encadeadas
+ *     intrusivas e PA_WORDS palavras de 64 bits no mapa
+ *
+ * Todas as funções são static inline, como em timerwheel.h.
+ ******************************************************************************/
+
+#ifndef PRIOARRAY_H
+#define PRIOARRAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PA_LEVELS 140
+#define PA_WORDS  ((PA_LEVELS + 63) / 64)
+
+typedef struct PrioNode PrioNode;
+
+/*
+ * PrioNode - Nó intrusivo de um processo na fila de prioridades
+ *
+ * Campos:
+ *   next, prev - Encadeamento na lista do nível
+ *   prio       - Nível em que o nó está (ou estará ao ser inserido)
+ *   array      - PrioArray onde o nó está (NULL: fora da fila)
+ */
+struct PrioNode {
+    PrioNode *next;
+    PrioNode *prev;
+    int prio;
+    struct PrioArray *array;
+};
+
+/*
+ * PrioArray - Um conjunto de listas por nível com o mapa de bits
+ *
+ * Campos:
+ *   count  - Número de nós no array
+ *   bitmap - Bit p ligado se a lista do nível p não está vazia
+ *   head   - Primeiro nó de cada nível
+ *   tail   - Último nó de cada nível
+ */
+typedef struct PrioArray {
+    long count;
+    uint64_t bitmap[PA_WORDS];
+    PrioNode *head[PA_LEVELS];
+    PrioNode *tail[PA_LEVELS];
+} PrioArray;
+
+/*
+ * PrioRunqueue - Par de arrays ativo/expirado
+ */
+typedef struct {
+    PrioArray arrays[2];
+    PrioArray *active;
+    PrioArray *expired;
+    long swaps;
+} PrioRunqueue;
+
+/*******************************************************************************
+ * pa_init - Inicializa um array vazio
+ ******************************************************************************/
+static inline void pa_init(PrioArray *a) {
+    a->count = 0;
+    for (int w = 0; w < PA_WORDS; w++)
+        a->bitmap[w] = 0;
+    for (int p = 0; p < PA_LEVELS; p++)
+        a->head[p] = a->tail[p] = NULL;
+}
+
+/*******************************************************************************
+ * pa_node_init - Prepara um nó fora da fila com a sua prioridade
+ ******************************************************************************/
+static inline void pa_node_init(PrioNode *n, int prio) {
+    n->next = n->prev = NULL;
+    n->prio = prio;
+    n->array = NULL;
+}
+
+/*******************************************************************************
+ * pa_first_level - Nível não vazio de maior prioridade (-1 se vazio)
+ ******************************************************************************/
+static inline int pa_first_level(const PrioArray *a) {
+    for (int w = 0; w < PA_WORDS; w++)
+        if (a->bitmap[w])
+            return w * 64 + __builtin_ctzll(a->bitmap[w]);
+    return -1;
+}
+
+/*******************************************************************************
+ * pa_enqueue - Insere o nó no final da lista do seu nível
+ ******************************************************************************/
+static inline void pa_enqueue(PrioArray *a, PrioNode *n) {
+    int p = n->prio;
+    n->next = NULL;
+    n->prev = a->tail[p];
+    if (a->tail[p])
+        a->tail[p]->next = n;
+    else
+        a->head[p] = n;
+    a->tail[p] = n;
+    a->bitmap[p / 64] |= (uint64_t)1 << (p % 64);
+    n->array = a;
+    a->count++;
+}
+
+/*******************************************************************************
+ * pa_remove - Retira o nó do array em que ele está (sem efeito se fora)
+ ******************************************************************************/
+static inline void pa_remove(PrioNode *n) {
+    PrioArray *a = n->array;
+    if (!a)
+        return;
+
+    int p = n->prio;
+    if (n->prev)
+        n->prev->next = n->next;
+    else
+        a->head[p] = n->next;
+    if (n->next)
+        n->next->prev = n->prev;
+    else
+        a->tail[p] = n->prev;
+    if (!a->head[p])
+        a->bitmap[p / 64] &= ~((uint64_t)1 << (p % 64));
+
+    n->next = n->prev = NULL;
+    n->array = NULL;
+    a->count--;
+}
+
+/*******************************************************************************
+ * pa_peek - Primeiro nó do nível de maior prioridade (NULL se vazio)
+ ******************************************************************************/
+static inline PrioNode *pa_peek(const PrioArray *a) {
+    int p = pa_first_level(a);
+    return p < 0 ? NULL : a->head[p];
+}
+
+/*******************************************************************************
+ * prq_init - Inicializa a fila com os dois arrays vazios
+ ******************************************************************************/
+static inline void prq_init(PrioRunqueue *rq) {
+    pa_init(&rq->arrays[0]);
+    pa_init(&rq->arrays[1]);
+    rq->active = &rq->arrays[0];
+    rq->expired = &rq->arrays[1];
+    rq->swaps = 0;
+}
+
+/*******************************************************************************
+ * prq_enqueue - Insere o nó no array ativo ou, se esgotou a fatia, no expirado
+ ******************************************************************************/
+static inline void prq_enqueue(PrioRunqueue *rq, PrioNode *n, int expired) {
+    pa_enqueue(expired ? rq->expired : rq->active, n);
+}
+
+/*******************************************************************************
+ * prq_peek - Próximo nó a executar, trocando os arrays se o ativo esvaziou
+ ******************************************************************************/
+static inline PrioNode *prq_peek(PrioRunqueue *rq) {
+    if (rq->active->count == 0 && rq->expired->count > 0) {
+        PrioArray *t = rq->active;
+        rq->active = rq->expired;
+        rq->expired = t;
+        rq->swaps++;
+    }
+    return pa_peek(rq->active);
+}
+
+/*******************************************************************************
+ * prq_count - Número total de nós na fila
+ ******************************************************************************/
+static inline long prq_count(const PrioRunqueue *rq) {
+    return rq->active->count + rq->expired->count;
+}
+
+#endif
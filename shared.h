@@ -0,0 +1,238 @@
+/*******************************************************************************
+ * SHARED - Estruturas compartilhadas entre o kernel e os apps
+ *
+ * Define o layout da área de contextos que o kernel cria em memória
+ * compartilhada (memfd) e que cada app mapeia após o exec. O descriptor da
+ * área e o índice do app são passados pelos argumentos do execl.
+ *
+ * Cada processo possui um bloco de contexto (uma página) com:
+ *   - Controle de despacho (run_gate, preempt, parked)
+ *   - Contexto restaurado pelo kernel (pc e registradores)
+ *   - Slot de syscall preenchido pelo app
+ *   - Contador de geração, incrementado pelo kernel sempre que escreve algo
+ *     que o app precisa observar
+ *
+ * Despacho via futex:
+ *   - O app só executa instruções enquanto run_gate == GATE_RUN
+ *   - O kernel despacha trocando a palavra para GATE_RUN e acordando o app
+ *   - A preempção é pedida pela flag 'preempt'; se o app não estacionar a
+ *     tempo, o kernel recorre ao SIGSTOP
+ *
+ * Caminho quente do app:
+ *   - A cada instrução o app faz uma única leitura de 'generation'; só se ela
+ *     mudou é que verifica preempção e contexto restaurado
+ *
+ * O kernel também compartilha com o InterControllerSim um bloco ClockControl
+ * (outro memfd), onde programa quando precisa de IRQ0 (modo tickless) e o
+ * quantum de cada despacho (quantum adaptativo).
+ *
+ * Canais de sinal:
+ *   - Todas as interrupções e pedidos usam sinais de tempo real (SIGRTMIN+n)
+ *     enviados com sigqueue. Ao contrário de SIGUSR1/SIGUSR2/SIGALRM, cada
+ *     envio fica enfileirado: duas syscalls ou duas conclusões de I/O que
+ *     chegam antes do handler rodar continuam sendo dois sinais
+ *   - O valor de cada sinal identifica o evento (índice do app, número de
+ *     sequência ou número do pedido de I/O), lido pelo receptor via
+ *     SA_SIGINFO ou sigtimedwait
+ *
+ * Memória virtual (pagetable.h):
+ *   - Com a memória virtual ativa, cada app faz referências à memória em
+ *     cada instrução; uma falta de página é entregue ao kernel pelo slot de
+ *     syscall (operação 'F') e atendida pelo dispositivo de swap do
+ *     InterControllerSim (SIG_SWAP_REQ / SIG_IRQ3)
+ ******************************************************************************/
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define GATE_STOPPED 0
+#define GATE_RUN     1
+
+/*
+ * Canais de sinal (sinais de tempo real, enfileirados)
+ *
+ *   SIG_IRQ0    - Controlador → kernel: IRQ0 (valor: número sequencial do tick)
+ *   SIG_IRQ1    - Controlador → kernel: IRQ1 (valor: número do pedido de I/O)
+ *   SIG_SYSCALL - App → kernel: IRQ2 (valor: SIGVAL_PACK(índice, sequência))
+ *   SIG_IO_REQ  - Kernel → controlador: início de I/O (valor: número do pedido)
+ *   SIG_CLOCK   - Kernel → controlador: ClockControl reprogramado
+ *   SIG_IRQ3    - Controlador → kernel: IRQ3, página lida do swap (valor:
+ *                 número do pedido de swap)
+ *   SIG_SWAP_REQ - Kernel → controlador: leitura de página no dispositivo de
+ *                 swap (valor: número do pedido de swap)
+ *
+ * SIGRTMIN não é uma constante em tempo de compilação, por isso os canais
+ * são comparados com if, e não com switch.
+ */
+#define SIG_IRQ0    (SIGRTMIN + 0)
+#define SIG_IRQ1    (SIGRTMIN + 1)
+#define SIG_SYSCALL (SIGRTMIN + 2)
+#define SIG_IO_REQ  (SIGRTMIN + 3)
+#define SIG_CLOCK   (SIGRTMIN + 4)
+#define SIG_IRQ3    (SIGRTMIN + 5)
+#define SIG_SWAP_REQ (SIGRTMIN + 6)
+
+// Valor de 32 bits: índice do app nos 8 bits altos, sequência nos 24 baixos
+#define SIGVAL_SEQ_BITS   24
+#define SIGVAL_SEQ_MASK   ((1 << SIGVAL_SEQ_BITS) - 1)
+#define SIGVAL_PACK(index, seq) \
+    ((int)(((unsigned)(index) << SIGVAL_SEQ_BITS) | ((unsigned)(seq) & SIGVAL_SEQ_MASK)))
+#define SIGVAL_INDEX(v)   ((int)((unsigned)(v) >> SIGVAL_SEQ_BITS))
+#define SIGVAL_SEQ(v)     ((int)((unsigned)(v) & SIGVAL_SEQ_MASK))
+
+#define NUM_REGS 4
+
+// Blocos do disco D1 (SyscallContext.arg de READ e WRITE): os apps de carga
+// 'i' leem um arquivo comum, no bloco de número igual ao PC da leitura, e
+// escrevem cada um na sua própria faixa de IO_PRIVATE_BLOCKS blocos, onde
+// também ficam as escritas da carga 'w' e a varredura da carga 'q'
+#define IO_PRIVATE_BASE   4096
+#define IO_PRIVATE_BLOCKS 64
+#define IO_PRIVATE_BLOCK(index, n) (IO_PRIVATE_BASE + (index) * IO_PRIVATE_BLOCKS + (n))
+
+// Contadores finais do app na syscall EXIT (posições de SyscallContext.regs)
+#define EXIT_CTR_SYSCALLS 0     // Syscalls feitas antes do EXIT
+#define EXIT_CTR_PARKS    1     // Vezes que o app estacionou no run_gate
+#define EXIT_CTR_CHECKS   2     // Mudanças de geração tratadas (caminho lento)
+#define EXIT_CTR_CPU_MS   3     // Tempo de CPU do app, em ms
+#define CONTEXT_BLOCK_SIZE 4096
+
+/*
+ * SyscallContext - Contexto de uma chamada de sistema
+ *
+ * Preenchido pelo app no seu bloco de contexto antes de sinalizar o kernel.
+ *
+ * Campos:
+ *   pc        - Program Counter no momento da syscall
+ *   regs      - Registradores no momento da syscall
+ *   operation - Tipo de operação ('R' para READ, 'W' para WRITE, 'S' para SLEEP,
+ *               'X' para EXIT, 'F' para falta de página, 'Y' para FSYNC)
+ *   arg       - Argumento da operação (bloco do disco para READ e WRITE,
+ *               duração em ms para SLEEP, código de saída para EXIT, página
+ *               virtual para falta de página)
+ *   pending   - 1 enquanto o kernel não consumiu a syscall
+ *
+ * Na syscall EXIT, 'pc' é o número de instruções executadas e 'regs' leva os
+ * contadores finais do app, nas posições EXIT_CTR_*.
+ */
+typedef struct {
+    int pc;
+    int regs[NUM_REGS];
+    char operation;
+    int arg;
+    volatile int pending;
+} SyscallContext;
+
+/*
+ * ContextBlock - Bloco de contexto de um processo na memória compartilhada
+ *
+ * Campos:
+ *   generation - Incrementado pelo kernel a cada mudança visível ao app
+ *   run_gate   - Palavra futex de liberação (GATE_STOPPED ou GATE_RUN)
+ *   preempt    - Flag de pedido de preempção escrita pelo kernel
+ *   parked     - Escrita pelo app: 1 enquanto está estacionado no run_gate
+ *   restore    - 1 se pc/regs contêm um contexto a ser restaurado pelo app
+ *   pc         - Program Counter restaurado pelo kernel
+ *   regs       - Registradores restaurados pelo kernel
+ *   syscall    - Slot da syscall em andamento (app → kernel)
+ *   app_pc     - PC atual, escrito pelo app a cada instrução (estatísticas)
+ *   vm_refs    - Referências à memória feitas pelo app (estatísticas)
+ *   tlb_hits   - Referências resolvidas na TLB do app (estatísticas)
+ *
+ * Cada bloco ocupa uma página própria para que apps diferentes não
+ * disputem as mesmas linhas de cache.
+ */
+typedef struct {
+    volatile uint32_t generation;
+    volatile uint32_t run_gate;
+    volatile uint32_t preempt;
+    volatile uint32_t parked;
+    volatile int restore;
+    int pc;
+    int regs[NUM_REGS];
+    SyscallContext syscall;
+    volatile int app_pc;
+    volatile uint64_t vm_refs;
+    volatile uint64_t tlb_hits;
+} __attribute__((aligned(CONTEXT_BLOCK_SIZE))) ContextBlock;
+
+/*
+ * ClockControl - Programação do clock pelo kernel
+ *
+ * O kernel escreve os campos e envia SIG_CLOCK ao InterControllerSim, que relê
+ * o bloco e reprograma os seus temporizadores.
+ *
+ * Campos:
+ *   periodic   - 1 se o controlador deve gerar IRQ0 a cada quantum; 0 no
+ *                modo tickless (-T) quando não há preempção a fazer
+ *   oneshot_ns - Instante (CLOCK_MONOTONIC) de uma IRQ0 avulsa, para o
+ *                próximo temporizador do kernel; 0 se não houver
+ *   quantum_ms - Duração do time slice atual
+ *   slice_seq  - Incrementado a cada despacho com quantum adaptativo: o
+ *                controlador reinicia o time slice a partir de agora
+ */
+typedef struct {
+    volatile uint32_t periodic;
+    volatile int64_t oneshot_ns;
+    volatile uint32_t quantum_ms;
+    volatile uint32_t slice_seq;
+} ClockControl;
+
+/*******************************************************************************
+ * sig_send - Envia um sinal de tempo real com valor, sem perdê-lo
+ *
+ * Se a fila de sinais pendentes do usuário está cheia (EAGAIN, limite
+ * RLIMIT_SIGPENDING), cede a CPU e tenta de novo até o sinal ser aceito.
+ *
+ * Retorna:
+ *   Número de tentativas recusadas com EAGAIN (0 no caso comum), ou -1 se o
+ *   destino não existe mais
+ ******************************************************************************/
+static inline long sig_send(pid_t pid, int sig, int value) {
+    union sigval sv;
+    long retries = 0;
+    sv.sival_int = value;
+    while (sigqueue(pid, sig, sv) < 0) {
+        if (errno != EAGAIN)
+            return -1;
+        retries++;
+        sched_yield();
+    }
+    return retries;
+}
+
+/*******************************************************************************
+ * futex_wait - Bloqueia enquanto *addr == expected
+ *
+ * Parâmetros:
+ *   addr       - Palavra futex na memória compartilhada
+ *   expected   - Valor esperado; se já for diferente, retorna imediatamente
+ *   timeout_ms - Tempo máximo de espera em milissegundos (< 0 = sem limite)
+ ******************************************************************************/
+static inline void futex_wait(volatile uint32_t *addr, uint32_t expected, int timeout_ms) {
+    struct timespec ts, *tsp = NULL;
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, tsp, NULL, 0);
+}
+
+/*******************************************************************************
+ * futex_wake - Acorda os processos bloqueados na palavra futex
+ ******************************************************************************/
+static inline void futex_wake(volatile uint32_t *addr) {
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,372 @@
+/*******************************************************************************
+ * SIMSWEEP - Executor paralelo de varreduras de parâmetros do simulador
+ *
+ * Recebe listas de valores para cada parâmetro da simulação, monta o produto
+ * cartesiano e executa uma instância isolada do kernel para cada combinação,
+ * várias em paralelo (uma por CPU do hospedeiro, por padrão).
+ *
+ * Isolamento de cada instância:
+ *   - Grupo de processos próprio (setpgid), de modo que kernel, apps e
+ *     InterControllerSim de uma instância possam ser encerrados juntos
+ *   - Diretório de saída próprio (<dir>/run_NNNN) com a saída do kernel
+ *     (saida.txt) e as métricas (metrics.txt)
+ *
+ * Ao final, as métricas de todas as instâncias são reunidas em um único CSV.
+ *
+ * Uso: simsweep [opções]
+ *   -q <lista>  Quantum em ms                  (padrão 1000)
+ *   -d <lista>  Duração do I/O em ms           (padrão 3000)
+ *   -i <lista>  Duração da instrução em ms     (padrão 2000)
+ *   -n <lista>  Número de apps                 (padrão 3)
+ *   -m <lista>  Carga dos apps (io-mix)        (padrão c)
+ *   -p <lista>  Política de escalonamento      (padrão rr)
+ *   -r <n>      Repetições de cada combinação  (padrão 1)
+ *   -j <n>      Instâncias simultâneas         (padrão: CPUs online)
+ *   -t <s>      Tempo limite por instância     (padrão 600)
+ *   -D <dir>    Diretório de saída             (padrão sweep)
+ *   -o <csv>    Arquivo CSV                    (padrão <dir>/results.csv)
+ *   -k <path>   Executável do kernel           (padrão: ./kernel ao lado)
+ *
+ * As listas são separadas por vírgula, ex.: -q 50,100,200 -m c,i,ccciii
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <limits.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define NUM_PARAMS 6
+#define MAX_VALUES 32
+#define MAX_KEYS 128
+
+/*******************************************************************************
+ * ESTRUTURAS DE DADOS
+ ******************************************************************************/
+
+/*
+ * Param - Um parâmetro da varredura e a lista de valores a experimentar
+ *
+ * Campos:
+ *   flag   - Opção repassada ao kernel ("-q", ...) ou NULL para num_apps
+ *   name   - Nome da coluna no CSV
+ *   values - Valores (strings apontando para o argv)
+ *   count  - Quantidade de valores
+ */
+typedef struct {
+    const char *flag;
+    const char *name;
+    char *values[MAX_VALUES];
+    int count;
+} Param;
+
+/*
+ * Run - Uma instância do kernel
+ *
+ * Campos:
+ *   id       - Número da instância (também dá nome ao diretório)
+ *   choice   - Índice do valor escolhido de cada parâmetro
+ *   rep      - Número da repetição
+ *   pid      - PID do kernel (também o PGID da instância), 0 se não iniciada
+ *   start    - Instante de início (para o tempo limite)
+ *   status   - "pendente", "ok", "erro" ou "timeout"
+ */
+typedef struct {
+    int id;
+    int choice[NUM_PARAMS];
+    int rep;
+    pid_t pid;
+    time_t start;
+    const char *status;
+} Run;
+
+/*******************************************************************************
+ * VARIÁVEIS GLOBAIS
+ ******************************************************************************/
+Param params[NUM_PARAMS] = {
+    { "-q", "quantum_ms" },
+    { "-d", "io_ms" },
+    { "-i", "instr_ms" },
+    { NULL, "num_apps" },
+    { "-m", "io_mix" },
+    { "-p", "policy" },
+};
+
+char kernel_path[PATH_MAX];
+const char *out_dir = "sweep";
+
+/*******************************************************************************
+ * split_list - Separa uma lista "a,b,c" nos valores do parâmetro
+ ******************************************************************************/
+void split_list(Param *p, char *list) {
+    p->count = 0;
+    for (char *tok = strtok(list, ","); tok && p->count < MAX_VALUES; tok = strtok(NULL, ","))
+        p->values[p->count++] = tok;
+}
+
+/*******************************************************************************
+ * start_run - Inicia uma instância do kernel em grupo e diretório próprios
+ ******************************************************************************/
+void start_run(Run *run) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/run_%04d", out_dir, run->id);
+    mkdir(dir, 0755);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char *args[2 * NUM_PARAMS + 4];
+        int n = 0;
+
+        setpgid(0, 0);
+        if (chdir(dir) < 0 || !freopen("saida.txt", "w", stdout)) {
+            perror(dir);
+            _exit(1);
+        }
+        dup2(fileno(stdout), STDERR_FILENO);
+
+        args[n++] = "kernel";
+        for (int k = 0; k < NUM_PARAMS; k++) {
+            if (params[k].flag) {
+                args[n++] = (char *)params[k].flag;
+                args[n++] = params[k].values[run->choice[k]];
+            }
+        }
+        args[n++] = "-o";
+        args[n++] = "metrics.txt";
+        args[n++] = params[3].values[run->choice[3]];
+        args[n] = NULL;
+
+        execv(kernel_path, args);
+        perror("execv");
+        _exit(1);
+    }
+
+    // Também no pai, para não haver corrida com o killpg
+    setpgid(pid, pid);
+    run->pid = pid;
+    run->start = time(NULL);
+}
+
+/*******************************************************************************
+ * write_csv - Reúne os metrics.txt de todas as instâncias em um CSV
+ *
+ * As colunas são: run, rep, status, os parâmetros da varredura e a união das
+ * chaves encontradas nos arquivos de métricas (na ordem em que aparecem).
+ ******************************************************************************/
+void write_csv(Run *runs, int total, const char *csv_path) {
+    char *keys[MAX_KEYS];
+    int num_keys = 0;
+    char line[512], path[PATH_MAX];
+
+    // Primeira passada: descobre as chaves
+    for (int r = 0; r < total; r++) {
+        snprintf(path, sizeof(path), "%s/run_%04d/metrics.txt", out_dir, runs[r].id);
+        FILE *m = fopen(path, "r");
+        if (!m)
+            continue;
+        while (fgets(line, sizeof(line), m)) {
+            char *eq = strchr(line, '=');
+            if (!eq)
+                continue;
+            *eq = '\0';
+            int known = 0;
+            for (int k = 0; k < NUM_PARAMS; k++)
+                known |= strcmp(line, params[k].name) == 0;
+            for (int k = 0; k < num_keys && !known; k++)
+                known |= strcmp(line, keys[k]) == 0;
+            if (!known && num_keys < MAX_KEYS)
+                keys[num_keys++] = strdup(line);
+        }
+        fclose(m);
+    }
+
+    FILE *csv = fopen(csv_path, "w");
+    if (!csv) {
+        perror(csv_path);
+        return;
+    }
+
+    fprintf(csv, "run,rep,status");
+    for (int k = 0; k < NUM_PARAMS; k++)
+        fprintf(csv, ",%s", params[k].name);
+    for (int k = 0; k < num_keys; k++)
+        fprintf(csv, ",%s", keys[k]);
+    fprintf(csv, "\n");
+
+    // Segunda passada: uma linha por instância
+    for (int r = 0; r < total; r++) {
+        char *values[MAX_KEYS] = { NULL };
+
+        snprintf(path, sizeof(path), "%s/run_%04d/metrics.txt", out_dir, runs[r].id);
+        FILE *m = fopen(path, "r");
+        while (m && fgets(line, sizeof(line), m)) {
+            char *eq = strchr(line, '=');
+            if (!eq)
+                continue;
+            *eq = '\0';
+            eq[strcspn(eq + 1, "\n") + 1] = '\0';
+            for (int k = 0; k < num_keys; k++)
+                if (strcmp(line, keys[k]) == 0 && !values[k])
+                    values[k] = strdup(eq + 1);
+        }
+        if (m)
+            fclose(m);
+
+        fprintf(csv, "%d,%d,%s", runs[r].id, runs[r].rep, runs[r].status);
+        for (int k = 0; k < NUM_PARAMS; k++)
+            fprintf(csv, ",%s", params[k].values[runs[r].choice[k]]);
+        for (int k = 0; k < num_keys; k++) {
+            fprintf(csv, ",%s", values[k] ? values[k] : "");
+            free(values[k]);
+        }
+        fprintf(csv, "\n");
+    }
+
+    fclose(csv);
+    for (int k = 0; k < num_keys; k++)
+        free(keys[k]);
+}
+
+/*******************************************************************************
+ * main - Ponto de entrada do simsweep
+ ******************************************************************************/
+int main(int argc, char *argv[]) {
+    int reps = 1, jobs = (int)sysconf(_SC_NPROCESSORS_ONLN), timeout_s = 600;
+    const char *csv_path = NULL;
+    char defaults[NUM_PARAMS][16] = { "1000", "3000", "2000", "3", "c", "rr" };
+    int opt;
+
+    kernel_path[0] = '\0';
+    while ((opt = getopt(argc, argv, "q:d:i:n:m:p:r:j:t:D:o:k:")) != -1) {
+        switch (opt) {
+        case 'q': split_list(&params[0], optarg); break;
+        case 'd': split_list(&params[1], optarg); break;
+        case 'i': split_list(&params[2], optarg); break;
+        case 'n': split_list(&params[3], optarg); break;
+        case 'm': split_list(&params[4], optarg); break;
+        case 'p': split_list(&params[5], optarg); break;
+        case 'r': reps = atoi(optarg); break;
+        case 'j': jobs = atoi(optarg); break;
+        case 't': timeout_s = atoi(optarg); break;
+        case 'D': out_dir = optarg; break;
+        case 'o': csv_path = optarg; break;
+        case 'k':
+            if (!realpath(optarg, kernel_path)) {
+                perror(optarg);
+                exit(1);
+            }
+            break;
+        default:
+            fprintf(stderr, "Uso: %s [-q lista] [-d lista] [-i lista] [-n lista] "
+                    "[-m lista] [-p lista] [-r n] [-j n] [-t s] [-D dir] [-o csv] "
+                    "[-k kernel]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (reps < 1 || jobs < 1) {
+        fprintf(stderr, "ERRO: -r e -j devem ser positivos\n");
+        exit(1);
+    }
+
+    // Parâmetros não informados usam o padrão do kernel
+    for (int k = 0; k < NUM_PARAMS; k++) {
+        if (params[k].count == 0) {
+            params[k].values[0] = defaults[k];
+            params[k].count = 1;
+        }
+    }
+
+    // Por padrão o kernel fica no mesmo diretório do simsweep
+    if (kernel_path[0] == '\0') {
+        char exe[PATH_MAX];
+        ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (len < 0) {
+            perror("readlink");
+            exit(1);
+        }
+        exe[len] = '\0';
+        snprintf(kernel_path, sizeof(kernel_path), "%.*s/kernel",
+                 (int)(sizeof(kernel_path) - 8), dirname(exe));
+    }
+
+    mkdir(out_dir, 0755);
+    char default_csv[PATH_MAX];
+    if (!csv_path) {
+        snprintf(default_csv, sizeof(default_csv), "%s/results.csv", out_dir);
+        csv_path = default_csv;
+    }
+
+    // Monta o produto cartesiano dos parâmetros (× repetições)
+    int total = reps;
+    for (int k = 0; k < NUM_PARAMS; k++)
+        total *= params[k].count;
+
+    Run *runs = calloc(total, sizeof(Run));
+    for (int r = 0; r < total; r++) {
+        int rest = r;
+        runs[r].id = r + 1;
+        runs[r].rep = rest % reps + 1;
+        rest /= reps;
+        for (int k = NUM_PARAMS - 1; k >= 0; k--) {
+            runs[r].choice[k] = rest % params[k].count;
+            rest /= params[k].count;
+        }
+        runs[r].status = "pendente";
+    }
+
+    printf("SIMSWEEP: %d instancias, ate %d em paralelo, saida em %s/\n", total, jobs, out_dir);
+    fflush(stdout);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int next = 0, running = 0, done = 0;
+    while (done < total) {
+        while (running < jobs && next < total) {
+            start_run(&runs[next++]);
+            running++;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            for (int r = 0; r < next; r++) {
+                if (runs[r].pid != pid)
+                    continue;
+                // Garante que apps e controlador da instância também terminem
+                killpg(pid, SIGKILL);
+                if (strcmp(runs[r].status, "timeout") != 0)
+                    runs[r].status = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "ok" : "erro";
+                running--;
+                done++;
+                printf("SIMSWEEP: [%d/%d] run_%04d %s\n", done, total, runs[r].id, runs[r].status);
+                fflush(stdout);
+                break;
+            }
+            continue;
+        }
+
+        time_t now = time(NULL);
+        for (int r = 0; r < next; r++) {
+            if (strcmp(runs[r].status, "pendente") == 0 && now - runs[r].start > timeout_s) {
+                runs[r].status = "timeout";
+                killpg(runs[r].pid, SIGKILL);
+            }
+        }
+        usleep(10000);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    write_csv(runs, total, csv_path);
+    printf("SIMSWEEP: concluido em %.1f s, resultados em %s\n",
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, csv_path);
+
+    free(runs);
+    return 0;
+}
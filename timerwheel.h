@@ -0,0 +1,282 @@
+/*******************************************************************************
+ * TIMERWHEEL - Roda de temporizadores hierárquica
+ *
+ * Estrutura de temporizadores compartilhada pelo InterControllerSim (fim do
+ * quantum e prazos de conclusão de I/O) e pelo kernel (temporizadores dos
+ * processos). O tempo é medido em ticks abstratos; quem usa a roda define a
+ * unidade (por exemplo, 1 tick = 1 ms).
+ *
+ * Organização:
+ *   - TW_LEVELS níveis de TW_SLOTS posições; cada posição do nível L cobre
+ *     TW_SLOTS^L ticks
+ *   - Um temporizador é colocado no nível mais baixo cujo alcance contém o
+ *     seu prazo e, quando o nível de baixo dá a volta, a posição corrente do
+ *     nível de cima é redistribuída (cascata) para os níveis inferiores
+ *   - Prazos além do alcance da roda ficam na posição mais distante do último
+ *     nível e são reinseridos a cada volta até caberem
+ *
+ * Custos:
+ *   - Inserção e cancelamento O(1): listas duplamente encadeadas intrusivas
+ *   - Expiração em lote: a lista inteira da posição é destacada de uma vez e
+ *     os callbacks são chamados em sequência
+ *   - Um mapa de bits de posições ocupadas por nível permite pular trechos
+ *     vazios e calcular o próximo prazo sem percorrer as listas
+ *
+ * Todas as funções são static inline, para que cada programa inclua a sua cópia
+ * sem precisar de uma biblioteca separada.
+ ******************************************************************************/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4
+#define TW_RANGE  ((uint64_t)1 << (TW_BITS * TW_LEVELS))
+#define TW_NEVER  UINT64_MAX
+
+typedef struct Timer Timer;
+
+/*
+ * Timer - Temporizador intrusivo
+ *
+ * Normalmente embutido em outra estrutura (ou acompanhado de 'data'), de
+ * modo que a roda nunca aloca memória.
+ *
+ * Campos:
+ *   next, pprev - Encadeamento na lista da posição (pprev == NULL: inativo)
+ *   expires     - Tick de expiração
+ *   fn          - Callback chamado na expiração (pode reagendar o timer)
+ *   data        - Dado livre do usuário
+ */
+struct Timer {
+    Timer *next;
+    Timer **pprev;
+    uint64_t expires;
+    void (*fn)(Timer *t);
+    void *data;
+};
+
+/*
+ * TimerWheel - Roda de temporizadores
+ *
+ * Campos:
+ *   now      - Tick corrente (todas as expirações até ele já ocorreram)
+ *   count    - Número de temporizadores ativos
+ *   occupied - Mapa de bits das posições não vazias de cada nível
+ *   slots    - Listas de temporizadores por nível e posição
+ */
+typedef struct {
+    uint64_t now;
+    long count;
+    uint64_t occupied[TW_LEVELS];
+    Timer *slots[TW_LEVELS][TW_SLOTS];
+} TimerWheel;
+
+/*******************************************************************************
+ * tw_init - Inicializa a roda vazia no tick 'now'
+ ******************************************************************************/
+static inline void tw_init(TimerWheel *w, uint64_t now) {
+    w->now = now;
+    w->count = 0;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        w->occupied[l] = 0;
+        for (int s = 0; s < TW_SLOTS; s++)
+            w->slots[l][s] = NULL;
+    }
+}
+
+/*******************************************************************************
+ * tw_timer_init - Prepara um temporizador inativo com o seu callback
+ ******************************************************************************/
+static inline void tw_timer_init(Timer *t, void (*fn)(Timer *t), void *data) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->data = data;
+}
+
+/*******************************************************************************
+ * tw_pending - Indica se o temporizador está agendado
+ ******************************************************************************/
+static inline int tw_pending(const Timer *t) {
+    return t->pprev != NULL;
+}
+
+/*******************************************************************************
+ * tw_link - Coloca o temporizador na posição adequada ao seu prazo
+ *
+ * Prazos anteriores a 'earliest' são tratados como 'earliest': fora de um
+ * avanço é o próximo tick (a posição corrente já foi processada); na cascata
+ * é o próprio tick corrente, cuja posição ainda será processada.
+ ******************************************************************************/
+static inline void tw_link(TimerWheel *w, Timer *t, uint64_t earliest) {
+    uint64_t expires = t->expires > earliest ? t->expires : earliest;
+    uint64_t delta = expires - w->now;
+    int level = 0;
+
+    if (delta >= TW_RANGE) {
+        expires = w->now + TW_RANGE - 1;
+        delta = TW_RANGE - 1;
+    }
+    while (level < TW_LEVELS - 1 && delta >= ((uint64_t)1 << (TW_BITS * (level + 1))))
+        level++;
+
+    int slot = (int)((expires >> (TW_BITS * level)) & TW_MASK);
+    Timer **head = &w->slots[level][slot];
+
+    t->next = *head;
+    if (t->next)
+        t->next->pprev = &t->next;
+    t->pprev = head;
+    *head = t;
+    w->occupied[level] |= (uint64_t)1 << slot;
+}
+
+/*******************************************************************************
+ * tw_unlink - Retira o temporizador da sua lista, atualizando o mapa de bits
+ ******************************************************************************/
+static inline void tw_unlink(TimerWheel *w, Timer *t) {
+    *t->pprev = t->next;
+    if (t->next)
+        t->next->pprev = t->pprev;
+
+    // Se a lista ficou vazia, 'pprev' aponta para a cabeça da posição
+    if (*t->pprev == NULL) {
+        Timer **first = &w->slots[0][0];
+        ptrdiff_t index = t->pprev - first;
+        if (index >= 0 && index < TW_LEVELS * TW_SLOTS)
+            w->occupied[index / TW_SLOTS] &= ~((uint64_t)1 << (index % TW_SLOTS));
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/*******************************************************************************
+ * tw_cancel - Cancela o temporizador (sem efeito se não estiver agendado)
+ ******************************************************************************/
+static inline void tw_cancel(TimerWheel *w, Timer *t) {
+    if (!tw_pending(t))
+        return;
+    tw_unlink(w, t);
+    w->count--;
+}
+
+/*******************************************************************************
+ * tw_add - Agenda o temporizador para o tick 'expires' (reagenda se ativo)
+ ******************************************************************************/
+static inline void tw_add(TimerWheel *w, Timer *t, uint64_t expires) {
+    if (tw_pending(t))
+        tw_cancel(w, t);
+    t->expires = expires;
+    tw_link(w, t, w->now + 1);
+    w->count++;
+}
+
+/*******************************************************************************
+ * tw_cascade - Redistribui a posição corrente do nível 'level'
+ ******************************************************************************/
+static inline void tw_cascade(TimerWheel *w, int level) {
+    int slot = (int)((w->now >> (TW_BITS * level)) & TW_MASK);
+    Timer *t = w->slots[level][slot];
+
+    w->slots[level][slot] = NULL;
+    w->occupied[level] &= ~((uint64_t)1 << slot);
+    while (t) {
+        Timer *next = t->next;
+        tw_link(w, t, w->now);
+        t = next;
+    }
+}
+
+/*******************************************************************************
+ * tw_advance - Avança a roda até o tick 'now', expirando os temporizadores
+ *
+ * Os temporizadores de cada posição são destacados em lote e marcados como
+ * inativos antes do callback, que pode reagendá-los livremente.
+ *
+ * Retorna:
+ *   Número de temporizadores expirados
+ ******************************************************************************/
+static inline long tw_advance(TimerWheel *w, uint64_t now) {
+    long expired = 0;
+
+    while (w->now < now) {
+        // Sem nada no nível 0, pula direto para o fim da volta corrente
+        if (w->occupied[0] == 0) {
+            uint64_t last = w->now | TW_MASK;
+            if (last >= now) {
+                w->now = now;
+                break;
+            }
+            w->now = last;
+        }
+
+        w->now++;
+        if ((w->now & TW_MASK) == 0) {
+            int top = 1;
+            while (top < TW_LEVELS - 1 && ((w->now >> (TW_BITS * top)) & TW_MASK) == 0)
+                top++;
+            for (int l = top; l >= 1; l--)
+                tw_cascade(w, l);
+        }
+
+        int slot = (int)(w->now & TW_MASK);
+        Timer *t = w->slots[0][slot];
+        if (!t)
+            continue;
+        w->slots[0][slot] = NULL;
+        w->occupied[0] &= ~((uint64_t)1 << slot);
+
+        while (t) {
+            Timer *next = t->next;
+            t->next = NULL;
+            t->pprev = NULL;
+            w->count--;
+            expired++;
+            t->fn(t);
+            t = next;
+        }
+    }
+    return expired;
+}
+
+/*******************************************************************************
+ * tw_next_expiry - Tick até o qual é seguro dormir sem perder expirações
+ *
+ * É exato para os temporizadores do nível 0; para os demais níveis retorna o
+ * tick da próxima cascata que os envolve, quando a roda deve ser avançada de
+ * novo para que desçam de nível.
+ *
+ * Retorna:
+ *   Tick do próximo evento da roda, ou TW_NEVER se ela estiver vazia
+ ******************************************************************************/
+static inline uint64_t tw_next_expiry(const TimerWheel *w) {
+    uint64_t next = TW_NEVER;
+
+    if (w->count == 0)
+        return next;
+
+    for (int l = 0; l < TW_LEVELS; l++) {
+        uint64_t bits = w->occupied[l];
+        if (!bits)
+            continue;
+        int shift = TW_BITS * l;
+        int current = (int)((w->now >> shift) & TW_MASK);
+        // Distância (1..TW_SLOTS) até a próxima posição ocupada
+        int rot = (current + 1) & TW_MASK;
+        uint64_t rotated = rot ? (bits >> rot) | (bits << (TW_SLOTS - rot)) : bits;
+        uint64_t k = (uint64_t)__builtin_ctzll(rotated) + 1;
+        uint64_t at = ((w->now >> shift) + k) << shift;
+        if (at < next)
+            next = at;
+    }
+    return next;
+}
+
+#endif